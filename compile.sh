@@ -1,4 +1,16 @@
-/home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shaders/shader.vert -o shaders/vert.spv
-/home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shaders/shader.frag -o shaders/frag.spv
-
-# replace this path with your Vulkan SDK installation path
\ No newline at end of file
+#!/bin/sh
+# the same shaders CMake compiles, glslc and spirv-val from the Vulkan SDK when VULKAN_SDK is set, the PATH otherwise
+GLSLC="${VULKAN_SDK:+$VULKAN_SDK/bin/}glslc"
+SPIRV_VAL="${VULKAN_SDK:+$VULKAN_SDK/bin/}spirv-val"
+cd "$(dirname "$0")/shaders" || exit 1
+# VK_EXT_mesh_shader needs SPIR-V 1.4, the other stages stay loadable on Vulkan 1.0 devices
+compile() {
+    "$GLSLC" --target-env="$1" "$2" -o "$2.spv" || exit 1
+    "$SPIRV_VAL" --target-env "$1" "$2.spv" || exit 1
+}
+for shader in shader.vert shader_quantized.vert shader.frag; do
+    compile vulkan1.0 "$shader"
+done
+for shader in meshlet.task meshlet.mesh; do
+    compile vulkan1.2 "$shader"
+done
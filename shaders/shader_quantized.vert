@@ -0,0 +1,30 @@
+#version 450
+
+// positions, colors and texcoords may come in as normalized integers,
+// the push constants bring them back to model space (identity for float attributes)
+layout(location = 0) in vec4 inPos;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// must match vcr::VertexDequantization
+layout(push_constant) uniform VertexDequantization {
+    vec4 positionScale;
+    vec4 positionOffset;
+    vec4 texCoordScaleOffset;
+} dequantization;
+
+void main() {
+    vec3 pos = dequantization.positionOffset.xyz + dequantization.positionScale.xyz * inPos.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(pos, 1.0);
+    fragColor = inColor.rgb;
+    fragTexCoord = dequantization.texCoordScaleOffset.zw + dequantization.texCoordScaleOffset.xy * inTexCoord;
+}
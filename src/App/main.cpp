@@ -3,14 +3,55 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
+#include <string>
+
+// frames drawn by --headless when --frames is not given
+const uint32_t HEADLESS_FRAME_COUNT = 1000;
+
+// usage : cascade_engine [--headless] [--frames N] [--device cpu|gpu|<part of the device name>]
+//                        [--scene name] [--camera-path orbit|file] [--record-camera-path file]
+//                        [--pipeline-statistics] [--no-vertex-compression] [--no-mesh-shaders]
+//                        [--trace file.json] [--check-allocations]
+// VCR_DEVICE picks the device too when --device is not given
+int main(int argc, char** argv) {
+    vcr::RendererOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frameCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            options.device = argv[++i];
+        } else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            options.scene = argv[++i];
+        } else if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+            options.cameraPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--record-camera-path") == 0 && i + 1 < argc) {
+            options.recordCameraPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--pipeline-statistics") == 0) {
+            options.pipelineStatistics = true;
+        } else if (std::strcmp(argv[i], "--no-vertex-compression") == 0) {
+            options.vertexCompression = false;
+        } else if (std::strcmp(argv[i], "--no-mesh-shaders") == 0) {
+            options.meshShaders = false;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.traceFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--check-allocations") == 0) {
+            options.checkAllocations = true;
+        } else {
+            std::cerr << "Unknown argument : " << argv[i] << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.headless && options.frameCount == 0) options.frameCount = HEADLESS_FRAME_COUNT;
 
-int main() {
-    vcr::App app{};
     try {
+        vcr::App app{options};
         app.run();
     } catch (const std::exception& e) {
         std::cerr << "Exception: " << e.what() << '\n';
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
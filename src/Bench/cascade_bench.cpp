@@ -0,0 +1,180 @@
+// Frame benchmark : a scene drawn along a camera path for a fixed number of frames, once everything
+// streamed in. The camera moves by a fixed simulated step per frame, so two runs draw the same frames
+// whatever their speed and the numbers of two builds or two machines can be compared.
+// CPU time is the whole loop iteration, GPU time the span of the frame's commands from timestamp queries.
+// the GPU profiler scopes follow with their average over the last frames, and their pipeline statistics
+// with --pipeline-statistics
+// mean, percentiles, max and variance of both are written as JSON to --output, cascade_bench_<scene>.json
+// by default as the renderer prints its own summary on stdout
+// usage : cascade_bench [--scene name] [--camera-path orbit|file] [--frames N] [--device cpu|gpu|<name>]
+//                       [--window] [--pipeline-statistics] [--no-vertex-compression] [--no-mesh-shaders]
+//                       [--output file.json]
+//                       [--trace file.json]
+
+#include "vcr_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t DEFAULT_FRAME_COUNT = 1000;
+
+struct Stats {
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double variance = 0.0;
+};
+
+// nearest rank, samples sorted
+double percentile(const std::vector<double>& samples, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::max<size_t>(rank, 1) - 1];
+}
+
+Stats computeStats(std::vector<double> samples) {
+    Stats stats;
+    stats.count = samples.size();
+    if (samples.empty()) return stats;
+    std::sort(samples.begin(), samples.end());
+    for (double sample : samples) stats.mean += sample;
+    stats.mean /= samples.size();
+    for (double sample : samples) stats.variance += (sample - stats.mean) * (sample - stats.mean);
+    stats.variance /= samples.size();
+    stats.p50 = percentile(samples, 50.0);
+    stats.p95 = percentile(samples, 95.0);
+    stats.p99 = percentile(samples, 99.0);
+    stats.max = samples.back();
+    return stats;
+}
+
+void writeStats(std::ostream& out, const char* key, const Stats& stats) {
+    out << "  \"" << key << "\": ";
+    if (stats.count == 0) {
+        out << "null";
+        return;
+    }
+    out << "{\"samples\": " << stats.count << ", \"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+        << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max
+        << ", \"variance\": " << stats.variance << "}";
+}
+
+void writeScopes(std::ostream& out, const vcr::GpuProfiler& profiler) {
+    out << "  \"gpuScopes\": [";
+    for (size_t i = 0; i < profiler.getScopeCount(); i++) {
+        const vcr::GpuScopeStats& scope = profiler.getScope(i);
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << scope.name << "\", \"average\": " << scope.averageTime;
+        if (scope.hasStatistics) {
+            out << ", \"vertexInvocations\": " << scope.statistics.vertexShaderInvocations
+                << ", \"clippingPrimitives\": " << scope.statistics.clippingPrimitives
+                << ", \"fragmentInvocations\": " << scope.statistics.fragmentShaderInvocations;
+        }
+        out << "}";
+    }
+    out << (profiler.getScopeCount() > 0 ? "\n  ]" : "]");
+}
+
+// names come from the command line and the driver, only quotes and backslashes need escaping
+std::string quote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    vcr::RendererOptions options;
+    options.headless = true;
+    options.frameCount = DEFAULT_FRAME_COUNT;
+    options.cameraPath = "orbit";
+    options.warmUp = true;
+    std::string outputPath;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            options.scene = argv[++i];
+        } else if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+            options.cameraPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frameCount = std::max(1u, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            options.device = argv[++i];
+        } else if (std::strcmp(argv[i], "--window") == 0) {
+            options.headless = false;
+        } else if (std::strcmp(argv[i], "--pipeline-statistics") == 0) {
+            options.pipelineStatistics = true;
+        } else if (std::strcmp(argv[i], "--no-vertex-compression") == 0) {
+            options.vertexCompression = false;
+        } else if (std::strcmp(argv[i], "--no-mesh-shaders") == 0) {
+            options.meshShaders = false;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.traceFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument : " << argv[i] << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (outputPath.empty()) outputPath = "cascade_bench_" + options.scene + ".json";
+
+    std::ostringstream report;
+    try {
+        vcr::Renderer renderer{options};
+        renderer.init();
+        renderer.run();
+
+        std::vector<double> cpuTimes;
+        std::vector<double> gpuTimes;
+        for (const auto& timing : renderer.getFrameTimings()) {
+            cpuTimes.push_back(timing.cpuTime);
+            if (timing.gpuTime >= 0.0) gpuTimes.push_back(timing.gpuTime);
+        }
+        VkExtent2D extent = renderer.getExtent();
+
+        report << "{\n"
+               << "  \"scene\": " << quote(options.scene) << ",\n"
+               << "  \"cameraPath\": " << quote(options.cameraPath) << ",\n"
+               << "  \"device\": " << quote(renderer.getDeviceName()) << ",\n"
+               << "  \"headless\": " << (options.headless ? "true" : "false") << ",\n"
+               << "  \"vertexCompression\": " << (options.vertexCompression ? "true" : "false") << ",\n"
+               << "  \"meshShaders\": " << (renderer.isMeshShaderDraw() ? "true" : "false") << ",\n"
+               << "  \"width\": " << extent.width << ",\n"
+               << "  \"height\": " << extent.height << ",\n"
+               << "  \"frames\": " << renderer.getFrameTimings().size() << ",\n"
+               << "  \"unit\": \"ms\",\n";
+        writeStats(report, "cpu", computeStats(std::move(cpuTimes)));
+        report << ",\n";
+        writeStats(report, "gpu", computeStats(std::move(gpuTimes)));
+        report << ",\n";
+        writeScopes(report, renderer.getGpuProfiler());
+        report << "\n}\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(outputPath);
+    output << report.str();
+    if (!output) {
+        std::cerr << "Failed to write " << outputPath << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "Results written to " << outputPath << '\n';
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+// Vertex dedup benchmark : std::unordered_map with the old xor-shift hash vs VertexDedupTable
+// usage : cascade_dedup_bench [model.obj ...]
+// every (model, method) pair runs in its own process so the peak RSS of one doesn't hide the other
+
+#include "vcr_obj_parser.hpp"
+#include "vcr_vertex_dedup.hpp"
+
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr int RUNS = 20;
+
+// the hash vcr_model.cpp used before VertexDedupTable
+struct LegacyVertexHash {
+    size_t operator()(vcr::Vertex const& vertex) const {
+        return ((std::hash<glm::vec3>()(vertex.pos) ^
+               (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+               (std::hash<glm::vec2>()(vertex.texCoord) << 1);
+    }
+};
+
+size_t peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux, bytes on macOS
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+size_t currentRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.WorkingSetSize / 1024;
+#elif defined(__linux__)
+    size_t totalPages = 0, residentPages = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) return peakRssKb();
+    if (std::fscanf(statm, "%zu %zu", &totalPages, &residentPages) != 2) residentPages = 0;
+    std::fclose(statm);
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+#else
+    return peakRssKb();
+#endif
+}
+
+// the same dedup loop loadModel ran, count then operator[]
+size_t dedupMap(const std::vector<vcr::Vertex> &corners, std::vector<vcr::Vertex> &vertices, std::vector<uint32_t> &indices) {
+    std::unordered_map<vcr::Vertex, uint32_t, LegacyVertexHash> uniqueVertices{};
+    for (const auto &vertex : corners) {
+        if (uniqueVertices.count(vertex) == 0) {
+            uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vertex);
+        }
+        indices.push_back(uniqueVertices[vertex]);
+    }
+    return vertices.size();
+}
+
+size_t dedupTable(const std::vector<vcr::Vertex> &corners, std::vector<vcr::Vertex> &vertices, std::vector<uint32_t> &indices) {
+    vcr::VertexDedupTable uniqueVertices;
+    uniqueVertices.reserve(corners.size() / 3 + 1);
+    indices.resize(corners.size());
+    for (size_t i = 0; i < corners.size(); i++) indices[i] = uniqueVertices.insert(corners[i]);
+    vertices = uniqueVertices.releaseVertices();
+    return vertices.size();
+}
+
+int runOne(const std::string &method, const std::string &path) {
+    // rebuild the un-indexed corner stream the dedup sees inside the loader
+    std::vector<vcr::Vertex> meshVertices;
+    std::vector<uint32_t> meshIndices;
+    vcr::parseObj(path, meshVertices, meshIndices, 1);
+    std::vector<vcr::Vertex> corners(meshIndices.size());
+    for (size_t i = 0; i < meshIndices.size(); i++) corners[i] = meshVertices[meshIndices[i]];
+    meshVertices = {};
+    meshIndices = {};
+
+    bool useMap = method == "map";
+    size_t rssBefore = currentRssKb();
+    double best = 1e30;
+    size_t uniqueCount = 0;
+    for (int run = 0; run < RUNS; run++) {
+        std::vector<vcr::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        auto start = std::chrono::steady_clock::now();
+        uniqueCount = useMap ? dedupMap(corners, vertices, indices) : dedupTable(corners, vertices, indices);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    size_t rssAfter = peakRssKb();
+
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    std::printf("%-20s %-6s %10zu %10zu %12.1f %12zu %12zu\n", name.c_str(), method.c_str(),
+                corners.size(), uniqueCount, best / corners.size(), rssAfter, rssAfter > rssBefore ? rssAfter - rssBefore : 0);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 4 && std::strcmp(argv[1], "--run") == 0) return runOne(argv[2], argv[3]);
+
+    std::vector<std::string> models;
+    for (int i = 1; i < argc; i++) models.push_back(argv[i]);
+    if (models.empty()) models = {"../assets/models/bunny.obj", "../assets/models/viking_room.obj"};
+
+    std::printf("%-20s %-6s %10s %10s %12s %12s %12s\n", "model", "method", "corners", "unique",
+                "ns/vertex", "peak RSS kB", "growth kB");
+    int status = 0;
+    for (const auto &model : models) {
+        for (const char* method : {"map", "table"}) {
+            std::fflush(stdout);
+            std::string command = "\"" + std::string(argv[0]) + "\" --run " + method + " \"" + model + "\"";
+            if (std::system(command.c_str()) != 0) status = 1;
+        }
+    }
+    return status;
+}
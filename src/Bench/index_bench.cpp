@@ -0,0 +1,185 @@
+// Index width check : a mesh that fits 16 bit indices and one that needs 32 bit ones go through the
+// import (parse, optimisation, LODs, meshlets) and the index buffer writes of the renderer. for both
+// the index type, the buffer sizes and what every draw reads back are verified, it fails on the first
+// mismatch. the large mesh is a generated grid, no model of the assets goes past 65535 vertices
+// usage : cascade_index_bench [small model.obj]
+
+#include "vcr_obj_parser.hpp"
+#include "vcr_mesh_optimizer.hpp"
+#include "vcr_mesh_simplifier.hpp"
+#include "vcr_meshlet.hpp"
+#include "vcr_index_buffer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// what a staging chunk holds in this check, not a multiple of anything on purpose
+const size_t CHUNK_SIZE = 4000;
+// bytes past the end of every buffer, they have to stay untouched
+const size_t GUARD_SIZE = 64;
+const uint8_t GUARD_BYTE = 0xCD;
+// 301 x 301 vertices
+const uint32_t GRID_QUADS = 300;
+
+struct MeshCase {
+    const char* name;
+    std::string path;
+    VkIndexType expectedType;
+};
+
+// quads per side + 1 vertices per side, each with its own texture coordinate so none merge
+bool writeGrid(const std::string& path, uint32_t quads) {
+    std::ofstream out(path);
+    uint32_t side = quads + 1;
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) out << "v " << x << " " << y << " 0\n";
+    }
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) out << "vt " << float(x) / quads << " " << float(y) / quads << "\n";
+    }
+    for (uint32_t y = 0; y < quads; y++) {
+        for (uint32_t x = 0; x < quads; x++) {
+            uint32_t a = y * side + x + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + side;
+            uint32_t d = c + 1;
+            out << "f " << a << "/" << a << " " << b << "/" << b << " " << d << "/" << d << "\n";
+            out << "f " << a << "/" << a << " " << d << "/" << d << " " << c << "/" << c << "\n";
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+uint32_t readIndex(const std::vector<uint8_t>& buffer, VkIndexType indexType, size_t i) {
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t index;
+        std::memcpy(&index, &buffer[i * sizeof(uint16_t)], sizeof(index));
+        return index;
+    }
+    uint32_t index;
+    std::memcpy(&index, &buffer[i * sizeof(uint32_t)], sizeof(index));
+    return index;
+}
+
+bool checkGuard(const std::vector<uint8_t>& buffer, size_t size) {
+    return std::all_of(buffer.begin() + size, buffer.end(), [](uint8_t byte) { return byte == GUARD_BYTE; });
+}
+
+const char* getTypeName(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? "uint16" : "uint32";
+}
+
+bool fail(const MeshCase& mesh, const std::string& message) {
+    std::cerr << mesh.name << " : " << message << std::endl;
+    return false;
+}
+
+bool checkMesh(const MeshCase& mesh) {
+    std::vector<vcr::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    vcr::parseObj(mesh.path, vertices, indices);
+    vcr::optimizeMesh(vertices, indices);
+    std::vector<vcr::MeshLod> lods = vcr::buildLodChain(vertices, indices);
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    size_t indexCount = indices.size();
+    if (vertexCount == 0 || lods.empty()) return fail(mesh, "nothing loaded from " + mesh.path);
+
+    // index type
+    VkIndexType indexType = vcr::chooseIndexType(vertexCount);
+    if (indexType != mesh.expectedType) {
+        return fail(mesh, std::string("index type ") + getTypeName(indexType) + " for " + std::to_string(vertexCount) +
+                              " vertices, expected " + getTypeName(mesh.expectedType));
+    }
+    VkDeviceSize indexSize = vcr::getIndexSize(indexType);
+    VkDeviceSize expectedSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    if (indexSize != expectedSize) return fail(mesh, "index size " + std::to_string(indexSize));
+
+    // the index buffer, written chunk by chunk as the staging ring does
+    VkDeviceSize bufferSize = indexSize * indexCount;
+    std::vector<uint8_t> buffer(bufferSize + GUARD_SIZE, GUARD_BYTE);
+    VkDeviceSize chunk = CHUNK_SIZE / indexSize * indexSize;
+    for (VkDeviceSize offset = 0; offset < bufferSize; offset += chunk) {
+        VkDeviceSize size = std::min(chunk, bufferSize - offset);
+        vcr::writeIndices(indices.data() + offset / indexSize, size / indexSize, indexType, buffer.data() + offset);
+    }
+    if (!checkGuard(buffer, bufferSize)) return fail(mesh, "index buffer written past its " + std::to_string(bufferSize) + " bytes");
+
+    // every LOD draw reads back its own range of the import indices
+    for (size_t level = 0; level < lods.size(); level++) {
+        const vcr::MeshLod& lod = lods[level];
+        if (size_t(lod.indexOffset) + lod.indexCount > indexCount) {
+            return fail(mesh, "LOD " + std::to_string(level) + " draws past the index buffer");
+        }
+        for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i++) {
+            uint32_t index = readIndex(buffer, indexType, i);
+            if (index != indices[i] || index >= vertexCount) {
+                return fail(mesh, "LOD " + std::to_string(level) + " index " + std::to_string(i) + " reads " +
+                                      std::to_string(index) + ", expected " + std::to_string(indices[i]));
+            }
+        }
+    }
+
+    // the culled index buffer with every meshlet visible, the largest it gets
+    vcr::MeshletData meshlets;
+    vcr::buildMeshlets(meshlets, vertices.data(), vertices.size(), indices.data() + lods[0].indexOffset, lods[0].indexCount);
+    std::vector<uint32_t> visible(meshlets.size());
+    for (uint32_t i = 0; i < visible.size(); i++) visible[i] = i;
+    std::vector<uint32_t> reference(lods[0].indexCount);
+    size_t referenceCount = vcr::writeMeshletIndices(meshlets, visible, reference.data());
+
+    VkDeviceSize culledSize = indexSize * lods[0].indexCount;
+    std::vector<uint8_t> culled(culledSize + GUARD_SIZE, GUARD_BYTE);
+    size_t written = vcr::writeMeshletIndices(meshlets, visible, indexType, culled.data());
+    if (written != referenceCount || written != lods[0].indexCount) {
+        return fail(mesh, "culled draw of " + std::to_string(written) + " indices, expected " + std::to_string(lods[0].indexCount));
+    }
+    if (!checkGuard(culled, culledSize)) return fail(mesh, "culled index buffer written past its " + std::to_string(culledSize) + " bytes");
+    for (size_t i = 0; i < written; i++) {
+        uint32_t index = readIndex(culled, indexType, i);
+        if (index != reference[i] || index >= vertexCount) {
+            return fail(mesh, "culled index " + std::to_string(i) + " reads " + std::to_string(index) + ", expected " +
+                                  std::to_string(reference[i]));
+        }
+    }
+
+    std::printf("%-10s %10u %10zu %8s %12llu %12llu %8zu\n", mesh.name, vertexCount, indexCount, getTypeName(indexType),
+                static_cast<unsigned long long>(bufferSize), static_cast<unsigned long long>(culledSize), lods.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string smallModel = argc > 1 ? argv[1] : "../assets/models/bunny.obj";
+    std::string gridPath = (std::filesystem::temp_directory_path() / "cascade_index_bench_grid.obj").string();
+    if (!writeGrid(gridPath, GRID_QUADS)) {
+        std::cerr << "Failed to write " << gridPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    const MeshCase meshes[] = {
+        {"small", smallModel, VK_INDEX_TYPE_UINT16},
+        {"grid", gridPath, VK_INDEX_TYPE_UINT32},
+    };
+
+    std::printf("%-10s %10s %10s %8s %12s %12s %8s\n", "mesh", "vertices", "indices", "type", "buffer", "culled", "LODs");
+    bool ok = true;
+    for (const auto& mesh : meshes) {
+        try {
+            ok = checkMesh(mesh);
+        } catch (const std::exception& e) {
+            ok = fail(mesh, e.what());
+        }
+        if (!ok) break;
+    }
+    std::filesystem::remove(gridPath);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,252 @@
+// Texture I/O benchmark : how many bytes go through host buffers before reaching staging memory
+// decode   : stbi_load into a pixel buffer, memcpy into staging, mips built there (the path without a cache)
+// readFile : the cache file read into a std::vector, memcpy into staging
+// mmap     : the cache file mapped, memcpy into staging (what the mesh cache does)
+// pread    : TextureCache::read straight into staging, the path Model takes when the cache exists
+// the cached paths move the whole mip chain, decode only level 0
+// then the whole assets directory read sequentially with readFile and through AsyncFileReader,
+// with the pages of every file dropped from the page cache before each run where the OS allows it
+// usage : cascade_io_bench [textures directory] [runs] [assets directory]
+// the page cache is warm after the first run of the texture table, so it measures copies rather than the disk
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "vcr_async_file_reader.hpp"
+#include "vcr_mipmap.hpp"
+#include "vcr_texture_cache.hpp"
+#include "file_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// same as STAGING_CHUNK_SIZE, kept here so the bench doesn't need Vulkan
+constexpr size_t CHUNK_SIZE = 8ull * 1024 * 1024;
+
+struct PathResult {
+    const char* name;
+    uint64_t fileBytes;
+    // bytes written to host memory other than the staging buffer
+    uint64_t intermediateBytes;
+    uint64_t memcpyBytes;
+    double ms;
+};
+
+// best of n, in milliseconds
+double timeBest(int runs, const std::function<void()> &fn) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+double toMb(uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// best effort, false when the pages can't be dropped
+bool evictFromPageCache(const std::vector<std::string> &files) {
+#ifdef __linux__
+    bool evicted = true;
+    for (const auto &file : files) {
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            evicted = false;
+            continue;
+        }
+        fdatasync(fd);
+        evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0 && evicted;
+        ::close(fd);
+    }
+    return evicted;
+#else
+    (void)files;
+    return false;
+#endif
+}
+
+struct DirectoryResult {
+    double ms = 0.0;
+    uint64_t bytes = 0;
+    uint32_t maxInFlight = 1;
+    uint64_t submitCalls = 0;
+};
+
+DirectoryResult readSequential(const std::vector<std::string> &files) {
+    DirectoryResult result;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &file : files) result.bytes += vcr::readFile(file).size();
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+DirectoryResult readAsync(const std::vector<std::string> &files, vcr::FileReaderBackend backend) {
+    DirectoryResult result;
+    auto start = std::chrono::steady_clock::now();
+    vcr::AsyncFileReader reader(64, backend);
+    for (const auto &file : files) {
+        reader.read(file, [&](vcr::FileReadResult &read) {
+            if (!read.ok()) throw std::runtime_error("Failed to read " + read.path);
+        });
+    }
+    reader.drain();
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.bytes = reader.getStats().bytesRead;
+    result.maxInFlight = reader.getStats().maxInFlight;
+    result.submitCalls = reader.getStats().submitCalls;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string textureDir = argc > 1 ? argv[1] : "../assets/textures";
+    int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    std::string assetDir = argc > 3 ? argv[3] : "../assets";
+
+    std::vector<std::filesystem::path> textures;
+    for (const auto &entry : std::filesystem::directory_iterator(textureDir)) {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg") textures.push_back(entry.path());
+    }
+    std::sort(textures.begin(), textures.end());
+    if (textures.empty()) {
+        std::cerr << "No texture in " << textureDir << std::endl;
+        return 1;
+    }
+
+    std::printf("%-20s %-9s %10s %14s %10s %10s   (MB, ms best of %d)\n",
+                "texture", "path", "file", "intermediate", "memcpy", "time", runs);
+    bool failed = false;
+    for (const auto &texture : textures) {
+        std::string path = texture.string();
+        vcr::TextureCache cache;
+        if (!cache.open(path)) {
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            bool written = false;
+            if (pixels != nullptr) {
+                // same chain Model writes
+                auto levels = vcr::computeMipChain(static_cast<uint32_t>(width), static_cast<uint32_t>(height), 4);
+                std::vector<uint8_t> chain(vcr::getMipChainSize(levels));
+                std::memcpy(chain.data(), pixels, levels[0].size);
+                vcr::generateMipChainSrgb(chain.data(), levels);
+                written = vcr::TextureCache::write(path, chain.data(), levels);
+            }
+            stbi_image_free(pixels);
+            if (!written || !cache.open(path)) {
+                std::cerr << "Failed to build the texture cache of " << path << std::endl;
+                failed = true;
+                continue;
+            }
+        }
+        uint64_t dataSize = cache.getDataSize();
+        uint64_t sourceSize = std::filesystem::file_size(texture);
+        std::string cachePath = vcr::TextureCache::getCachePath(path);
+        uint64_t cacheSize = std::filesystem::file_size(cachePath);
+
+        // stands in for the persistently mapped staging ring, touched once so page faults aren't timed
+        std::vector<char> staging(dataSize);
+        std::memset(staging.data(), 0, staging.size());
+
+        std::vector<PathResult> results;
+        std::vector<vcr::MipLevel> levels = cache.getMipLevels();
+        double decodeTime = timeBest(runs, [&]() {
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) throw std::runtime_error("Failed to load texture image!");
+            std::memcpy(staging.data(), pixels, levels[0].size);
+            stbi_image_free(pixels);
+            vcr::generateMipChainSrgb(reinterpret_cast<uint8_t*>(staging.data()), levels);
+        });
+        results.push_back({"decode", sourceSize, levels[0].size, levels[0].size, decodeTime});
+
+        double readFileTime = timeBest(runs, [&]() {
+            std::vector<char> file = vcr::readFile(cachePath);
+            std::memcpy(staging.data(), file.data() + (file.size() - dataSize), dataSize);
+        });
+        results.push_back({"readFile", cacheSize, cacheSize, dataSize, readFileTime});
+
+        double mmapTime = timeBest(runs, [&]() {
+            vcr::MappedFile file;
+            if (!file.open(cachePath)) throw std::runtime_error("Failed to map texture cache!");
+            std::memcpy(staging.data(), file.data() + (file.size() - dataSize), dataSize);
+        });
+        results.push_back({"mmap", dataSize, 0, dataSize, mmapTime});
+
+        double preadTime = timeBest(runs, [&]() {
+            vcr::TextureCache reader;
+            if (!reader.open(path)) throw std::runtime_error("Failed to open texture cache!");
+            for (uint64_t offset = 0; offset < dataSize; offset += CHUNK_SIZE) {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, dataSize - offset));
+                if (!reader.read(staging.data() + offset, offset, size)) {
+                    throw std::runtime_error("Failed to read texture cache!");
+                }
+            }
+        });
+        results.push_back({"pread", dataSize, 0, 0, preadTime});
+
+        for (const auto &result : results) {
+            std::printf("%-20s %-9s %10.2f %14.2f %10.2f %10.2f\n", texture.filename().string().c_str(),
+                        result.name, toMb(result.fileBytes), toMb(result.intermediateBytes),
+                        toMb(result.memcpyBytes), result.ms);
+        }
+    }
+
+    std::vector<std::string> files;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(assetDir)) {
+        if (entry.is_regular_file()) files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    struct Mode {
+        const char* name;
+        std::function<DirectoryResult()> run;
+    };
+    std::vector<Mode> modes = {
+        {"readFile", [&]() {return readSequential(files);}},
+        {"threads", [&]() {return readAsync(files, vcr::FileReaderBackend::THREAD_POOL);}},
+        {"io_uring", [&]() {return readAsync(files, vcr::FileReaderBackend::IO_URING);}},
+    };
+    bool cold = true;
+    std::printf("\n%zu files in %s\n", files.size(), assetDir.c_str());
+    std::printf("%-10s %10s %10s %10s %10s %10s\n", "reader", "MB", "ms", "MB/s", "depth", "submits");
+    for (const auto &mode : modes) {
+        DirectoryResult best;
+        best.ms = 1e30;
+        try {
+            for (int i = 0; i < runs; i++) {
+                cold = evictFromPageCache(files) && cold;
+                DirectoryResult result = mode.run();
+                if (result.ms < best.ms) best = result;
+            }
+        } catch (const std::exception &e) {
+            std::printf("%-10s %s\n", mode.name, e.what());
+            continue;
+        }
+        std::printf("%-10s %10.2f %10.2f %10.1f %10u %10llu\n", mode.name, toMb(best.bytes), best.ms,
+                    toMb(best.bytes) / (best.ms / 1000.0), best.maxInFlight,
+                    static_cast<unsigned long long>(best.submitCalls));
+    }
+    std::printf("(best of %d, %s page cache)\n", runs, cold ? "cold" : "warm");
+    return failed ? 1 : 0;
+}
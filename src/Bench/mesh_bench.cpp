@@ -0,0 +1,126 @@
+// OBJ load benchmark : tinyobj reference vs the chunked parser at several thread counts,
+// every output checked element by element against tinyobj, then the post-transform cache stats
+// of every model before and after the import optimisation
+// usage : cascade_mesh_bench [models directory] [runs]
+
+#include "vcr_obj_parser.hpp"
+#include "vcr_mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// best of n, in milliseconds
+double timeBest(int runs, const std::function<void()> &fn) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+std::ostream &operator<<(std::ostream &out, const vcr::Vertex &vertex) {
+    return out << "pos (" << vertex.pos.x << " " << vertex.pos.y << " " << vertex.pos.z << ") color ("
+               << vertex.color.x << " " << vertex.color.y << " " << vertex.color.z << ") uv ("
+               << vertex.texCoord.x << " " << vertex.texCoord.y << ")";
+}
+
+// both loaders dedup on first occurrence, so the streams have to match element by element.
+// the first difference, empty when there is none
+std::string compareMeshes(const std::vector<vcr::Vertex> &refVertices, const std::vector<uint32_t> &refIndices,
+                          const std::vector<vcr::Vertex> &vertices, const std::vector<uint32_t> &indices) {
+    std::ostringstream difference;
+    difference << std::setprecision(9);
+    if (vertices.size() != refVertices.size() || indices.size() != refIndices.size()) {
+        difference << vertices.size() << " vertices and " << indices.size() << " indices, tinyobj has "
+                   << refVertices.size() << " and " << refIndices.size();
+        return difference.str();
+    }
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (vertices[i] == refVertices[i]) continue;
+        difference << "vertex " << i << " : " << vertices[i] << "\n    tinyobj : " << refVertices[i];
+        return difference.str();
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] == refIndices[i]) continue;
+        difference << "index " << i << " : " << indices[i] << ", tinyobj " << refIndices[i];
+        return difference.str();
+    }
+    return difference.str();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string modelDir = argc > 1 ? argv[1] : "../assets/models";
+    int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    const uint32_t threadCounts[] = {1, 2, 4, 8, 16};
+
+    std::vector<std::filesystem::path> models;
+    for (const auto &entry : std::filesystem::directory_iterator(modelDir)) {
+        if (entry.path().extension() == ".obj") models.push_back(entry.path());
+    }
+    std::sort(models.begin(), models.end());
+    if (models.empty()) {
+        std::cerr << "No .obj file in " << modelDir << std::endl;
+        return 1;
+    }
+
+    std::printf("%-20s %10s %10s %10s", "model", "vertices", "indices", "tinyobj");
+    for (uint32_t threads : threadCounts) std::printf(" %9ut", threads);
+    std::printf("   (ms, best of %d)\n", runs);
+
+    for (const auto &model : models) {
+        std::string path = model.string();
+        std::vector<vcr::Vertex> refVertices, vertices;
+        std::vector<uint32_t> refIndices, indices;
+
+        double refTime = timeBest(runs, [&]() { vcr::parseObjTinyObj(path, refVertices, refIndices); });
+        std::printf("%-20s %10zu %10zu %10.2f", model.filename().string().c_str(),
+                    refVertices.size(), refIndices.size(), refTime);
+
+        for (uint32_t threads : threadCounts) {
+            double time = timeBest(runs, [&]() { vcr::parseObj(path, vertices, indices, threads); });
+            std::printf(" %10.2f", time);
+            std::string difference = compareMeshes(refVertices, refIndices, vertices, indices);
+            if (!difference.empty()) {
+                std::printf("\n");
+                std::fflush(stdout);
+                std::cerr << model.filename().string() << " with " << threads << " threads differs from tinyobj, "
+                          << difference << std::endl;
+                return 1;
+            }
+        }
+        std::printf("\n");
+    }
+
+    std::printf("\n%-20s %10s %10s %10s %10s %10s\n", "model", "ACMR", "ACMR opt", "ATVR", "ATVR opt", "opt ms");
+    for (const auto &model : models) {
+        std::vector<vcr::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        vcr::parseObj(model.string(), vertices, indices);
+
+        vcr::MeshOptimizationReport report{};
+        auto start = std::chrono::steady_clock::now();
+        report = vcr::optimizeMesh(vertices, indices);
+        auto end = std::chrono::steady_clock::now();
+        std::printf("%-20s %10.3f %10.3f %10.3f %10.3f %10.2f\n", model.filename().string().c_str(),
+                    report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr,
+                    std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    return 0;
+}
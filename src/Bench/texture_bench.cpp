@@ -0,0 +1,168 @@
+// Texture decode benchmark : every texture of the directory, repeated to stand in for a scene with
+// many textures, decoded to RGBA8 on 1..N threads. The files are read once up front, only decoding is timed.
+// The first table is the single threaded cost of each texture, decode then the sRGB mip chain built
+// by the scalar reference and the SIMD path (checked to match), the second the whole set on a growing pool,
+// the last the block compression of each chain : size, PSNR of level 0 against RGBA8, time on 1 and N threads
+// usage : cascade_texture_bench [textures directory] [copies] [runs]
+
+#include "vcr_block_compression.hpp"
+#include "vcr_mipmap.hpp"
+#include "vcr_texture_decoder.hpp"
+#include "file_utils.hpp"
+#include "thread_utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// best of n, in milliseconds
+double timeBest(int runs, const std::function<void()> &fn) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string textureDir = argc > 1 ? argv[1] : "../assets/textures";
+    int copies = argc > 2 ? std::max(1, std::atoi(argv[2])) : 8;
+    int runs = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(textureDir)) {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg") paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cerr << "No texture in " << textureDir << std::endl;
+        return 1;
+    }
+    std::vector<std::vector<char>> files;
+    for (const auto &path : paths) files.push_back(vcr::readFile(path.string()));
+
+    std::printf("%-20s %10s %8s %10s %10s %10s   (ms, best of %d)\n",
+                "texture", "size", "channels", "decode", "mips", "mips simd", runs);
+    uint64_t texelsPerSet = 0;
+    bool mismatch = false;
+    // full chains, kept for the compression table
+    std::vector<std::vector<uint8_t>> chains;
+    for (size_t i = 0; i < files.size(); i++) {
+        const auto &file = files[i];
+        vcr::DecodedTexture texture;
+        double time = timeBest(runs, [&]() {
+            if (!vcr::decodeTextureRgba8(file.data(), file.size(), texture)) {
+                throw std::runtime_error("Failed to load texture image!");
+            }
+        });
+        texelsPerSet += uint64_t(texture.width) * texture.height;
+
+        std::vector<vcr::MipLevel> levels = vcr::computeMipChain(texture.width, texture.height, 4);
+        std::vector<uint8_t> scalarChain(vcr::getMipChainSize(levels));
+        std::vector<uint8_t> simdChain(scalarChain.size());
+        std::memcpy(scalarChain.data(), texture.pixels.get(), levels[0].size);
+        std::memcpy(simdChain.data(), texture.pixels.get(), levels[0].size);
+        double scalarTime = timeBest(runs, [&]() {vcr::generateMipChainSrgbScalar(scalarChain.data(), levels);});
+        double simdTime = timeBest(runs, [&]() {vcr::generateMipChainSrgb(simdChain.data(), levels);});
+        mismatch = mismatch || scalarChain != simdChain;
+        chains.push_back(std::move(simdChain));
+
+        std::string size = std::to_string(texture.width) + "x" + std::to_string(texture.height);
+        std::printf("%-20s %10s %8u %10.2f %10.2f %10.2f\n", paths[i].filename().string().c_str(), size.c_str(),
+                    texture.sourceChannels, time, scalarTime, simdTime);
+    }
+    if (mismatch) {
+        std::cerr << "SIMD mip chain differs from the scalar one" << std::endl;
+        return 1;
+    }
+
+    size_t jobCount = files.size() * static_cast<size_t>(copies);
+    double megaTexels = static_cast<double>(texelsPerSet) * copies / 1e6;
+    std::printf("\n%zu decodes (%d copies of the set, %.1f Mtexels)\n", jobCount, copies, megaTexels);
+    std::printf("%8s %12s %12s %10s\n", "threads", "ms", "Mtexels/s", "speedup");
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < vcr::defaultThreadCount(); threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(vcr::defaultThreadCount());
+
+    double singleThreadTime = 0.0;
+    for (uint32_t threads : threadCounts) {
+        double time = timeBest(runs, [&]() {
+            // one texture per job like the streamer's workers, handed out dynamically as sizes differ
+            std::atomic<size_t> next{0};
+            vcr::parallelFor(threads, threads, [&](size_t, size_t, uint32_t) {
+                vcr::DecodedTexture texture;
+                for (size_t job = next++; job < jobCount; job = next++) {
+                    const auto &file = files[job % files.size()];
+                    if (!vcr::decodeTextureRgba8(file.data(), file.size(), texture)) {
+                        throw std::runtime_error("Failed to load texture image!");
+                    }
+                }
+            });
+        });
+        if (threads == 1) singleThreadTime = time;
+        std::printf("%8u %12.2f %12.1f %9.2fx\n", threads, time, megaTexels / (time / 1000.0), singleThreadTime / time);
+    }
+
+    std::printf("\n%-20s %-6s %10s %10s %10s %10s %10s\n", "texture", "format", "MB", "ratio", "PSNR dB", "1 thread", "all");
+    for (size_t i = 0; i < files.size(); i++) {
+        vcr::DecodedTexture texture;
+        vcr::decodeTextureRgba8(files[i].data(), files[i].size(), texture);
+        std::vector<vcr::MipLevel> levels = vcr::computeMipChain(texture.width, texture.height, 4);
+        const uint8_t* chain = chains[i].data();
+        for (vcr::BlockFormat format : {vcr::BlockFormat::BC1, vcr::BlockFormat::BC3, vcr::BlockFormat::BC7}) {
+            std::vector<uint8_t> blocks;
+            double singleTime = timeBest(runs, [&]() {blocks = vcr::compressMipChain(format, chain, levels, 1);});
+            double allTime = timeBest(runs, [&]() {
+                blocks = vcr::compressMipChain(format, chain, levels, vcr::defaultThreadCount());
+            });
+
+            // color error of level 0, alpha is opaque in the test set
+            uint32_t blockSize = vcr::getBlockSize(format);
+            uint32_t blocksWide = (texture.width + vcr::BLOCK_EXTENT - 1) / vcr::BLOCK_EXTENT;
+            uint32_t blocksHigh = (texture.height + vcr::BLOCK_EXTENT - 1) / vcr::BLOCK_EXTENT;
+            double squaredError = 0.0;
+            uint8_t texels[vcr::BLOCK_EXTENT * vcr::BLOCK_EXTENT * 4];
+            for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+                for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+                    vcr::decompressBlock(format, blocks.data() + (size_t(blockY) * blocksWide + blockX) * blockSize, texels);
+                    for (uint32_t y = 0; y < vcr::BLOCK_EXTENT; y++) {
+                        for (uint32_t x = 0; x < vcr::BLOCK_EXTENT; x++) {
+                            uint32_t texelX = blockX * vcr::BLOCK_EXTENT + x;
+                            uint32_t texelY = blockY * vcr::BLOCK_EXTENT + y;
+                            if (texelX >= texture.width || texelY >= texture.height) continue;
+                            for (int c = 0; c < 3; c++) {
+                                double d = double(texels[(y * vcr::BLOCK_EXTENT + x) * 4 + c]) -
+                                           chain[(size_t(texelY) * texture.width + texelX) * 4 + c];
+                                squaredError += d * d;
+                            }
+                        }
+                    }
+                }
+            }
+            double mse = squaredError / (3.0 * texture.width * texture.height);
+            double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+            std::printf("%-20s %-6s %10.2f %9.1fx %10.2f %10.2f %10.2f\n", paths[i].filename().string().c_str(),
+                        vcr::getBlockFormatName(format), blocks.size() / (1024.0 * 1024.0),
+                        double(chains[i].size()) / blocks.size(), psnr, singleTime, allTime);
+        }
+    }
+    return 0;
+}
@@ -10,6 +10,8 @@ KeyboardMovementController::KeyboardMovementController(Window& window, Camera& c
 KeyboardMovementController::~KeyboardMovementController() {}
 
 void KeyboardMovementController::processInput(float dt) {
+    // headless, the camera stays where it was put
+    if (window.isHeadless()) return;
     if (glfwGetKey(window.getWindow(), keyMapping.shift) == GLFW_PRESS) {
         moveSpeed = SLOW_MOVE_SPEED;
         lookSpeed = SLOW_LOOK_SPEED;
@@ -0,0 +1,94 @@
+#include "vcr_allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef VCR_COUNT_ALLOCATIONS
+
+namespace vcr {
+
+namespace {
+
+// constant initialized, touching it never allocates
+thread_local uint64_t threadAllocationCount = 0;
+
+} // namespace
+
+uint64_t getThreadAllocationCount() {
+    return threadAllocationCount;
+}
+
+bool isAllocationCountingEnabled() {
+    return true;
+}
+
+} // namespace vcr
+
+// every unaligned form, so none is left paired with a runtime's own delete. the aligned ones keep theirs
+void* operator new(std::size_t size) {
+    vcr::threadAllocationCount++;
+    if (size == 0) size = 1;
+    while (true) {
+        void* pointer = std::malloc(size);
+        if (pointer) return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+#else
+
+namespace vcr {
+
+uint64_t getThreadAllocationCount() {
+    return 0;
+}
+
+bool isAllocationCountingEnabled() {
+    return false;
+}
+
+} // namespace vcr
+
+#endif
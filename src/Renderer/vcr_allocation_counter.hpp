@@ -0,0 +1,30 @@
+#ifndef VCR_ALLOCATION_COUNTER_HPP
+#define VCR_ALLOCATION_COUNTER_HPP
+
+#include <cstdint>
+
+// debug builds replace the global operator new to count heap allocations
+#ifndef NDEBUG
+#define VCR_COUNT_ALLOCATIONS 1
+#endif
+
+namespace vcr {
+
+// allocations the calling thread made through operator new since it started, 0 when not counting.
+// malloc, driver allocations and over-aligned news are not seen
+uint64_t getThreadAllocationCount();
+bool isAllocationCountingEnabled();
+
+// what the calling thread allocates between construction and getCount
+class AllocationScope {
+private:
+    uint64_t start;
+
+public:
+    AllocationScope() : start(getThreadAllocationCount()) {}
+    uint64_t getCount() const {return getThreadAllocationCount() - start;}
+};
+
+} // namespace vcr
+
+#endif // VCR_ALLOCATION_COUNTER_HPP
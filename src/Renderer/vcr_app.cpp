@@ -2,6 +2,8 @@
 
 namespace vcr {
 
+App::App(const RendererOptions& options) : renderer(options) {}
+
 void App::run() {
     renderer.init();
     renderer.run();
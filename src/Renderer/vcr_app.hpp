@@ -11,6 +11,7 @@ class App {
 private:
     Renderer renderer;
 public:
+    App(const RendererOptions& options = {});
     void run();
 private:
 };
@@ -0,0 +1,196 @@
+#include "vcr_asset_streamer.hpp"
+
+#include "vcr_trace.hpp"
+#include "thread_utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace vcr {
+
+AssetStreamer::AssetStreamer(Device& device, uint32_t workerCount) : device(device) {
+    if (workerCount == 0) workerCount = std::max(defaultThreadCount(), 2u) - 1;
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&AssetStreamer::workerLoop, this);
+    }
+}
+
+AssetStreamer::~AssetStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+    condition.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void AssetStreamer::requestModel(Model& model, const std::string& filePath) {
+    Job job;
+    job.load = [&model, filePath]() {model.loadModel(filePath);};
+    job.createUploads = [&model](std::vector<UploadStep>& steps) {model.createMeshUploads(steps);};
+    job.onResident = [&model]() {model.setMeshResident();};
+    enqueue(std::move(job));
+}
+
+void AssetStreamer::requestTexture(Model& model, const std::string& filePath) {
+    Job job;
+    job.createUploads = [&model](std::vector<UploadStep>& steps) {model.createTextureUploads(steps);};
+    job.onResident = [this, &model]() {
+        model.commitTextureLevel();
+        residentTextureBytes += model.getTextureLevelsSize(model.getTextureBaseLevel());
+        model.setTextureResident();
+    };
+    // a cached texture is read into the staging ring by its upload steps, nothing to decode
+    if (model.openTextureCache(filePath)) {
+        pushLoaded(std::move(job));
+        return;
+    }
+    fileReader.read(filePath, [this, &model, filePath, job](FileReadResult& result) mutable {
+        if (!result.ok()) {
+            job.error = std::make_exception_ptr(std::runtime_error("Failed to read " + filePath + " : " +
+                                                                   std::strerror(result.error)));
+            pushLoaded(std::move(job));
+            return;
+        }
+        auto data = std::make_shared<FileBuffer>(std::move(result.buffer));
+        job.load = [&model, filePath, data]() {model.decodeTexture(filePath, data->data(), data->size());};
+        enqueue(std::move(job));
+    });
+    fileReader.submit();
+}
+
+bool AssetStreamer::requestTextureLevel(Model& model, uint32_t baseLevel) {
+    if (!model.isTextureResident() || levelRequests.count(&model)) return false;
+    uint32_t currentLevel = model.getTextureBaseLevel();
+    uint32_t tailLevel = model.getTextureTailLevel();
+    baseLevel = std::min(baseLevel, tailLevel);
+    // the current image stays until the new one is committed and retired until nothing samples it
+    while (baseLevel < currentLevel && residentTextureBytes + model.getTextureLevelsSize(baseLevel) > textureMemoryBudget) {
+        baseLevel++;
+    }
+    if (baseLevel == currentLevel) return false;
+    residentTextureBytes += model.getTextureLevelsSize(baseLevel);
+
+    // nothing to load, the levels are read from the cache as they are staged
+    Job job;
+    job.createUploads = [&model, baseLevel](std::vector<UploadStep>& steps) {
+        model.createTextureLevelUploads(baseLevel, steps);
+    };
+    job.onResident = [this, &model]() {
+        model.commitTextureLevel();
+        levelRequests.erase(&model);
+    };
+    levelRequests.insert(&model);
+    pushLoaded(std::move(job));
+    return true;
+}
+
+void AssetStreamer::releaseRetiredTextures(Model& model) {
+    residentTextureBytes -= model.getRetiredTexturesSize();
+    model.releaseRetiredTextures();
+}
+
+void AssetStreamer::enqueue(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(job));
+    }
+    condition.notify_one();
+}
+
+void AssetStreamer::pushLoaded(Job job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded.push_back(std::move(job));
+}
+
+void AssetStreamer::workerLoop() {
+    setTraceThreadName("asset worker");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        condition.wait(lock, [this]() {return stopping || !requests.empty();});
+        if (stopping) return;
+        Job job = std::move(requests.front());
+        requests.pop_front();
+        loadingCount++;
+
+        lock.unlock();
+        try {
+            TraceScope trace{"load asset"};
+            job.load();
+        } catch (...) {
+            job.error = std::current_exception();
+        }
+        lock.lock();
+
+        loadingCount--;
+        loaded.push_back(std::move(job));
+    }
+}
+
+void AssetStreamer::update(const StreamingBudget& budget) {
+    TraceScope trace{"AssetStreamer::update"};
+    auto start = std::chrono::steady_clock::now();
+    UploadContext& uploadContext = device.getUploadContext();
+    // completed reads go to the decode workers
+    fileReader.poll();
+
+    // tickets complete in order, so does residency
+    while (!inFlight.empty() && uploadContext.isComplete(inFlight.front().ticket)) {
+        inFlight.front().onResident();
+        inFlight.pop_front();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(loaded);
+    }
+    for (auto& job : ready) {
+        if (job.error) std::rethrow_exception(job.error);
+        PendingUpload upload;
+        job.createUploads(upload.steps);
+        upload.onResident = std::move(job.onResident);
+        uploads.push_back(std::move(upload));
+    }
+    ready.clear();
+
+    VkDeviceSize bytes = 0;
+    bool recorded = false;
+    std::vector<std::function<void()>> finished;
+    while (!uploads.empty()) {
+        PendingUpload& upload = uploads.front();
+        if (upload.nextStep < upload.steps.size()) {
+            const UploadStep& step = upload.steps[upload.nextStep];
+            if (recorded && (bytes + step.bytes > budget.maxBytesPerFrame ||
+                             std::chrono::steady_clock::now() - start >= budget.maxTimePerFrame)) {
+                break;
+            }
+            step.record(uploadContext.begin());
+            recorded = true;
+            bytes += step.bytes;
+            upload.nextStep++;
+        }
+        if (upload.nextStep == upload.steps.size()) {
+            finished.push_back(std::move(upload.onResident));
+            uploads.pop_front();
+        }
+    }
+    if (!recorded && finished.empty()) return;
+
+    UploadTicket ticket = uploadContext.submit();
+    uploadedBytes += bytes;
+    for (auto& onResident : finished) {
+        inFlight.push_back({ticket, std::move(onResident)});
+    }
+}
+
+bool AssetStreamer::isIdle() {
+    if (!uploads.empty() || !inFlight.empty() || !fileReader.isIdle()) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests.empty() && loaded.empty() && loadingCount == 0;
+}
+
+} // namespace vcr
@@ -0,0 +1,119 @@
+#ifndef VCR_ASSET_STREAMER_HPP
+#define VCR_ASSET_STREAMER_HPP
+
+#include "vcr_async_file_reader.hpp"
+#include "vcr_device.hpp"
+#include "vcr_model.hpp"
+#include "vcr_upload_context.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace vcr {
+
+// what update may spend on uploads in one frame, whichever runs out first.
+// one step always goes out so a step bigger than the budget still makes progress
+struct StreamingBudget {
+    VkDeviceSize maxBytesPerFrame = 8ull * 1024 * 1024;
+    std::chrono::microseconds maxTimePerFrame{2000};
+};
+
+// Loads assets in the background : file reads go through an AsyncFileReader, parsing and
+// decoding run on a pool of worker threads, the GPU side (resource creation, staging, submission)
+// runs in update on the main thread, spread over frames by a StreamingBudget. An asset is flagged resident on its model once
+// the submission carrying its last step completed, until then the renderer has to skip it
+// or draw a placeholder
+class AssetStreamer {
+private:
+    struct Job {
+        // worker thread
+        std::function<void()> load;
+        // main thread, once load returned
+        std::function<void(std::vector<UploadStep>&)> createUploads;
+        std::function<void()> onResident;
+        std::exception_ptr error;
+    };
+
+    struct PendingUpload {
+        std::vector<UploadStep> steps;
+        size_t nextStep = 0;
+        std::function<void()> onResident;
+    };
+
+    struct InFlightUpload {
+        UploadTicket ticket;
+        std::function<void()> onResident;
+    };
+
+    Device& device;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Job> requests;
+    std::deque<Job> loaded;
+    uint32_t loadingCount = 0;
+    bool stopping = false;
+
+    // main thread only
+    AsyncFileReader fileReader;
+    std::deque<PendingUpload> uploads;
+    // swapped with loaded every update, kept so a frame with nothing to stream allocates nothing
+    std::deque<Job> ready;
+    // oldest first, tickets complete in order
+    std::deque<InFlightUpload> inFlight;
+    VkDeviceSize uploadedBytes = 0;
+    // texture levels on the GPU against the budget, the mip tails always are. a level change holds
+    // two images : the new one counts from its request, the replaced one until releaseRetiredTextures
+    VkDeviceSize textureMemoryBudget = ~0ull;
+    VkDeviceSize residentTextureBytes = 0;
+    // models with a level change requested but not committed yet
+    std::unordered_set<const Model*> levelRequests;
+
+    void enqueue(Job job);
+    void pushLoaded(Job job);
+    void workerLoop();
+
+public:
+    // 0 workers is one per core but the one rendering, textures then decode concurrently
+    AssetStreamer(Device& device, uint32_t workerCount = 0);
+    // waits for the loads in progress, the ones not started yet are dropped
+    ~AssetStreamer();
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    // the model has to outlive the streamer. its mesh and its texture touch disjoint members
+    // so both can be requested at once, but not the same one twice
+    void requestModel(Model& model, const std::string& filePath);
+    void requestTexture(Model& model, const std::string& filePath);
+    // makes baseLevel the finest level of a resident texture, finer ones are uploaded and coarser ones
+    // dropped. a finer request is coarsened until it fits the budget next to what is already there.
+    // false when nothing changes or a change is already on its way
+    bool requestTextureLevel(Model& model, uint32_t baseLevel);
+    // Model::releaseRetiredTextures, taking the replaced images off the budget
+    void releaseRetiredTextures(Model& model);
+    // only finer levels requested afterwards are held to it
+    void setTextureMemoryBudget(VkDeviceSize bytes) {textureMemoryBudget = bytes;}
+
+    // once per frame, rethrows what a worker threw
+    void update(const StreamingBudget& budget = {});
+
+    bool isIdle();
+    VkDeviceSize getUploadedBytes() const {return uploadedBytes;}
+    VkDeviceSize getResidentTextureBytes() const {return residentTextureBytes;}
+};
+
+} // namespace vcr
+
+#endif // VCR_ASSET_STREAMER_HPP
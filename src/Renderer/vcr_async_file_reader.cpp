@@ -0,0 +1,458 @@
+#include "vcr_async_file_reader.hpp"
+
+#include "file_utils.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef VCR_HAS_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace vcr {
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// a single read is capped so its result fits in the 32 bit completion, longer files take several
+constexpr uint64_t MAX_READ_SIZE = 1ull << 30;
+
+} // namespace
+
+void FileBuffer::Free::operator()(char* data) const {
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+FileBuffer FileBuffer::allocate(size_t size) {
+    FileBuffer buffer;
+    buffer.capacity = static_cast<size_t>(alignUp(std::max<size_t>(size, 1), FILE_BUFFER_ALIGNMENT));
+#ifdef _WIN32
+    buffer.storage.reset(static_cast<char*>(_aligned_malloc(buffer.capacity, FILE_BUFFER_ALIGNMENT)));
+#else
+    void* data = nullptr;
+    if (posix_memalign(&data, FILE_BUFFER_ALIGNMENT, buffer.capacity) == 0) {
+        buffer.storage.reset(static_cast<char*>(data));
+    }
+#endif
+    if (!buffer.storage) {
+        throw std::runtime_error("Failed to allocate file buffer!");
+    }
+    buffer.byteSize = size;
+    return buffer;
+}
+
+struct AsyncFileReader::Request {
+    FileReadResult result;
+    Callback callback;
+#ifdef VCR_HAS_IO_URING
+    int fd = -1;
+    uint64_t fileSize = 0;
+    // bytes read so far
+    uint64_t offset = 0;
+    bool direct = false;
+    struct iovec iov{};
+#endif
+};
+
+#ifdef VCR_HAS_IO_URING
+
+struct AsyncFileReader::Ring {
+    int fd = -1;
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    // written to the submission queue, not passed to the kernel yet
+    unsigned toSubmit = 0;
+
+    int enter(unsigned submitCount, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, submitCount, minComplete, flags, nullptr, 0));
+    }
+
+    void flush() {
+        while (toSubmit > 0) {
+            int submitted = enter(toSubmit, 0, 0);
+            if (submitted < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (submitted <= 0) {
+                throw std::runtime_error("Failed to submit file reads!");
+            }
+            toSubmit -= static_cast<unsigned>(submitted);
+        }
+    }
+};
+
+bool AsyncFileReader::initRing() {
+    io_uring_params params{};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+    if (fd < 0) return false;
+
+    ring = std::make_unique<Ring>();
+    ring->fd = fd;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+
+    void* sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        destroyRing();
+        return false;
+    }
+    ring->sqRing = sqRing;
+    if (singleMap) {
+        ring->cqRing = sqRing;
+    } else {
+        void* cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            destroyRing();
+            return false;
+        }
+        ring->cqRing = cqRing;
+    }
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        destroyRing();
+        return false;
+    }
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(ring->sqRing);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(ring->cqRing);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    // the kernel may round the depth up, never down
+    queueDepth = std::min(queueDepth, params.sq_entries);
+    return true;
+}
+
+void AsyncFileReader::destroyRing() {
+    if (!ring) return;
+    if (ring->sqes != nullptr) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing != nullptr && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing != nullptr) munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0) ::close(ring->fd);
+    ring.reset();
+}
+
+bool AsyncFileReader::startRead(Request& request) {
+    request.fd = ::open(request.result.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (request.fd < 0) {
+        request.result.error = errno;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(request.fd, &fileStat) != 0) {
+        request.result.error = errno;
+        ::close(request.fd);
+        request.fd = -1;
+        return false;
+    }
+    request.fileSize = static_cast<uint64_t>(fileStat.st_size);
+    request.result.buffer = FileBuffer::allocate(static_cast<size_t>(request.fileSize));
+    if (request.fileSize == 0) {
+        ::close(request.fd);
+        request.fd = -1;
+        return false;
+    }
+    if (request.fileSize >= DIRECT_IO_THRESHOLD) {
+        // refused by file systems without direct I/O (tmpfs), the read then goes through the page cache
+        int flags = fcntl(request.fd, F_GETFL);
+        request.direct = flags >= 0 && fcntl(request.fd, F_SETFL, flags | O_DIRECT) == 0;
+    }
+    queueRingRead(request);
+    return true;
+}
+
+void AsyncFileReader::queueRingRead(Request& request) {
+    uint64_t remaining = request.fileSize - request.offset;
+    // direct reads ask for whole blocks, the buffer has room for the last one
+    uint64_t length = request.direct ? alignUp(remaining, FILE_BUFFER_ALIGNMENT) : remaining;
+    length = std::min(length, MAX_READ_SIZE);
+    request.iov.iov_base = request.result.buffer.data() + request.offset;
+    request.iov.iov_len = static_cast<size_t>(length);
+
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    io_uring_sqe& sqe = ring->sqes[index];
+    sqe = {};
+    // READV rather than READ, it is there since the first io_uring kernels
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = request.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(&request.iov);
+    sqe.len = 1;
+    sqe.off = request.offset;
+    sqe.user_data = reinterpret_cast<uint64_t>(&request);
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->toSubmit++;
+}
+
+size_t AsyncFileReader::reapRing(std::vector<std::unique_ptr<Request>>& completed) {
+    size_t count = 0;
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+        Request* request = reinterpret_cast<Request*>(cqe.user_data);
+        int result = cqe.res;
+        bool finished = true;
+        if (result == -EAGAIN || result == -EINTR) {
+            finished = false;
+        } else if (result == -EINVAL && request->direct) {
+            // the device wants a bigger alignment than ours, fall back to buffered reads
+            fcntl(request->fd, F_SETFL, fcntl(request->fd, F_GETFL) & ~O_DIRECT);
+            request->direct = false;
+            finished = false;
+        } else if (result < 0) {
+            request->result.error = -result;
+        } else if (result == 0) {
+            // the file shrank since fstat
+            if (request->offset < request->fileSize) request->result.error = EIO;
+        } else {
+            request->offset += static_cast<uint64_t>(result);
+            if (request->offset < request->fileSize) {
+                if (request->direct && request->offset % FILE_BUFFER_ALIGNMENT != 0) {
+                    fcntl(request->fd, F_SETFL, fcntl(request->fd, F_GETFL) & ~O_DIRECT);
+                    request->direct = false;
+                }
+                finished = false;
+            }
+        }
+
+        if (finished) {
+            ::close(request->fd);
+            request->fd = -1;
+            ringInFlight--;
+            completed.emplace_back(request);
+            count++;
+        } else {
+            queueRingRead(*request);
+        }
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+#else
+
+struct AsyncFileReader::Ring {};
+
+bool AsyncFileReader::initRing() {return false;}
+void AsyncFileReader::destroyRing() {}
+bool AsyncFileReader::startRead(Request&) {return false;}
+void AsyncFileReader::queueRingRead(Request&) {}
+size_t AsyncFileReader::reapRing(std::vector<std::unique_ptr<Request>>&) {return 0;}
+
+#endif
+
+AsyncFileReader::AsyncFileReader(uint32_t queueDepth, FileReaderBackend backend, uint32_t threadCount)
+    : queueDepth(std::max(queueDepth, 1u)) {
+    if (backend != FileReaderBackend::THREAD_POOL && initRing()) {
+        this->backend = FileReaderBackend::IO_URING;
+        return;
+    }
+    if (backend == FileReaderBackend::IO_URING) {
+        throw std::runtime_error("Failed to set up io_uring!");
+    }
+    this->backend = FileReaderBackend::THREAD_POOL;
+    threadCount = std::max(threadCount, 1u);
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&AsyncFileReader::workerLoop, this);
+    }
+}
+
+AsyncFileReader::~AsyncFileReader() {
+#ifdef VCR_HAS_IO_URING
+    if (ring) {
+        // the kernel writes into the buffers until the reads complete
+        ring->flush();
+        std::vector<std::unique_ptr<Request>> completed;
+        while (ringInFlight > 0) {
+            ring->enter(0, 1, IORING_ENTER_GETEVENTS);
+            reapRing(completed);
+            ring->flush();
+        }
+        destroyRing();
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        work.clear();
+    }
+    workCondition.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void AsyncFileReader::read(const std::string& path, Callback callback) {
+    auto request = std::make_unique<Request>();
+    request->result.path = path;
+    request->callback = std::move(callback);
+    pending.push_back(std::move(request));
+}
+
+void AsyncFileReader::submit() {
+    uint32_t count = 0;
+    while (!pending.empty() && stats.inFlight + count < queueDepth) {
+        std::unique_ptr<Request> request = std::move(pending.front());
+        pending.pop_front();
+        count++;
+        if (ring) {
+            if (startRead(*request)) {
+                ringInFlight++;
+                request.release();
+            } else {
+                // failed to open or empty, completes on the next poll
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(std::move(request));
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(mutex);
+            work.push_back(std::move(request));
+        }
+    }
+    if (count == 0) return;
+    onSubmitted(count);
+#ifdef VCR_HAS_IO_URING
+    if (ring && ring->toSubmit > 0) {
+        ring->flush();
+        stats.submitCalls++;
+    }
+#endif
+    if (!ring) workCondition.notify_all();
+}
+
+void AsyncFileReader::onSubmitted(uint32_t count) {
+    if (stats.inFlight == 0) busyStart = std::chrono::steady_clock::now();
+    stats.submitted += count;
+    stats.inFlight += count;
+    stats.maxInFlight = std::max(stats.maxInFlight, stats.inFlight);
+}
+
+void AsyncFileReader::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workCondition.wait(lock, [this]() {return stopping || !work.empty();});
+        if (stopping) return;
+        std::unique_ptr<Request> request = std::move(work.front());
+        work.pop_front();
+        lock.unlock();
+
+        FileReader file;
+        FileReadResult& result = request->result;
+        errno = 0;
+        if (!file.open(result.path)) {
+            result.error = errno != 0 ? errno : ENOENT;
+        } else {
+            result.buffer = FileBuffer::allocate(static_cast<size_t>(file.size()));
+            if (file.size() > 0 && !file.read(result.buffer.data(), 0, static_cast<size_t>(file.size()))) {
+                result.error = errno != 0 ? errno : EIO;
+            }
+        }
+
+        lock.lock();
+        done.push_back(std::move(request));
+        doneCondition.notify_one();
+    }
+}
+
+size_t AsyncFileReader::complete(std::vector<std::unique_ptr<Request>>& completed) {
+    for (auto& request : completed) {
+        stats.completed++;
+        stats.inFlight--;
+        if (request->result.ok()) stats.bytesRead += request->result.buffer.size();
+        if (stats.inFlight == 0) {
+            stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - busyStart).count();
+        }
+        if (request->callback) request->callback(request->result);
+    }
+    return completed.size();
+}
+
+size_t AsyncFileReader::poll() {
+    std::vector<std::unique_ptr<Request>> completed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::move(done.begin(), done.end(), std::back_inserter(completed));
+        done.clear();
+    }
+#ifdef VCR_HAS_IO_URING
+    if (ring) {
+        reapRing(completed);
+        // retries of short reads
+        ring->flush();
+    }
+#endif
+    size_t count = complete(completed);
+    // the slots freed by the completions
+    submit();
+    return count;
+}
+
+size_t AsyncFileReader::wait() {
+    submit();
+    if (stats.inFlight == 0) return poll();
+#ifdef VCR_HAS_IO_URING
+    if (ring) {
+        bool ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready = !done.empty();
+        }
+        if (!ready && __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE) == *ring->cqHead) {
+            ring->enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+        return poll();
+    }
+#endif
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this]() {return !done.empty();});
+    }
+    return poll();
+}
+
+void AsyncFileReader::drain() {
+    while (!isIdle()) wait();
+}
+
+bool AsyncFileReader::isIdle() {
+    return pending.empty() && stats.inFlight == 0;
+}
+
+} // namespace vcr
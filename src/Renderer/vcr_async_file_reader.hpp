@@ -0,0 +1,146 @@
+#ifndef VCR_ASYNC_FILE_READER_HPP
+#define VCR_ASYNC_FILE_READER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VCR_HAS_IO_URING 1
+#endif
+#endif
+
+namespace vcr {
+
+// O_DIRECT needs the buffer, the offset and the length aligned to the logical block size
+constexpr size_t FILE_BUFFER_ALIGNMENT = 4096;
+// files this big bypass the page cache, they are read once and would only evict the rest
+constexpr uint64_t DIRECT_IO_THRESHOLD = 4ull * 1024 * 1024;
+
+// a whole file in memory, the storage is rounded up to FILE_BUFFER_ALIGNMENT
+class FileBuffer {
+private:
+    struct Free {
+        void operator()(char* data) const;
+    };
+    std::unique_ptr<char, Free> storage;
+    size_t byteSize = 0;
+    size_t capacity = 0;
+
+public:
+    static FileBuffer allocate(size_t size);
+
+    char* data() {return storage.get();}
+    const char* data() const {return storage.get();}
+    size_t size() const {return byteSize;}
+    size_t getCapacity() const {return capacity;}
+};
+
+struct FileReadResult {
+    std::string path;
+    FileBuffer buffer;
+    // errno value, 0 on success
+    int error = 0;
+
+    bool ok() const {return error == 0;}
+};
+
+struct FileReaderStats {
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t bytesRead = 0;
+    // system calls that went out with at least one read, io_uring only
+    uint64_t submitCalls = 0;
+    uint32_t inFlight = 0;
+    uint32_t maxInFlight = 0;
+    // time with at least one read in flight
+    double busySeconds = 0.0;
+
+    double getMegabytesPerSecond() const {
+        return busySeconds > 0.0 ? static_cast<double>(bytesRead) / (1024.0 * 1024.0) / busySeconds : 0.0;
+    }
+};
+
+enum class FileReaderBackend {
+    AUTO,
+    IO_URING,
+    THREAD_POOL
+};
+
+// Reads whole files without blocking the caller. On Linux the reads go through io_uring :
+// every read queued since the last submit goes out in one system call, and up to queueDepth
+// of them are in flight at once. Elsewhere, or when the kernel refuses io_uring (old kernel,
+// seccomp), a pool of threads does blocking preads instead.
+// Not thread safe, callbacks run on the thread calling poll / wait, in completion order
+class AsyncFileReader {
+public:
+    using Callback = std::function<void(FileReadResult&)>;
+
+private:
+    struct Request;
+    struct Ring;
+
+    FileReaderBackend backend = FileReaderBackend::THREAD_POOL;
+    uint32_t queueDepth = 0;
+    std::unique_ptr<Ring> ring;
+    // queued by read, not submitted yet
+    std::deque<std::unique_ptr<Request>> pending;
+    uint32_t ringInFlight = 0;
+
+    // thread pool backend
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workCondition;
+    std::condition_variable doneCondition;
+    std::deque<std::unique_ptr<Request>> work;
+    std::deque<std::unique_ptr<Request>> done;
+    bool stopping = false;
+
+    FileReaderStats stats;
+    std::chrono::steady_clock::time_point busyStart;
+
+    bool initRing();
+    void destroyRing();
+    bool startRead(Request& request);
+    void queueRingRead(Request& request);
+    size_t reapRing(std::vector<std::unique_ptr<Request>>& completed);
+    void workerLoop();
+    size_t complete(std::vector<std::unique_ptr<Request>>& completed);
+    void onSubmitted(uint32_t count);
+
+public:
+    explicit AsyncFileReader(uint32_t queueDepth = 64,
+                             FileReaderBackend backend = FileReaderBackend::AUTO,
+                             uint32_t threadCount = 4);
+    // waits for the reads in flight, their callbacks don't run
+    ~AsyncFileReader();
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    // queued until the next submit
+    void read(const std::string& path, Callback callback);
+    // sends what is queued, as much as the queue depth allows, the rest goes out as reads complete
+    void submit();
+    // runs the callbacks of the completed reads, returns how many ran
+    size_t poll();
+    // like poll, blocks until at least one read completes when some are in flight
+    size_t wait();
+    // until every queued read completed
+    void drain();
+
+    bool isIdle();
+    FileReaderBackend getBackend() const {return backend;}
+    const FileReaderStats& getStats() const {return stats;}
+};
+
+} // namespace vcr
+
+#endif // VCR_ASYNC_FILE_READER_HPP
@@ -0,0 +1,520 @@
+#include "vcr_block_compression.hpp"
+
+#include "thread_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace vcr {
+
+namespace {
+
+constexpr uint32_t BLOCK_TEXELS = BLOCK_EXTENT * BLOCK_EXTENT;
+
+// BC7 4 bit index weights, out of 64
+constexpr int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+template <int N>
+using Vec = std::array<float, N>;
+
+template <int N>
+float squaredDistance(const uint8_t* texel, const int* color) {
+    float sum = 0.0f;
+    for (int c = 0; c < N; c++) {
+        float d = static_cast<float>(texel[c] - color[c]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+// endpoints of the block along its principal axis, N channels of every texel
+template <int N>
+void fitPrincipalAxis(const uint8_t* texels, Vec<N>& low, Vec<N>& high) {
+    Vec<N> mean{};
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        for (int c = 0; c < N; c++) mean[c] += texels[i * 4 + c];
+    }
+    for (int c = 0; c < N; c++) mean[c] /= BLOCK_TEXELS;
+
+    float covariance[N][N] = {};
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        Vec<N> d;
+        for (int c = 0; c < N; c++) d[c] = texels[i * 4 + c] - mean[c];
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) covariance[a][b] += d[a] * d[b];
+        }
+    }
+
+    // power iteration, starting from the row with the most variance
+    int start = 0;
+    for (int c = 1; c < N; c++) {
+        if (covariance[c][c] > covariance[start][start]) start = c;
+    }
+    Vec<N> axis;
+    for (int c = 0; c < N; c++) axis[c] = covariance[start][c];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        Vec<N> next{};
+        float length = 0.0f;
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) break;
+        length = std::sqrt(length);
+        for (int c = 0; c < N; c++) axis[c] = next[c] / length;
+    }
+    float axisLength = 0.0f;
+    for (int c = 0; c < N; c++) axisLength += axis[c] * axis[c];
+    if (axisLength < 1e-12f) {
+        // a single color
+        low = high = mean;
+        return;
+    }
+
+    float minProjection = 1e30f;
+    float maxProjection = -1e30f;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        float projection = 0.0f;
+        for (int c = 0; c < N; c++) projection += (texels[i * 4 + c] - mean[c]) * axis[c];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    for (int c = 0; c < N; c++) {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minProjection));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxProjection));
+    }
+}
+
+// endpoints minimising the squared error for fixed indices, weights are how much of the second endpoint each texel takes.
+// false when the system is degenerate (every texel on the same weight)
+template <int N>
+bool refitEndpoints(const uint8_t* texels, const float* weights, Vec<N>& first, Vec<N>& second) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    Vec<N> ax{}, bx{};
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < N; c++) {
+            ax[c] += a * texels[i * 4 + c];
+            bx[c] += b * texels[i * 4 + c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) return false;
+    for (int c = 0; c < N; c++) {
+        first[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+        second[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+    }
+    return true;
+}
+
+// ---- BC1 ----
+
+uint16_t packRgb565(const Vec<3>& color) {
+    int r = std::min(31, std::max(0, static_cast<int>(std::lround(color[0] * 31.0f / 255.0f))));
+    int g = std::min(63, std::max(0, static_cast<int>(std::lround(color[1] * 63.0f / 255.0f))));
+    int b = std::min(31, std::max(0, static_cast<int>(std::lround(color[2] * 31.0f / 255.0f))));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t packed, int* color) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// the four colors of the opaque mode, whatever the order of the endpoints
+void buildBc1Palette(uint16_t color0, uint16_t color1, int palette[4][3]) {
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+float selectBc1Indices(const uint8_t* texels, const int palette[4][3], uint8_t* indices) {
+    float error = 0.0f;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        float best = 1e30f;
+        for (uint8_t p = 0; p < 4; p++) {
+            float distance = squaredDistance<3>(texels + i * 4, palette[p]);
+            if (distance < best) {
+                best = distance;
+                indices[i] = p;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+void compressBc1(const uint8_t* texels, uint8_t* block) {
+    // weight of the second endpoint for each index of the opaque mode
+    static constexpr float INDEX_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+    Vec<3> low, high;
+    fitPrincipalAxis<3>(texels, low, high);
+    uint16_t color0 = packRgb565(high);
+    uint16_t color1 = packRgb565(low);
+    int palette[4][3];
+    uint8_t indices[BLOCK_TEXELS];
+    buildBc1Palette(color0, color1, palette);
+    float error = selectBc1Indices(texels, palette, indices);
+
+    // one least squares pass over the chosen indices, kept when it helps
+    float weights[BLOCK_TEXELS];
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) weights[i] = INDEX_WEIGHTS[indices[i]];
+    Vec<3> first, second;
+    if (refitEndpoints<3>(texels, weights, first, second)) {
+        uint16_t refit0 = packRgb565(first);
+        uint16_t refit1 = packRgb565(second);
+        int refitPalette[4][3];
+        uint8_t refitIndices[BLOCK_TEXELS];
+        buildBc1Palette(refit0, refit1, refitPalette);
+        float refitError = selectBc1Indices(texels, refitPalette, refitIndices);
+        if (refitError < error) {
+            color0 = refit0;
+            color1 = refit1;
+            std::memcpy(indices, refitIndices, sizeof(indices));
+        }
+    }
+
+    // color0 > color1 selects the opaque mode, equal endpoints only need index 0
+    if (color0 < color1) {
+        std::swap(color0, color1);
+        for (auto& index : indices) index ^= 1;
+    } else if (color0 == color1) {
+        std::memset(indices, 0, sizeof(indices));
+    }
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) bits |= uint32_t(indices[i]) << (2 * i);
+    block[0] = static_cast<uint8_t>(color0);
+    block[1] = static_cast<uint8_t>(color0 >> 8);
+    block[2] = static_cast<uint8_t>(color1);
+    block[3] = static_cast<uint8_t>(color1 >> 8);
+    for (int i = 0; i < 4; i++) block[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+void decompressBc1(const uint8_t* block, uint8_t* texels, bool forceOpaque) {
+    uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    int palette[4][4];
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int c = 0; c < 3; c++) {
+        if (color0 > color1 || forceOpaque) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    if (color0 <= color1 && !forceOpaque) palette[3][3] = 0;
+    uint32_t bits = uint32_t(block[4]) | (uint32_t(block[5]) << 8) | (uint32_t(block[6]) << 16) | (uint32_t(block[7]) << 24);
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        const int* color = palette[(bits >> (2 * i)) & 3];
+        for (int c = 0; c < 4; c++) texels[i * 4 + c] = static_cast<uint8_t>(color[c]);
+    }
+}
+
+// ---- BC3 alpha ----
+
+void buildAlphaPalette(int alpha0, int alpha1, int* palette) {
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void compressAlpha(const uint8_t* texels, uint8_t* block) {
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        alpha0 = std::max(alpha0, int(texels[i * 4 + 3]));
+        alpha1 = std::min(alpha1, int(texels[i * 4 + 3]));
+    }
+    int palette[8];
+    buildAlphaPalette(alpha0, alpha1, palette);
+    uint64_t bits = 0;
+    if (alpha0 != alpha1) {
+        for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+            int alpha = texels[i * 4 + 3];
+            uint64_t best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(palette[p] - alpha) < std::abs(palette[best] - alpha)) best = p;
+            }
+            bits |= best << (3 * i);
+        }
+    }
+    block[0] = static_cast<uint8_t>(alpha0);
+    block[1] = static_cast<uint8_t>(alpha1);
+    for (int i = 0; i < 6; i++) block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+void decompressAlpha(const uint8_t* block, uint8_t* texels) {
+    int palette[8];
+    buildAlphaPalette(block[0], block[1], palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++) bits |= uint64_t(block[2 + i]) << (8 * i);
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        texels[i * 4 + 3] = static_cast<uint8_t>(palette[(bits >> (3 * i)) & 7]);
+    }
+}
+
+// ---- BC7 mode 6 : one subset, RGBA endpoints of 7 bits plus a p-bit each, 4 bit indices ----
+
+struct Bc7Endpoint {
+    int quantized[4];
+    int pBit;
+    // what the decoder expands it to
+    int color[4];
+};
+
+Bc7Endpoint quantizeBc7Endpoint(const Vec<4>& value) {
+    Bc7Endpoint best{};
+    float bestError = 1e30f;
+    for (int pBit = 0; pBit < 2; pBit++) {
+        Bc7Endpoint endpoint{};
+        endpoint.pBit = pBit;
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            int q = static_cast<int>(std::lround((value[c] - pBit) / 2.0f));
+            endpoint.quantized[c] = std::min(127, std::max(0, q));
+            endpoint.color[c] = (endpoint.quantized[c] << 1) | pBit;
+            float d = endpoint.color[c] - value[c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = endpoint;
+        }
+    }
+    return best;
+}
+
+float selectBc7Indices(const uint8_t* texels, const Bc7Endpoint& first, const Bc7Endpoint& second, uint8_t* indices) {
+    int palette[16][4];
+    for (int w = 0; w < 16; w++) {
+        for (int c = 0; c < 4; c++) {
+            palette[w][c] = ((64 - BC7_WEIGHTS[w]) * first.color[c] + BC7_WEIGHTS[w] * second.color[c] + 32) >> 6;
+        }
+    }
+    float error = 0.0f;
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        float best = 1e30f;
+        for (uint8_t w = 0; w < 16; w++) {
+            float distance = squaredDistance<4>(texels + i * 4, palette[w]);
+            if (distance < best) {
+                best = distance;
+                indices[i] = w;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+class BitWriter {
+private:
+    uint8_t* data;
+    uint32_t position = 0;
+
+public:
+    explicit BitWriter(uint8_t* data) : data(data) {std::memset(data, 0, 16);}
+    void write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, position++) {
+            data[position / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (position % 8));
+        }
+    }
+};
+
+class BitReader {
+private:
+    const uint8_t* data;
+    uint32_t position = 0;
+
+public:
+    explicit BitReader(const uint8_t* data) : data(data) {}
+    uint32_t read(uint32_t bits) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < bits; i++, position++) {
+            value |= uint32_t((data[position / 8] >> (position % 8)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+void compressBc7(const uint8_t* texels, uint8_t* block) {
+    Vec<4> low, high;
+    fitPrincipalAxis<4>(texels, low, high);
+    Bc7Endpoint first = quantizeBc7Endpoint(low);
+    Bc7Endpoint second = quantizeBc7Endpoint(high);
+    uint8_t indices[BLOCK_TEXELS];
+    float error = selectBc7Indices(texels, first, second, indices);
+
+    // two least squares passes, each kept only when it lowers the error
+    for (int pass = 0; pass < 2; pass++) {
+        float weights[BLOCK_TEXELS];
+        for (uint32_t i = 0; i < BLOCK_TEXELS; i++) weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        Vec<4> refitLow, refitHigh;
+        if (!refitEndpoints<4>(texels, weights, refitLow, refitHigh)) break;
+        Bc7Endpoint refitFirst = quantizeBc7Endpoint(refitLow);
+        Bc7Endpoint refitSecond = quantizeBc7Endpoint(refitHigh);
+        uint8_t refitIndices[BLOCK_TEXELS];
+        float refitError = selectBc7Indices(texels, refitFirst, refitSecond, refitIndices);
+        if (refitError >= error) break;
+        error = refitError;
+        first = refitFirst;
+        second = refitSecond;
+        std::memcpy(indices, refitIndices, sizeof(indices));
+    }
+
+    // the index of the first texel is stored without its top bit
+    if (indices[0] >= 8) {
+        std::swap(first, second);
+        for (auto& index : indices) index = static_cast<uint8_t>(15 - index);
+    }
+
+    BitWriter writer(block);
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(first.quantized[c], 7);
+        writer.write(second.quantized[c], 7);
+    }
+    writer.write(first.pBit, 1);
+    writer.write(second.pBit, 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < BLOCK_TEXELS; i++) writer.write(indices[i], 4);
+}
+
+bool decompressBc7(const uint8_t* block, uint8_t* texels) {
+    BitReader reader(block);
+    if (reader.read(7) != (1u << 6)) return false;
+    int endpoints[2][4];
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] = static_cast<int>(reader.read(7)) << 1;
+        endpoints[1][c] = static_cast<int>(reader.read(7)) << 1;
+    }
+    int pBit0 = static_cast<int>(reader.read(1));
+    int pBit1 = static_cast<int>(reader.read(1));
+    for (int c = 0; c < 4; c++) {
+        endpoints[0][c] |= pBit0;
+        endpoints[1][c] |= pBit1;
+    }
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++) {
+        int weight = BC7_WEIGHTS[reader.read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++) {
+            texels[i * 4 + c] = static_cast<uint8_t>(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+// the 4x4 block at (blockX, blockY), texels past the edge repeat the last row / column
+void gatherBlock(const uint8_t* rgba, const MipLevel& level, uint32_t blockX, uint32_t blockY, uint8_t* texels) {
+    for (uint32_t y = 0; y < BLOCK_EXTENT; y++) {
+        uint32_t sourceY = std::min(blockY * BLOCK_EXTENT + y, level.height - 1);
+        for (uint32_t x = 0; x < BLOCK_EXTENT; x++) {
+            uint32_t sourceX = std::min(blockX * BLOCK_EXTENT + x, level.width - 1);
+            std::memcpy(texels + (y * BLOCK_EXTENT + x) * 4, rgba + (size_t(sourceY) * level.width + sourceX) * 4, 4);
+        }
+    }
+}
+
+} // namespace
+
+uint32_t getBlockSize(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+const char* getBlockFormatName(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1: return "BC1";
+        case BlockFormat::BC3: return "BC3";
+        case BlockFormat::BC7: return "BC7";
+    }
+    return "unknown";
+}
+
+BlockFormat chooseBlockFormat(TextureCompression compression, const uint8_t* rgba, size_t texelCount) {
+    if (compression == TextureCompression::QUALITY) return BlockFormat::BC7;
+    for (size_t i = 0; i < texelCount; i++) {
+        if (rgba[i * 4 + 3] != 255) return BlockFormat::BC3;
+    }
+    return BlockFormat::BC1;
+}
+
+void compressBlock(BlockFormat format, const uint8_t* texels, uint8_t* block) {
+    switch (format) {
+        case BlockFormat::BC1:
+            compressBc1(texels, block);
+            break;
+        case BlockFormat::BC3:
+            compressAlpha(texels, block);
+            compressBc1(texels, block + 8);
+            break;
+        case BlockFormat::BC7:
+            compressBc7(texels, block);
+            break;
+    }
+}
+
+bool decompressBlock(BlockFormat format, const uint8_t* block, uint8_t* texels) {
+    switch (format) {
+        case BlockFormat::BC1:
+            decompressBc1(block, texels, false);
+            return true;
+        case BlockFormat::BC3:
+            // the color half of BC3 is always in the opaque mode
+            decompressBc1(block + 8, texels, true);
+            decompressAlpha(block, texels);
+            return true;
+        case BlockFormat::BC7:
+            return decompressBc7(block, texels);
+    }
+    return false;
+}
+
+std::vector<uint8_t> compressMipChain(BlockFormat format,
+                                      const uint8_t* rgba,
+                                      const std::vector<MipLevel>& levels,
+                                      uint32_t threadCount) {
+    uint32_t blockSize = getBlockSize(format);
+    std::vector<MipLevel> blockLevels = computeMipChain(levels[0].width, levels[0].height, blockSize, BLOCK_EXTENT);
+    std::vector<uint8_t> blocks(getMipChainSize(blockLevels));
+    for (size_t i = 0; i < levels.size(); i++) {
+        const MipLevel& level = levels[i];
+        const uint8_t* source = rgba + level.offset;
+        uint8_t* destination = blocks.data() + blockLevels[i].offset;
+        uint32_t blocksWide = (level.width + BLOCK_EXTENT - 1) / BLOCK_EXTENT;
+        uint32_t blocksHigh = (level.height + BLOCK_EXTENT - 1) / BLOCK_EXTENT;
+        parallelFor(blocksHigh, threadCount, [&](size_t begin, size_t end, uint32_t) {
+            uint8_t texels[BLOCK_TEXELS * 4];
+            for (size_t blockY = begin; blockY < end; blockY++) {
+                for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+                    gatherBlock(source, level, blockX, static_cast<uint32_t>(blockY), texels);
+                    compressBlock(format, texels, destination + (blockY * blocksWide + blockX) * blockSize);
+                }
+            }
+        });
+    }
+    return blocks;
+}
+
+} // namespace vcr
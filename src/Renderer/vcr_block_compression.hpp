@@ -0,0 +1,53 @@
+#ifndef VCR_BLOCK_COMPRESSION_HPP
+#define VCR_BLOCK_COMPRESSION_HPP
+
+#include "vcr_mipmap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// texels per block side, the same for every format here
+constexpr uint32_t BLOCK_EXTENT = 4;
+
+// BC1 : opaque RGB, 8 bytes a block (8:1 against RGBA8)
+// BC3 : BC1 colors plus interpolated alpha, 16 bytes a block (4:1)
+// BC7 : RGBA, 16 bytes a block (4:1), much better colors than BC1 at a higher encoding cost
+enum class BlockFormat {
+    BC1,
+    BC3,
+    BC7,
+};
+
+// what the import does with textures once their mip chain is built
+enum class TextureCompression {
+    // RGBA8 as decoded
+    NONE,
+    // BC1, BC3 when a texel isn't opaque
+    FAST,
+    // BC7
+    QUALITY,
+};
+
+uint32_t getBlockSize(BlockFormat format);
+const char* getBlockFormatName(BlockFormat format);
+BlockFormat chooseBlockFormat(TextureCompression compression, const uint8_t* rgba, size_t texelCount);
+
+// texels is a 4x4 block of RGBA8, rows of 4 texels. colors are fitted in the space they are stored in,
+// sRGB textures are compressed as sRGB like every other encoder does
+void compressBlock(BlockFormat format, const uint8_t* texels, uint8_t* block);
+// BC7 only decodes mode 6, the only one compressBlock writes. false on anything else
+bool decompressBlock(BlockFormat format, const uint8_t* block, uint8_t* texels);
+
+// every level of an RGBA8 chain laid out by computeMipChain(width, height, 4), the result is laid out by
+// computeMipChain(width, height, getBlockSize(format), BLOCK_EXTENT). rows of blocks go over threadCount threads
+std::vector<uint8_t> compressMipChain(BlockFormat format,
+                                      const uint8_t* rgba,
+                                      const std::vector<MipLevel>& levels,
+                                      uint32_t threadCount);
+
+} // namespace vcr
+
+#endif // VCR_BLOCK_COMPRESSION_HPP
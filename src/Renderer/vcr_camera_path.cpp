@@ -0,0 +1,94 @@
+#include "vcr_camera_path.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace vcr {
+
+namespace {
+
+// keys of the orbit, one every 10 degrees
+constexpr uint32_t ORBIT_KEY_COUNT = 36;
+
+} // namespace
+
+CameraPath CameraPath::orbit(const glm::vec3& center, float radius, float duration) {
+    CameraPath path;
+    // the up of the default camera, Y points down on screen
+    const glm::vec3 up{0.0f, -1.0f, 0.0f};
+    for (uint32_t i = 0; i <= ORBIT_KEY_COUNT; i++) {
+        float t = static_cast<float>(i) / static_cast<float>(ORBIT_KEY_COUNT);
+        float angle = t * 2.0f * glm::pi<float>();
+        float distance = radius * (2.5f - 1.5f * std::cos(angle));
+        glm::vec3 offset{std::sin(angle) * distance, 0.0f, std::cos(angle) * distance};
+        path.addKey({t * duration, center + offset, -glm::normalize(offset), up});
+    }
+    return path;
+}
+
+bool CameraPath::load(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file) return false;
+    std::vector<CameraKey> loaded;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream stream(line);
+        CameraKey key;
+        stream >> key.time >> key.position.x >> key.position.y >> key.position.z
+               >> key.forward.x >> key.forward.y >> key.forward.z >> key.up.x >> key.up.y >> key.up.z;
+        if (!stream || (!loaded.empty() && key.time < loaded.back().time)) return false;
+        loaded.push_back(key);
+    }
+    if (loaded.empty()) return false;
+    keys = std::move(loaded);
+    return true;
+}
+
+bool CameraPath::save(const std::string& filePath) const {
+    std::ofstream file(filePath);
+    if (!file) return false;
+    file << "# time px py pz fx fy fz ux uy uz\n";
+    for (const auto& key : keys) {
+        file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " "
+             << key.forward.x << " " << key.forward.y << " " << key.forward.z << " "
+             << key.up.x << " " << key.up.y << " " << key.up.z << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+void CameraPath::addKey(float time, const Camera& camera) {
+    const glm::mat4& inverseView = camera.getInverseViewMatrix();
+    addKey({time,
+            glm::vec3(inverseView[3]),
+            glm::normalize(-glm::vec3(inverseView[2])),
+            glm::normalize(glm::vec3(inverseView[1]))});
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+    if (keys.empty()) return;
+    float duration = getDuration();
+    if (duration > 0.0f) time = std::fmod(time, duration);
+    // first key past time, the pose is between it and the one before
+    auto next = std::upper_bound(keys.begin(), keys.end(), time,
+                                 [](float t, const CameraKey& key) {return t < key.time;});
+    if (next == keys.begin()) next++;
+    if (next == keys.end()) {
+        const CameraKey& last = keys.back();
+        camera.setViewDirection(last.position, last.forward, last.up);
+        return;
+    }
+    const CameraKey& a = *(next - 1);
+    const CameraKey& b = *next;
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+    camera.setViewDirection(glm::mix(a.position, b.position, t),
+                            glm::normalize(glm::mix(a.forward, b.forward, t)),
+                            glm::normalize(glm::mix(a.up, b.up, t)));
+}
+
+} // namespace vcr
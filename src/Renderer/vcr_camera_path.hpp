@@ -0,0 +1,51 @@
+#ifndef VCR_CAMERA_PATH_HPP
+#define VCR_CAMERA_PATH_HPP
+
+#include "vcr_camera.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace vcr {
+
+struct CameraKey {
+    // seconds from the start of the path
+    float time;
+    glm::vec3 position;
+    glm::vec3 forward;
+    glm::vec3 up;
+};
+
+// Camera poses over time, linearly interpolated between keys. Replayed against a fixed time
+// step rather than the wall clock, so a run draws the same frames however fast it goes.
+// On disk one key per line, "time px py pz fx fy fz ux uy uz", lines starting with # are skipped
+class CameraPath {
+private:
+    // ordered by time
+    std::vector<CameraKey> keys;
+
+public:
+    // a full turn around center in duration seconds, the distance going from radius to
+    // 4 x radius and back so the LODs and the texture mips change along the way
+    static CameraPath orbit(const glm::vec3& center, float radius, float duration);
+
+    bool load(const std::string& filePath);
+    bool save(const std::string& filePath) const;
+
+    // keys have to come in time order
+    void addKey(const CameraKey& key) {keys.push_back(key);}
+    // the pose of the camera, as the keyboard controller reads it
+    void addKey(float time, const Camera& camera);
+    // past the last key the path starts over
+    void apply(float time, Camera& camera) const;
+
+    bool empty() const {return keys.empty();}
+    size_t getKeyCount() const {return keys.size();}
+    float getDuration() const {return keys.empty() ? 0.0f : keys.back().time;}
+};
+
+} // namespace vcr
+
+#endif // VCR_CAMERA_PATH_HPP
@@ -9,26 +9,42 @@
 #include <cstring>
 #include <limits>
 #include <algorithm>
+#include <cstdlib>
 
 namespace vcr {
 
 Device::Device(Window& window) : window(window) {}
 
 Device::~Device() {
+    uploadContext.destroy();
+    allocator.destroy();
     vkDestroyCommandPool(device, commandPool, nullptr);
     vkDestroyDevice(device, nullptr);
     if (enableValidationLayers) DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
 }
 
 void Device::init() {
+    if (preferredDevice.empty()) {
+        const char* device = std::getenv("VCR_DEVICE");
+        if (device) preferredDevice = device;
+    }
+    // offscreen rendering needs no WSI at all
+    if (!window.isHeadless()) requiredDeviceExtensions = deviceExtensions;
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
+    allocator.init(device, physicalDevice);
     createCommandPool();
+    uploadContext.init(device,
+                       allocator,
+                       graphicsQueue,
+                       queueFamilies.graphicsFamily.value(),
+                       transferQueue,
+                       queueFamilies.transferFamily.value());
     msaaSamples = getMaxUsableSampleCount();
     log();
 }
@@ -48,18 +64,24 @@ VkFormat Device::findSupportedFormat(const std::vector<VkFormat>& candidates,
     throw std::runtime_error("failed to find supported depth format!");
 }
 
+std::string Device::getDeviceName() const {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    return deviceProperties.deviceName;
+}
+
 void Device::createInstance() {
     if (enableValidationLayers && !checkValidationLayerSupport()) {
         throw std::runtime_error("validation layers not available!");
     }
-    // PS : change this for later API version
+    // 1.2 for VK_EXT_mesh_shader (SPIR-V 1.4, Features2), devices below it still run the vertex path
     VkApplicationInfo appInfo {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pApplicationName = "vulkan test",
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName = "Test Engine",
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0,
+        .apiVersion = VK_API_VERSION_1_2,
     };
 
     std::vector<const char *> requiredExtensions = getRequiredExtensions();
@@ -95,6 +117,7 @@ void Device::setupDebugMessenger() {
 }
 
 void Device::createSurface() {
+    if (window.isHeadless()) return;
     if (glfwCreateWindowSurface(instance, window.getWindow(), nullptr, &surface) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface!");
     }
@@ -111,13 +134,22 @@ void Device::pickPhysicalDevice() {
     if (physicalDevice == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to find a suitable GPU!");
     }
+    textureCompressionBCSupported = checkTextureCompressionBCSupport(physicalDevice);
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+    pipelineStatisticsQuerySupported = deviceFeatures.pipelineStatisticsQuery;
+    meshShaderSupported = checkMeshShaderSupport(physicalDevice);
+    // optional, not part of what removeUnsuitableDevices checks
+    if (meshShaderSupported) requiredDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
 }
 
 void Device::createLogicalDevice() {
     QueueFamilyIndices indices = Device::findQueueFamilies(physicalDevice, surface);
     float queuePriority = 1.0f;
 
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
+                                              indices.presentFamily.value(),
+                                              indices.transferFamily.value()};
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -132,16 +164,24 @@ void Device::createLogicalDevice() {
     // TODO : add features we need
     VkPhysicalDeviceFeatures deviceFeatures{
         .sampleRateShading = VK_TRUE,
-        .samplerAnisotropy = VK_TRUE
+        .samplerAnisotropy = VK_TRUE,
+        .textureCompressionBC = textureCompressionBCSupported ? VK_TRUE : VK_FALSE,
+        .pipelineStatisticsQuery = pipelineStatisticsQuerySupported ? VK_TRUE : VK_FALSE
     };
 
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (meshShaderSupported) createInfo.pNext = &meshShaderFeatures;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
         createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -154,6 +194,12 @@ void Device::createLogicalDevice() {
     }
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    queueFamilies = indices;
+    if (meshShaderSupported) {
+        drawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
+        if (!drawMeshTasks) throw std::runtime_error("failed to load vkCmdDrawMeshTasksEXT!");
+    }
 }
 
 void Device::createCommandPool() {
@@ -170,11 +216,14 @@ void Device::createCommandPool() {
 void Device::removeUnsuitableDevices(std::vector<VkPhysicalDevice> &devices) {
     for (size_t i = 0; i < devices.size(); i++) {
         QueueFamilyIndices indices = Device::findQueueFamilies(devices[i], surface);
-        SwapChainSupportDetails swapChainSupport = SwapChain::querySwapChainSupport(devices[i], surface);
         VkPhysicalDeviceFeatures deviceFeatures;
         vkGetPhysicalDeviceFeatures(devices[i], &deviceFeatures);
         // P.S : might move to device score to prefer stuff like mailbox presentation... etc
-        bool swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        bool swapChainAdequate = true;
+        if (!window.isHeadless()) {
+            SwapChainSupportDetails swapChainSupport = SwapChain::querySwapChainSupport(devices[i], surface);
+            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        }
         // if it doesn't support the required swap chain features
         if (!swapChainAdequate) {
             devices.erase(devices.begin() + i);
@@ -208,7 +257,7 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(requiredDeviceExtensions.begin(), requiredDeviceExtensions.end());
     for (const auto &extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
     }
@@ -225,15 +274,72 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice physicalDevice, Vk
 
     for (uint32_t i = 0; i < queueFamilyCount; i++) {
         // PS : could add preference to device that does drawing and presenting in the same queue
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+        // headless, nothing is presented and the graphics family stands in
+        if (surface == VK_NULL_HANDLE) presentSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        else vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
         if (presentSupport) indices.presentFamily = i;
         if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i;
         if (indices.isComplete()) break;
         presentSupport = false;
     }
+
+    // transfer only first, then anything without graphics
+    for (uint32_t i = 0; i < queueFamilyCount && !indices.transferFamily.has_value(); i++) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = i;
+        }
+    }
+    for (uint32_t i = 0; i < queueFamilyCount && !indices.transferFamily.has_value(); i++) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if ((flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.transferFamily = i;
+        }
+    }
+    if (!indices.transferFamily.has_value()) indices.transferFamily = indices.graphicsFamily;
     return indices;
 }
 
+// the feature alone says every BC format samples, the formats the texture import writes are checked anyway
+bool Device::checkTextureCompressionBCSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    if (!deviceFeatures.textureCompressionBC) return false;
+    const VkFormat formats[] = {VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK};
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (VkFormat format : formats) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+        if ((properties.optimalTilingFeatures & features) != features) return false;
+    }
+    return true;
+}
+
+// the spec minimums of the extension already fit MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES,
+// only the extension and its two features are checked
+bool Device::checkMeshShaderSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) return false;
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+    bool found = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const VkExtensionProperties &extension) {
+        return std::strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+    if (!found) return false;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
 VkPhysicalDevice Device::pickBestPhysicalDevice(const std::vector<VkPhysicalDevice> &devices) {
     uint32_t bestScore = 0;
     VkPhysicalDevice bestPhysicalDevice = VK_NULL_HANDLE;
@@ -245,6 +351,9 @@ VkPhysicalDevice Device::pickBestPhysicalDevice(const std::vector<VkPhysicalDevi
         }
     }
     // get the name of the best physical device
+    if (bestPhysicalDevice == VK_NULL_HANDLE && !preferredDevice.empty()) {
+        throw std::runtime_error("failed to find a suitable device matching \"" + preferredDevice + "\"!");
+    }
     if (bestPhysicalDevice == VK_NULL_HANDLE) throw std::runtime_error("failed to find a suitable GPU!");
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(bestPhysicalDevice, &deviceProperties);
@@ -254,8 +363,7 @@ VkPhysicalDevice Device::pickBestPhysicalDevice(const std::vector<VkPhysicalDevi
 uint32_t Device::getDeviceScore(VkPhysicalDevice device) {
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    if (!isPreferredDevice(deviceProperties)) return 0;
     uint32_t score = 0;
     // PS : device score params here
     if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) score += 1000;
@@ -265,11 +373,21 @@ uint32_t Device::getDeviceScore(VkPhysicalDevice device) {
 
     score += deviceProperties.limits.maxImageDimension2D / 1000;
 
-    if (!deviceFeatures.geometryShader) return 0;
-
     return score;
 }
 
+bool Device::isPreferredDevice(const VkPhysicalDeviceProperties& deviceProperties) const {
+    if (preferredDevice.empty()) return true;
+    // lavapipe and SwiftShader report themselves as CPU devices
+    if (preferredDevice == "cpu") return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    if (preferredDevice == "gpu") {
+        return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ||
+               deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+               deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU;
+    }
+    return std::strstr(deviceProperties.deviceName, preferredDevice.c_str()) != nullptr;
+}
+
 void Device::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
     createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -315,9 +433,9 @@ bool Device::checkValidationLayerSupport() {
 
 std::vector<const char *> Device::getRequiredExtensions() {
     std::vector<const char *> requiredExtensions;
-    // get GLFW required extensions
-    uint32_t glfwExtensionCount;
-    const char ** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    // get GLFW required extensions, the surface ones. none without a window
+    uint32_t glfwExtensionCount = 0;
+    const char ** glfwExtensions = window.isHeadless() ? nullptr : glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
     for (uint32_t i = 0; i < glfwExtensionCount; i++) {
         requiredExtensions.push_back(glfwExtensions[i]);
     }
@@ -360,6 +478,20 @@ void Device::logMSAAsamples() {
     }
 }
 
+void Device::logTextureCompressionSupport() {
+    std::cout << "BC texture compression : " << (textureCompressionBCSupported ? "supported" : "not supported") << "\n";
+}
+
+void Device::logMeshShaderSupport() {
+    std::cout << "mesh shaders : " << (meshShaderSupported ? "supported" : "not supported") << "\n";
+}
+
+void Device::logQueueFamilies() {
+    std::cout << "graphics queue family : " << queueFamilies.graphicsFamily.value()
+              << ", transfer queue family : " << queueFamilies.transferFamily.value()
+              << (queueFamilies.hasDedicatedTransfer() ? " (dedicated)" : " (shared with graphics)") << "\n";
+}
+
 void Device::logExtensionList() {
     uint32_t extensionCount;
     vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
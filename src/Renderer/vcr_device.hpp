@@ -2,9 +2,12 @@
 #define VCR_DEVICE_HPP
 
 #include "vcr_window.hpp"
+#include "vcr_memory_allocator.hpp"
+#include "vcr_upload_context.hpp"
 
 #include <iostream>
 #include <optional>
+#include <string>
 #include <stdexcept>
 #include <vector>
 
@@ -39,7 +42,10 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // a family without graphics (the DMA engine on discrete GPUs), the graphics family otherwise
+    std::optional<uint32_t> transferFamily;
     bool isComplete() const {return graphicsFamily.has_value() && presentFamily.has_value();}
+    bool hasDedicatedTransfer() const {return transferFamily != graphicsFamily;}
 };
 
 struct SwapChainSupportDetails {
@@ -60,28 +66,59 @@ private:
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-    VkSurfaceKHR surface;
+    VkQueue transferQueue;
+    QueueFamilyIndices queueFamilies;
+    // none when the window is headless
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPresentModeKHR presentMode;
     VkCommandPool commandPool;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    // textureCompressionBC, enabled on the device when there
+    bool textureCompressionBCSupported = false;
+    // pipelineStatisticsQuery, enabled on the device when there
+    bool pipelineStatisticsQuerySupported = false;
+    // VK_EXT_mesh_shader with task and mesh shaders, enabled on the device when there
+    bool meshShaderSupported = false;
+    PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = nullptr;
+    MemoryAllocator allocator;
+    UploadContext uploadContext;
+    // deviceExtensions, none when headless
+    std::vector<const char*> requiredDeviceExtensions;
+    // "cpu", "gpu" or part of a device name, VCR_DEVICE when not set. empty picks the best scoring one
+    std::string preferredDevice;
 
 public:
     Device(Window& window);
     ~Device();
 
     void init();
+    // before init
+    void setPreferredDevice(const std::string& device) {preferredDevice = device;}
+    bool isHeadless() const {return window.isHeadless();}
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
                                  VkImageTiling tiling,
                                  VkFormatFeatureFlags features);
 
     VkDevice getDevice() const {return device;}
     VkPhysicalDevice getPhysicalDevice() const {return physicalDevice;}
+    std::string getDeviceName() const;
     VkSurfaceKHR getSurface() const {return surface;}
     GLFWwindow* getWindow() const {return window.getWindow();}
     VkCommandPool getCommandPool() const {return commandPool;}
     VkQueue getGraphicsQueue() const {return graphicsQueue;}
     VkQueue getPresentQueue() const {return presentQueue;}
+    VkQueue getTransferQueue() const {return transferQueue;}
+    const QueueFamilyIndices& getQueueFamilies() const {return queueFamilies;}
     VkSampleCountFlagBits getMsaaSamples() const {return msaaSamples;}
+    bool isTextureCompressionBCSupported() const {return textureCompressionBCSupported;}
+    bool isPipelineStatisticsQuerySupported() const {return pipelineStatisticsQuerySupported;}
+    bool isMeshShaderSupported() const {return meshShaderSupported;}
+    // only when isMeshShaderSupported
+    void cmdDrawMeshTasks(VkCommandBuffer commandBuffer, uint32_t groupCountX) const {
+        drawMeshTasks(commandBuffer, groupCountX, 1, 1);
+    }
+    MemoryAllocator& getAllocator() {return allocator;}
+    UploadContext& getUploadContext() {return uploadContext;}
     
     static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice, 
                                                 VkSurfaceKHR surface);
@@ -95,8 +132,11 @@ private:
 
     void removeUnsuitableDevices(std::vector<VkPhysicalDevice>& devices);
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool checkTextureCompressionBCSupport(VkPhysicalDevice device);
+    bool checkMeshShaderSupport(VkPhysicalDevice device);
     VkPhysicalDevice pickBestPhysicalDevice(const std::vector<VkPhysicalDevice>& devices);
     uint32_t getDeviceScore(VkPhysicalDevice device);
+    bool isPreferredDevice(const VkPhysicalDeviceProperties& deviceProperties) const;
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     bool checkValidationLayerSupport();
     std::vector<const char*> getRequiredExtensions();
@@ -105,11 +145,17 @@ private:
     void log() {
         logChosenPhysicalDevice();
         logMSAAsamples();
+        logTextureCompressionSupport();
+        logMeshShaderSupport();
+        logQueueFamilies();
     }
     void logChosenPhysicalDevice();
     void logExtensionList();
     void logValidationLayers();
     void logMSAAsamples();
+    void logTextureCompressionSupport();
+    void logMeshShaderSupport();
+    void logQueueFamilies();
 };
 } // namespace vcr
 
@@ -0,0 +1,251 @@
+#include "vcr_gpu_profiler.hpp"
+
+#include "vcr_trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace vcr {
+
+namespace {
+
+// timestamps of a slot, a pair per scope opening
+constexpr uint32_t TIMESTAMPS_PER_SLOT = 2 * GPU_PROFILER_MAX_SCOPES;
+// results of a statistics query come in the order of the bits
+constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                           VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                           VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+constexpr uint32_t STATISTICS_PER_QUERY = 3;
+
+} // namespace
+
+GpuProfiler::GpuProfiler(Device& device, uint32_t slotCount) : device(device), slotCount(slotCount) {}
+
+GpuProfiler::~GpuProfiler() {
+    if (timestampPool != VK_NULL_HANDLE) vkDestroyQueryPool(device.getDevice(), timestampPool, nullptr);
+    if (statisticsPool != VK_NULL_HANDLE) vkDestroyQueryPool(device.getDevice(), statisticsPool, nullptr);
+}
+
+void GpuProfiler::init(bool pipelineStatistics) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies[device.getQueueFamilies().graphicsFamily.value()].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "GPU profiler : no timestamps on the graphics queue, disabled\n";
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(device.getPhysicalDevice(), &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = slotCount * TIMESTAMPS_PER_SLOT;
+    if (vkCreateQueryPool(device.getDevice(), &poolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool!");
+    }
+    if (pipelineStatistics && !device.isPipelineStatisticsQuerySupported()) {
+        std::cout << "GPU profiler : no pipeline statistics queries on this device\n";
+    } else if (pipelineStatistics) {
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = slotCount * GPU_PROFILER_MAX_SCOPES;
+        poolInfo.pipelineStatistics = STATISTICS_FLAGS;
+        if (vkCreateQueryPool(device.getDevice(), &poolInfo, nullptr, &statisticsPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline statistics query pool!");
+        }
+    }
+
+    scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+    slots.resize(slotCount);
+    for (auto& slot : slots) slot.openings.reserve(GPU_PROFILER_MAX_SCOPES);
+    timestamps.resize(TIMESTAMPS_PER_SLOT);
+    statistics.resize(STATISTICS_PER_QUERY * GPU_PROFILER_MAX_SCOPES);
+    scopeTimes.resize(GPU_PROFILER_MAX_SCOPES);
+}
+
+void GpuProfiler::calibrate() {
+    if (!isEnabled()) return;
+    UploadContext& uploadContext = device.getUploadContext();
+    VkCommandBuffer commandBuffer = uploadContext.begin().getGraphicsCommandBuffer();
+    // the first query of the first slot, no frame used it yet
+    vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 0);
+    uploadContext.wait(uploadContext.submit());
+    uint64_t now = getTraceTime();
+    uint64_t ticks = 0;
+    if (vkGetQueryPoolResults(device.getDevice(),
+                              timestampPool,
+                              0,
+                              1,
+                              sizeof(ticks),
+                              &ticks,
+                              sizeof(ticks),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to read the calibration timestamp!");
+    }
+    traceTicks = ticks;
+    traceTime = static_cast<double>(now);
+    calibrated = true;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+    if (!isEnabled()) return;
+    collect(slot);
+    FrameSlot& frameSlot = slots[slot];
+    if (frameSlot.pending) droppedFrames++;
+    frameSlot.pending = false;
+    frameSlot.openings.clear();
+    frameSlot.statisticsCount = 0;
+    currentSlot = slot;
+    activeStatistics = GPU_SCOPE_NONE;
+
+    vkCmdResetQueryPool(commandBuffer, timestampPool, slot * TIMESTAMPS_PER_SLOT, TIMESTAMPS_PER_SLOT);
+    if (isCollectingStatistics()) {
+        vkCmdResetQueryPool(commandBuffer, statisticsPool, slot * GPU_PROFILER_MAX_SCOPES, GPU_PROFILER_MAX_SCOPES);
+    }
+    frameOpening = beginScope(commandBuffer, "frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+    if (!isEnabled()) return;
+    endScope(commandBuffer, frameOpening);
+    frameOpening = GPU_SCOPE_NONE;
+    slots[currentSlot].pending = true;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool withStatistics) {
+    if (!isEnabled()) return GPU_SCOPE_NONE;
+    FrameSlot& frameSlot = slots[currentSlot];
+    if (frameSlot.openings.size() == GPU_PROFILER_MAX_SCOPES) return GPU_SCOPE_NONE;
+    uint32_t scope = findScope(name);
+    if (scope == GPU_SCOPE_NONE) return GPU_SCOPE_NONE;
+
+    uint32_t opening = static_cast<uint32_t>(frameSlot.openings.size());
+    uint32_t statisticsQuery = GPU_SCOPE_NONE;
+    if (withStatistics && isCollectingStatistics() && activeStatistics == GPU_SCOPE_NONE) {
+        statisticsQuery = frameSlot.statisticsCount++;
+        vkCmdBeginQuery(commandBuffer, statisticsPool, currentSlot * GPU_PROFILER_MAX_SCOPES + statisticsQuery, 0);
+        activeStatistics = opening;
+    }
+    frameSlot.openings.push_back({scope, statisticsQuery});
+    vkCmdWriteTimestamp(commandBuffer,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestampPool,
+                        currentSlot * TIMESTAMPS_PER_SLOT + 2 * opening);
+    return opening;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t opening) {
+    if (opening == GPU_SCOPE_NONE) return;
+    vkCmdWriteTimestamp(commandBuffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        timestampPool,
+                        currentSlot * TIMESTAMPS_PER_SLOT + 2 * opening + 1);
+    uint32_t statisticsQuery = slots[currentSlot].openings[opening].statisticsQuery;
+    if (statisticsQuery != GPU_SCOPE_NONE) {
+        vkCmdEndQuery(commandBuffer, statisticsPool, currentSlot * GPU_PROFILER_MAX_SCOPES + statisticsQuery);
+        activeStatistics = GPU_SCOPE_NONE;
+    }
+}
+
+bool GpuProfiler::collect(uint32_t slot) {
+    if (!isEnabled() || !slots[slot].pending) return false;
+    const FrameSlot& frameSlot = slots[slot];
+    // no wait flag, a slot whose results are not there yet is tried again next time
+    uint32_t timestampCount = 2 * static_cast<uint32_t>(frameSlot.openings.size());
+    if (vkGetQueryPoolResults(device.getDevice(),
+                              timestampPool,
+                              slot * TIMESTAMPS_PER_SLOT,
+                              timestampCount,
+                              timestampCount * sizeof(uint64_t),
+                              timestamps.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return false;
+    }
+    if (frameSlot.statisticsCount > 0 &&
+        vkGetQueryPoolResults(device.getDevice(),
+                              statisticsPool,
+                              slot * GPU_PROFILER_MAX_SCOPES,
+                              frameSlot.statisticsCount,
+                              frameSlot.statisticsCount * STATISTICS_PER_QUERY * sizeof(uint64_t),
+                              statistics.data(),
+                              STATISTICS_PER_QUERY * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return false;
+    }
+    slots[slot].pending = false;
+
+    for (size_t i = 0; i < scopes.size(); i++) {
+        scopeTimes[i] = -1.0;
+        scopes[i].stats.hasStatistics = false;
+        scopes[i].stats.statistics = {};
+    }
+    for (size_t i = 0; i < frameSlot.openings.size(); i++) {
+        const Opening& opening = frameSlot.openings[i];
+        uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & timestampMask;
+        double time = static_cast<double>(ticks) * timestampPeriod / 1e6;
+        scopeTimes[opening.scope] = std::max(scopeTimes[opening.scope], 0.0) + time;
+        if (opening.statisticsQuery == GPU_SCOPE_NONE) continue;
+        GpuScopeStats& stats = scopes[opening.scope].stats;
+        const uint64_t* results = statistics.data() + STATISTICS_PER_QUERY * opening.statisticsQuery;
+        stats.hasStatistics = true;
+        stats.statistics.vertexShaderInvocations += results[0];
+        stats.statistics.clippingPrimitives += results[1];
+        stats.statistics.fragmentShaderInvocations += results[2];
+    }
+    for (size_t i = 0; i < scopes.size(); i++) {
+        scopes[i].stats.time = scopeTimes[i];
+        if (scopeTimes[i] >= 0.0) addSample(scopes[i], scopeTimes[i]);
+    }
+    if (calibrated) recordTraceEvents(frameSlot);
+    return true;
+}
+
+void GpuProfiler::recordTraceEvents(const FrameSlot& frameSlot) {
+    // frames resolve in order and each one is less than a counter period after the last
+    traceTime += static_cast<double>((timestamps[0] - traceTicks) & timestampMask) * timestampPeriod;
+    traceTicks = timestamps[0];
+    if (!isTracingEnabled()) return;
+    for (size_t i = 0; i < frameSlot.openings.size(); i++) {
+        double start = static_cast<double>((timestamps[2 * i] - traceTicks) & timestampMask) * timestampPeriod;
+        double end = static_cast<double>((timestamps[2 * i + 1] - traceTicks) & timestampMask) * timestampPeriod;
+        recordGpuTraceEvent(scopes[frameSlot.openings[i].scope].stats.name,
+                            static_cast<uint64_t>(traceTime + start),
+                            static_cast<uint64_t>(traceTime + end));
+    }
+}
+
+uint32_t GpuProfiler::findScope(const char* name) {
+    for (size_t i = 0; i < scopes.size(); i++) {
+        if (scopes[i].stats.name == name || std::strcmp(scopes[i].stats.name, name) == 0) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    if (scopes.size() == GPU_PROFILER_MAX_SCOPES) return GPU_SCOPE_NONE;
+    // reserved in init, no allocation
+    scopes.emplace_back();
+    scopes.back().stats.name = name;
+    return static_cast<uint32_t>(scopes.size() - 1);
+}
+
+void GpuProfiler::addSample(Scope& scope, double time) {
+    if (scope.historyCount == GPU_PROFILER_AVERAGE_FRAMES) {
+        scope.historySum -= scope.history[scope.historyNext];
+    } else {
+        scope.historyCount++;
+    }
+    scope.history[scope.historyNext] = time;
+    scope.historySum += time;
+    scope.historyNext = (scope.historyNext + 1) % GPU_PROFILER_AVERAGE_FRAMES;
+    scope.stats.averageTime = scope.historySum / scope.historyCount;
+}
+
+} // namespace vcr
@@ -0,0 +1,150 @@
+#ifndef VCR_GPU_PROFILER_HPP
+#define VCR_GPU_PROFILER_HPP
+
+#include "vcr_device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// scopes opened in one frame, the frame itself included, and distinct scope names
+constexpr uint32_t GPU_PROFILER_MAX_SCOPES = 32;
+// frames a scope's average is taken over
+constexpr uint32_t GPU_PROFILER_AVERAGE_FRAMES = 60;
+// handle of a scope that could not be opened, ending it does nothing
+constexpr uint32_t GPU_SCOPE_NONE = ~0u;
+
+struct PipelineStatistics {
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+};
+
+// of the last frame resolved, a scope opened several times in a frame adds up
+struct GpuScopeStats {
+    const char* name = nullptr;
+    // milliseconds, negative when the scope didn't run in that frame
+    double time = -1.0;
+    // over the last GPU_PROFILER_AVERAGE_FRAMES frames the scope ran in
+    double averageTime = 0.0;
+    // only for scopes opened with statistics while the pipeline statistics are on
+    bool hasStatistics = false;
+    PipelineStatistics statistics;
+};
+
+// Timestamp queries around named scopes of a frame's command buffer. Every frame in flight has its
+// own range of queries, read back when its slot comes round again : the frame's fence has signaled
+// by then so the results are there and nothing waits on the GPU.
+// The frame is the first scope, "frame". Pipeline statistics queries can't nest, a statistics scope
+// opened inside another one only gets its time. every scope opened has to be ended in the same
+// command buffer, inside the render pass it began in if any. names have to outlive the profiler.
+// main thread only, nothing is allocated after init
+class GpuProfiler {
+private:
+    struct Scope {
+        GpuScopeStats stats;
+        std::array<double, GPU_PROFILER_AVERAGE_FRAMES> history{};
+        uint32_t historyCount = 0;
+        uint32_t historyNext = 0;
+        double historySum = 0.0;
+    };
+
+    struct Opening {
+        uint32_t scope;
+        // index into the slot's statistics queries, GPU_SCOPE_NONE without
+        uint32_t statisticsQuery;
+    };
+
+    struct FrameSlot {
+        std::vector<Opening> openings;
+        uint32_t statisticsCount = 0;
+        bool pending = false;
+    };
+
+    Device& device;
+    uint32_t slotCount;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    VkQueryPool statisticsPool = VK_NULL_HANDLE;
+    // nanoseconds per tick
+    double timestampPeriod = 0.0;
+    uint64_t timestampMask = 0;
+
+    std::vector<Scope> scopes;
+    std::vector<FrameSlot> slots;
+    uint32_t currentSlot = 0;
+    // the opening holding the statistics query in progress, GPU_SCOPE_NONE when none is
+    uint32_t activeStatistics = GPU_SCOPE_NONE;
+    uint32_t frameOpening = GPU_SCOPE_NONE;
+    // read back buffers
+    std::vector<uint64_t> timestamps;
+    std::vector<uint64_t> statistics;
+    std::vector<double> scopeTimes;
+    uint64_t droppedFrames = 0;
+    // a GPU tick matching a trace time, carried from frame to frame as the counter may wrap
+    bool calibrated = false;
+    uint64_t traceTicks = 0;
+    double traceTime = 0.0;
+
+    uint32_t findScope(const char* name);
+    void addSample(Scope& scope, double time);
+    void recordTraceEvents(const FrameSlot& frameSlot);
+
+public:
+    // one slot per frame in flight, results come back slotCount frames later
+    GpuProfiler(Device& device, uint32_t slotCount);
+    ~GpuProfiler();
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // after the device, stays disabled when the graphics queue has no timestamps.
+    // the statistics need the pipelineStatisticsQuery feature, without it only times are taken
+    void init(bool pipelineStatistics = false);
+    // matches the GPU clock with the trace clock, the resolved scopes then go to the trace while
+    // tracing is on. waits on a submission, the GPU ranges may end up that much early
+    void calibrate();
+
+    // first thing in the slot's command buffer, outside a render pass. resolves what the slot
+    // measured last time if collect didn't
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+    // last thing in the command buffer, outside a render pass
+    void endFrame(VkCommandBuffer commandBuffer);
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool withStatistics = false);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t opening);
+
+    // once the slot's fence signaled. false when it had nothing to resolve, otherwise the
+    // scopes hold its times
+    bool collect(uint32_t slot);
+
+    bool isEnabled() const {return timestampPool != VK_NULL_HANDLE;}
+    bool isCollectingStatistics() const {return statisticsPool != VK_NULL_HANDLE;}
+    // of the last frame resolved, in milliseconds
+    double getFrameTime() const {return scopes.empty() ? -1.0 : scopes[0].stats.time;}
+    size_t getScopeCount() const {return scopes.size();}
+    const GpuScopeStats& getScope(size_t index) const {return scopes[index].stats;}
+    // frames whose results were not there when their slot was reused
+    uint64_t getDroppedFrames() const {return droppedFrames;}
+};
+
+// a scope closed at the end of the C++ scope
+class GpuScope {
+private:
+    GpuProfiler& profiler;
+    VkCommandBuffer commandBuffer;
+    uint32_t opening;
+
+public:
+    GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name, bool withStatistics = false)
+        : profiler(profiler), commandBuffer(commandBuffer),
+          opening(profiler.beginScope(commandBuffer, name, withStatistics)) {}
+    ~GpuScope() {profiler.endScope(commandBuffer, opening);}
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+};
+
+} // namespace vcr
+
+#endif // VCR_GPU_PROFILER_HPP
@@ -0,0 +1,35 @@
+#include "vcr_index_buffer.hpp"
+
+#include <cstring>
+
+namespace vcr {
+
+VkIndexType chooseIndexType(uint32_t vertexCount) {
+    // 0xFFFF is left out, it is the primitive restart value if that ever gets enabled
+    return vertexCount <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+VkDeviceSize getIndexSize(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void writeIndices(const uint32_t* source, size_t count, VkIndexType indexType, void* destination) {
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t* narrowed = static_cast<uint16_t*>(destination);
+        for (size_t i = 0; i < count; i++) narrowed[i] = static_cast<uint16_t>(source[i]);
+    } else {
+        std::memcpy(destination, source, count * sizeof(uint32_t));
+    }
+}
+
+size_t writeMeshletIndices(const MeshletData& data,
+                           const std::vector<uint32_t>& visible,
+                           VkIndexType indexType,
+                           void* destination) {
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        return writeMeshletIndices(data, visible, static_cast<uint16_t*>(destination));
+    }
+    return writeMeshletIndices(data, visible, static_cast<uint32_t*>(destination));
+}
+
+} // namespace vcr
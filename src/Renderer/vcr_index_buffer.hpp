@@ -0,0 +1,27 @@
+#ifndef VCR_INDEX_BUFFER_HPP
+#define VCR_INDEX_BUFFER_HPP
+
+#include "vcr_meshlet.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// 16 bit whenever every vertex is reachable with it
+VkIndexType chooseIndexType(uint32_t vertexCount);
+VkDeviceSize getIndexSize(VkIndexType indexType);
+
+// indices are kept 32 bit on the CPU, these write them at the width of the index buffer
+void writeIndices(const uint32_t* source, size_t count, VkIndexType indexType, void* destination);
+size_t writeMeshletIndices(const MeshletData& data,
+                           const std::vector<uint32_t>& visible,
+                           VkIndexType indexType,
+                           void* destination);
+
+} // namespace vcr
+
+#endif // VCR_INDEX_BUFFER_HPP
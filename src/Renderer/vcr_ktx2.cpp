@@ -0,0 +1,293 @@
+#include "vcr_ktx2.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace vcr {
+
+namespace {
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header has to match the file layout");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index has to match the file layout");
+
+// VkFormat values
+constexpr uint32_t BC1_RGB_SRGB_VK_FORMAT = 132;
+constexpr uint32_t BC3_SRGB_VK_FORMAT = 138;
+constexpr uint32_t BC7_SRGB_VK_FORMAT = 146;
+
+// Khronos data format descriptor values
+constexpr uint8_t KHR_DF_MODEL_BC1A = 128;
+constexpr uint8_t KHR_DF_MODEL_BC3 = 130;
+constexpr uint8_t KHR_DF_MODEL_BC7 = 134;
+constexpr uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+constexpr uint8_t KHR_DF_CHANNEL_COLOR = 0;
+constexpr uint8_t KHR_DF_CHANNEL_BC3_ALPHA = 15;
+constexpr uint8_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool fromVkFormat(uint32_t vkFormat, BlockFormat& format) {
+    switch (vkFormat) {
+        case BC1_RGB_SRGB_VK_FORMAT: format = BlockFormat::BC1; return true;
+        case BC3_SRGB_VK_FORMAT: format = BlockFormat::BC3; return true;
+        case BC7_SRGB_VK_FORMAT: format = BlockFormat::BC7; return true;
+    }
+    return false;
+}
+
+void appendUint32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// basic descriptor block : 24 bytes plus 16 per sample
+std::vector<uint8_t> buildDataFormatDescriptor(BlockFormat format) {
+    struct Sample {
+        uint32_t bitOffset;
+        uint32_t bitLength;
+        uint8_t channel;
+    };
+    std::vector<Sample> samples;
+    uint8_t colorModel = KHR_DF_MODEL_BC1A;
+    switch (format) {
+        case BlockFormat::BC1:
+            samples.push_back({0, 64, KHR_DF_CHANNEL_COLOR});
+            break;
+        case BlockFormat::BC3:
+            colorModel = KHR_DF_MODEL_BC3;
+            // alpha is never sRGB encoded
+            samples.push_back({0, 64, static_cast<uint8_t>(KHR_DF_CHANNEL_BC3_ALPHA | KHR_DF_SAMPLE_DATATYPE_LINEAR)});
+            samples.push_back({64, 64, KHR_DF_CHANNEL_COLOR});
+            break;
+        case BlockFormat::BC7:
+            colorModel = KHR_DF_MODEL_BC7;
+            samples.push_back({0, 128, KHR_DF_CHANNEL_COLOR});
+            break;
+    }
+
+    uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<uint8_t> dfd;
+    appendUint32(dfd, 4 + blockSize);
+    // vendor 0 (Khronos), descriptor type 0 (basic)
+    appendUint32(dfd, 0);
+    // version 2
+    appendUint32(dfd, 2 | (blockSize << 16));
+    dfd.insert(dfd.end(), {colorModel, KHR_DF_PRIMARIES_BT709, KHR_DF_TRANSFER_SRGB, 0});
+    // block dimensions minus one
+    dfd.insert(dfd.end(), {BLOCK_EXTENT - 1, BLOCK_EXTENT - 1, 0, 0});
+    dfd.insert(dfd.end(), {static_cast<uint8_t>(getBlockSize(format)), 0, 0, 0, 0, 0, 0, 0});
+    for (const auto& sample : samples) {
+        appendUint32(dfd, sample.bitOffset | ((sample.bitLength - 1) << 16) | (uint32_t(sample.channel) << 24));
+        appendUint32(dfd, 0);
+        appendUint32(dfd, 0);
+        appendUint32(dfd, UINT32_MAX);
+    }
+    return dfd;
+}
+
+// entries sorted by key, every one padded to 4 bytes
+std::vector<uint8_t> buildKeyValueData(uint64_t sourceKey) {
+    char value[17];
+    std::snprintf(value, sizeof(value), "%016" PRIx64, sourceKey);
+    const std::pair<std::string, std::string> entries[] = {
+        {KTX2_SOURCE_KEY, value},
+        {"KTXwriter", "Cascade"},
+    };
+    std::vector<uint8_t> kvd;
+    for (const auto& entry : entries) {
+        uint32_t length = static_cast<uint32_t>(entry.first.size() + 1 + entry.second.size() + 1);
+        appendUint32(kvd, length);
+        kvd.insert(kvd.end(), entry.first.begin(), entry.first.end());
+        kvd.push_back(0);
+        kvd.insert(kvd.end(), entry.second.begin(), entry.second.end());
+        kvd.push_back(0);
+        kvd.resize(alignUp(kvd.size(), 4), 0);
+    }
+    return kvd;
+}
+
+// the value of key, empty when it isn't there
+std::string findKeyValue(const std::vector<uint8_t>& kvd, const char* key) {
+    size_t position = 0;
+    while (position + 4 <= kvd.size()) {
+        uint32_t length;
+        std::memcpy(&length, kvd.data() + position, sizeof(length));
+        position += 4;
+        if (length > kvd.size() - position) break;
+        const char* entry = reinterpret_cast<const char*>(kvd.data() + position);
+        size_t keyLength = strnlen(entry, length);
+        if (keyLength < length && std::strcmp(entry, key) == 0) {
+            std::string value(entry + keyLength + 1, length - keyLength - 1);
+            // string values carry their terminator
+            if (!value.empty() && value.back() == '\0') value.pop_back();
+            return value;
+        }
+        position = alignUp(position + length, 4);
+    }
+    return {};
+}
+
+} // namespace
+
+bool Ktx2Cache::open(const std::string& sourcePath) {
+    close();
+    uint64_t sourceKey = computeFileKey(sourcePath);
+    if (sourceKey == 0) return false;
+    if (!file.open(getCachePath(sourcePath))) return false;
+
+    Ktx2Header candidate{};
+    BlockFormat candidateFormat;
+    bool valid = file.size() >= sizeof(candidate) &&
+                 file.read(&candidate, 0, sizeof(candidate)) &&
+                 std::memcmp(candidate.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0 &&
+                 fromVkFormat(candidate.vkFormat, candidateFormat) &&
+                 candidate.pixelWidth > 0 && candidate.pixelHeight > 0 && candidate.pixelDepth == 0 &&
+                 candidate.layerCount == 0 && candidate.faceCount == 1 &&
+                 candidate.supercompressionScheme == 0 &&
+                 uint64_t(candidate.kvdByteOffset) + candidate.kvdByteLength <= file.size();
+    std::vector<MipLevel> expected;
+    if (valid) {
+        expected = computeMipChain(candidate.pixelWidth, candidate.pixelHeight, getBlockSize(candidateFormat), BLOCK_EXTENT);
+        valid = candidate.levelCount == expected.size();
+    }
+
+    std::vector<Ktx2LevelIndex> levelIndex(valid ? candidate.levelCount : 0);
+    valid = valid && file.read(levelIndex.data(), sizeof(Ktx2Header), levelIndex.size() * sizeof(Ktx2LevelIndex));
+    for (size_t i = 0; valid && i < levelIndex.size(); i++) {
+        valid = levelIndex[i].byteLength == expected[i].size &&
+                levelIndex[i].byteOffset + levelIndex[i].byteLength <= file.size();
+    }
+
+    if (valid) {
+        std::vector<uint8_t> kvd(candidate.kvdByteLength);
+        char expectedKey[17];
+        std::snprintf(expectedKey, sizeof(expectedKey), "%016" PRIx64, sourceKey);
+        valid = file.read(kvd.data(), candidate.kvdByteOffset, kvd.size()) &&
+                findKeyValue(kvd, KTX2_SOURCE_KEY) == expectedKey;
+    }
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    header = candidate;
+    format = candidateFormat;
+    levels = std::move(expected);
+    fileOffsets.clear();
+    for (const auto& level : levelIndex) fileOffsets.push_back(level.byteOffset);
+    return true;
+}
+
+void Ktx2Cache::close() {
+    header = {};
+    levels.clear();
+    fileOffsets.clear();
+    file.close();
+}
+
+bool Ktx2Cache::read(void* dst, uint64_t offset, size_t size) const {
+    if (levels.empty() || offset + size > getMipChainSize(levels)) return false;
+    // the file stores the levels in the opposite order, one read per level the range touches
+    uint64_t end = offset + size;
+    for (size_t i = 0; i < levels.size(); i++) {
+        uint64_t first = std::max(offset, levels[i].offset);
+        uint64_t last = std::min(end, levels[i].offset + levels[i].size);
+        if (first >= last) continue;
+        if (!file.read(static_cast<char*>(dst) + (first - offset),
+                       fileOffsets[i] + (first - levels[i].offset),
+                       static_cast<size_t>(last - first))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Ktx2Cache::write(const std::string& sourcePath,
+                      BlockFormat format,
+                      uint32_t width,
+                      uint32_t height,
+                      const void* blocks,
+                      const std::vector<MipLevel>& levels) {
+    uint64_t sourceKey = computeFileKey(sourcePath);
+    if (sourceKey == 0 || levels.empty()) return false;
+    std::vector<uint8_t> dfd = buildDataFormatDescriptor(format);
+    std::vector<uint8_t> kvd = buildKeyValueData(sourceKey);
+
+    Ktx2Header header{};
+    std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = getVkFormat(format);
+    // block compressed formats have no type
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    // smallest level first, each aligned to the block size (a multiple of 4 already)
+    std::vector<Ktx2LevelIndex> levelIndex(levels.size());
+    uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (size_t i = levels.size(); i-- > 0;) {
+        offset = alignUp(offset, getBlockSize(format));
+        levelIndex[i] = {offset, levels[i].size, levels[i].size};
+        offset += levels[i].size;
+    }
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string cachePath = getCachePath(sourcePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+        out.write(reinterpret_cast<const char*>(dfd.data()), dfd.size());
+        out.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+        uint64_t position = header.kvdByteOffset + header.kvdByteLength;
+        const char padding[16] = {};
+        for (size_t i = levels.size(); i-- > 0;) {
+            out.write(padding, levelIndex[i].byteOffset - position);
+            out.write(static_cast<const char*>(blocks) + levels[i].offset, levels[i].size);
+            position = levelIndex[i].byteOffset + levels[i].size;
+        }
+        if (!out.good()) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::string Ktx2Cache::getCachePath(const std::string& sourcePath) {
+    return sourcePath + ".ktx2";
+}
+
+uint32_t Ktx2Cache::getVkFormat(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1: return BC1_RGB_SRGB_VK_FORMAT;
+        case BlockFormat::BC3: return BC3_SRGB_VK_FORMAT;
+        case BlockFormat::BC7: return BC7_SRGB_VK_FORMAT;
+    }
+    return 0;
+}
+
+} // namespace vcr
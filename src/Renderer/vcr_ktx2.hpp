@@ -0,0 +1,89 @@
+#ifndef VCR_KTX2_HPP
+#define VCR_KTX2_HPP
+
+#include "file_utils.hpp"
+#include "vcr_block_compression.hpp"
+#include "vcr_mipmap.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vcr {
+
+// "«KTX 20»\r\n\x1A\n"
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+// key/value entry holding computeFileKey of the source, the cache is stale when it differs
+constexpr const char* KTX2_SOURCE_KEY = "CascadeSourceKey";
+
+// On disk layout (KTX 2.0) : identifier | header | level index | data format descriptor | key/value data | levels,
+// the smallest level first as the format wants. one layer, one face, no supercompression
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Block compressed copy of a texture next to its source, read like TextureCache : the levels
+// go from the file straight to the staging ring. Offsets are in the layout of
+// computeMipChain(width, height, block size, BLOCK_EXTENT), level 0 first, whatever the file order
+class Ktx2Cache {
+private:
+    FileReader file;
+    Ktx2Header header{};
+    BlockFormat format = BlockFormat::BC1;
+    std::vector<MipLevel> levels;
+    // file offset of each level
+    std::vector<uint64_t> fileOffsets;
+
+public:
+    Ktx2Cache() = default;
+    ~Ktx2Cache() = default;
+
+    // fails if there is no cache for sourcePath, if it is stale or if it isn't a chain this file writes
+    bool open(const std::string& sourcePath);
+    void close();
+
+    bool isOpen() const {return file.isOpen();}
+    uint32_t getWidth() const {return header.pixelWidth;}
+    uint32_t getHeight() const {return header.pixelHeight;}
+    // a VkFormat, the file stores it as is
+    uint32_t getVkFormat() const {return header.vkFormat;}
+    BlockFormat getFormat() const {return format;}
+    const std::vector<MipLevel>& getMipLevels() const {return levels;}
+    // size bytes of the chain starting at offset, the padding between levels is left as is
+    bool read(void* dst, uint64_t offset, size_t size) const;
+
+    // blocks holds the chain laid out as the reads above see it
+    static bool write(const std::string& sourcePath,
+                      BlockFormat format,
+                      uint32_t width,
+                      uint32_t height,
+                      const void* blocks,
+                      const std::vector<MipLevel>& levels);
+    static std::string getCachePath(const std::string& sourcePath);
+    static uint32_t getVkFormat(BlockFormat format);
+};
+
+} // namespace vcr
+
+#endif // VCR_KTX2_HPP
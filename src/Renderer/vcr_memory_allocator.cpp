@@ -0,0 +1,387 @@
+#include "vcr_memory_allocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vcr {
+
+namespace {
+
+// smallest range worth splitting off, also the granularity of every size
+constexpr uint64_t MIN_RANGE_SIZE = 16;
+// heaps this small (integrated GPUs, resizable BAR off) get proportionally smaller blocks
+constexpr VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+uint32_t findLowestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+uint32_t findHighestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(63 - __builtin_clzll(value));
+#endif
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// sizes below SL_COUNT live in first level 0, above that each power of 2 is split in SL_COUNT ranges
+void mapping(uint64_t size, uint32_t& fl, uint32_t& sl, uint32_t slBits) {
+    if (size < (1ull << slBits)) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+    uint32_t log = findHighestBit(size);
+    fl = log - slBits + 1;
+    sl = static_cast<uint32_t>(size >> (log - slBits)) ^ (1u << slBits);
+}
+
+} // namespace
+
+// === TlsfAllocator ===
+
+TlsfAllocator::TlsfAllocator(uint64_t size) : size(size) {
+    for (auto &firstLevel : freeLists) {
+        for (auto &head : firstLevel) head = INVALID_NODE;
+    }
+    uint32_t node = createNode(0, size);
+    nodes[node].free = true;
+    insertFree(node);
+}
+
+uint32_t TlsfAllocator::createNode(uint64_t offset, uint64_t nodeSize) {
+    Node node{offset, nodeSize, INVALID_NODE, INVALID_NODE, INVALID_NODE, INVALID_NODE, false};
+    if (!unusedNodes.empty()) {
+        uint32_t index = unusedNodes.back();
+        unusedNodes.pop_back();
+        nodes[index] = node;
+        return index;
+    }
+    nodes.push_back(node);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TlsfAllocator::releaseNode(uint32_t node) {
+    unusedNodes.push_back(node);
+}
+
+void TlsfAllocator::insertFree(uint32_t node) {
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl, SL_BITS);
+    uint32_t head = freeLists[fl][sl];
+    nodes[node].prevFree = INVALID_NODE;
+    nodes[node].nextFree = head;
+    if (head != INVALID_NODE) nodes[head].prevFree = node;
+    freeLists[fl][sl] = node;
+    flBitmap |= 1ull << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t node) {
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl, SL_BITS);
+    Node& n = nodes[node];
+    if (n.prevFree != INVALID_NODE) nodes[n.prevFree].nextFree = n.nextFree;
+    else freeLists[fl][sl] = n.nextFree;
+    if (n.nextFree != INVALID_NODE) nodes[n.nextFree].prevFree = n.prevFree;
+    if (freeLists[fl][sl] == INVALID_NODE) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (slBitmap[fl] == 0) flBitmap &= ~(1ull << fl);
+    }
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t requestSize, uint64_t alignment, uint64_t& offset) {
+    alignment = std::max<uint64_t>(alignment, 1);
+    uint64_t alignedSize = alignUp(std::max<uint64_t>(requestSize, 1), MIN_RANGE_SIZE);
+    // room to align inside whatever range is found
+    uint64_t searchSize = alignedSize + (alignment > MIN_RANGE_SIZE ? alignment - MIN_RANGE_SIZE : 0);
+    if (searchSize > size) return INVALID_NODE;
+
+    // round up to the next list so any range found there fits, good fit instead of best fit
+    if (searchSize >= (1ull << SL_BITS)) searchSize += (1ull << (findHighestBit(searchSize) - SL_BITS)) - 1;
+    uint32_t fl, sl;
+    mapping(searchSize, fl, sl, SL_BITS);
+    if (fl >= FL_COUNT) return INVALID_NODE;
+
+    uint32_t slMap = sl < SL_COUNT ? slBitmap[fl] & (~0u << sl) : 0;
+    if (slMap == 0) {
+        uint64_t flMap = fl + 1 < FL_COUNT ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0) return INVALID_NODE;
+        fl = findLowestBit(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = findLowestBit(slMap);
+    uint32_t node = freeLists[fl][sl];
+    removeFree(node);
+
+    // padding in front of the aligned offset stays part of the node
+    uint64_t start = nodes[node].offset;
+    offset = alignUp(start, alignment);
+    uint64_t used = offset - start + alignedSize;
+    if (nodes[node].size - used >= MIN_RANGE_SIZE) {
+        uint32_t rest = createNode(start + used, nodes[node].size - used);
+        // createNode may have grown the vector
+        Node& n = nodes[node];
+        nodes[rest].free = true;
+        nodes[rest].prevPhysical = node;
+        nodes[rest].nextPhysical = n.nextPhysical;
+        if (n.nextPhysical != INVALID_NODE) nodes[n.nextPhysical].prevPhysical = rest;
+        n.nextPhysical = rest;
+        n.size = used;
+        insertFree(rest);
+    }
+    nodes[node].free = false;
+    usedBytes += nodes[node].size;
+    allocationCount++;
+    return node;
+}
+
+void TlsfAllocator::free(uint32_t node) {
+    usedBytes -= nodes[node].size;
+    allocationCount--;
+    nodes[node].free = true;
+
+    uint32_t next = nodes[node].nextPhysical;
+    if (next != INVALID_NODE && nodes[next].free) {
+        removeFree(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[next].nextPhysical != INVALID_NODE) nodes[nodes[next].nextPhysical].prevPhysical = node;
+        releaseNode(next);
+    }
+    uint32_t prev = nodes[node].prevPhysical;
+    if (prev != INVALID_NODE && nodes[prev].free) {
+        removeFree(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[node].nextPhysical != INVALID_NODE) nodes[nodes[node].nextPhysical].prevPhysical = prev;
+        releaseNode(node);
+        node = prev;
+    }
+    insertFree(node);
+}
+
+uint64_t TlsfAllocator::getLargestFreeRange() const {
+    if (flBitmap == 0) return 0;
+    uint32_t fl = findHighestBit(flBitmap);
+    uint32_t sl = findHighestBit(slBitmap[fl]);
+    uint64_t largest = 0;
+    for (uint32_t node = freeLists[fl][sl]; node != INVALID_NODE; node = nodes[node].nextFree) {
+        largest = std::max(largest, nodes[node].size);
+    }
+    return largest;
+}
+
+// === MemoryAllocator ===
+
+MemoryAllocator::~MemoryAllocator() {
+    destroy();
+}
+
+void MemoryAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice) {
+    this->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+        blockSizes[i] = heapSize <= SMALL_HEAP_SIZE ? alignUp(heapSize / 8, 1024) : DEFAULT_BLOCK_SIZE;
+    }
+}
+
+void MemoryAllocator::destroy() {
+    if (device == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &typePools : pools) {
+        for (auto &pool : typePools) {
+            for (auto &block : pool.blocks) {
+                if (!block) continue;
+                if (!block->tlsf.isEmpty()) {
+                    std::cerr << "Memory allocator destroyed with " << block->tlsf.getAllocationCount() << " live allocations\n";
+                }
+                freeDeviceMemory(block->memory, block->mapped);
+            }
+            pool.blocks.clear();
+        }
+    }
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryType) const {
+    return (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate device memory!");
+    }
+    *mapped = nullptr;
+    // mapped once for its whole life, a memory object can't be mapped twice
+    if (isHostVisible(memoryType) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+        vkFreeMemory(device, memory, nullptr);
+        throw std::runtime_error("Failed to map device memory!");
+    }
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, void* mapped) {
+    if (mapped) vkUnmapMemory(device, memory);
+    vkFreeMemory(device, memory, nullptr);
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements,
+                                     VkMemoryPropertyFlags properties,
+                                     AllocationKind kind,
+                                     bool dedicated) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Allocation allocation{};
+    allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    allocation.kind = kind;
+    allocation.size = requirements.size;
+    VkDeviceSize blockSize = blockSizes[allocation.memoryType];
+
+    if (dedicated || requirements.size > blockSize / 2) {
+        allocation.memory = allocateDeviceMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+        allocation.block = DEDICATED_BLOCK;
+        dedicatedBytes[allocation.memoryType] += requirements.size;
+        dedicatedCounts[allocation.memoryType]++;
+        return allocation;
+    }
+
+    Pool& pool = pools[allocation.memoryType][static_cast<uint32_t>(kind)];
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        Block* block = pool.blocks[i].get();
+        if (!block) continue;
+        uint32_t node = block->tlsf.allocate(requirements.size, requirements.alignment, allocation.offset);
+        if (node == TlsfAllocator::INVALID_NODE) continue;
+        allocation.memory = block->memory;
+        allocation.block = i;
+        allocation.node = node;
+        allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+        return allocation;
+    }
+
+    auto block = std::make_unique<Block>(blockSize);
+    block->memory = allocateDeviceMemory(blockSize, allocation.memoryType, &block->mapped);
+    uint32_t node = block->tlsf.allocate(requirements.size, requirements.alignment, allocation.offset);
+    // only an alignment past what the empty block can pad for gets here
+    if (node == TlsfAllocator::INVALID_NODE) {
+        freeDeviceMemory(block->memory, block->mapped);
+        throw std::runtime_error("Failed to sub-allocate from a new memory block!");
+    }
+    allocation.memory = block->memory;
+    allocation.node = node;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+
+    auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+    if (slot == pool.blocks.end()) slot = pool.blocks.insert(pool.blocks.end(), nullptr);
+    allocation.block = static_cast<uint32_t>(slot - pool.blocks.begin());
+    *slot = std::move(block);
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (allocation.block == DEDICATED_BLOCK) {
+        freeDeviceMemory(allocation.memory, allocation.mapped);
+        dedicatedBytes[allocation.memoryType] -= allocation.size;
+        dedicatedCounts[allocation.memoryType]--;
+        allocation = Allocation{};
+        return;
+    }
+
+    Pool& pool = pools[allocation.memoryType][static_cast<uint32_t>(allocation.kind)];
+    std::unique_ptr<Block>& block = pool.blocks[allocation.block];
+    block->tlsf.free(allocation.node);
+    allocation = Allocation{};
+
+    // one empty block per pool is kept around so a free / allocate pair doesn't hit the driver
+    if (!block->tlsf.isEmpty()) return;
+    for (const auto &other : pool.blocks) {
+        if (other && other != block && other->tlsf.isEmpty()) {
+            freeDeviceMemory(block->memory, block->mapped);
+            block.reset();
+            return;
+        }
+    }
+}
+
+MemoryStats MemoryAllocator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats;
+    stats.heaps.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        stats.heaps[i].heapSize = memoryProperties.memoryHeaps[i].size;
+    }
+
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFree = 0;
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+        MemoryHeapStats& heap = stats.heaps[memoryProperties.memoryTypes[type].heapIndex];
+        heap.allocatedBytes += dedicatedBytes[type];
+        heap.usedBytes += dedicatedBytes[type];
+        heap.dedicatedCount += dedicatedCounts[type];
+        heap.allocationCount += dedicatedCounts[type];
+        stats.deviceMemoryCount += dedicatedCounts[type];
+        for (const auto &pool : pools[type]) {
+            for (const auto &block : pool.blocks) {
+                if (!block) continue;
+                heap.allocatedBytes += block->tlsf.getSize();
+                heap.usedBytes += block->tlsf.getUsedBytes();
+                heap.blockCount++;
+                heap.allocationCount += block->tlsf.getAllocationCount();
+                stats.deviceMemoryCount++;
+                freeBytes += block->tlsf.getSize() - block->tlsf.getUsedBytes();
+                largestFree = std::max(largestFree, block->tlsf.getLargestFreeRange());
+            }
+        }
+    }
+    stats.fragmentation = freeBytes > 0 ? 1.0f - static_cast<float>(largestFree) / static_cast<float>(freeBytes) : 0.0f;
+    return stats;
+}
+
+void MemoryAllocator::logStats() const {
+    MemoryStats stats = getStats();
+    std::cout << "GPU memory : " << stats.deviceMemoryCount << " device allocations, fragmentation "
+              << stats.fragmentation * 100.0f << "%\n";
+    for (size_t i = 0; i < stats.heaps.size(); i++) {
+        const MemoryHeapStats& heap = stats.heaps[i];
+        if (heap.allocatedBytes == 0) continue;
+        std::cout << "\theap " << i << " : " << heap.usedBytes / 1024 << " KB used of " << heap.allocatedBytes / 1024
+                  << " KB allocated (heap " << heap.heapSize / (1024 * 1024) << " MB), " << heap.blockCount << " blocks, "
+                  << heap.dedicatedCount << " dedicated, " << heap.allocationCount << " allocations\n";
+    }
+}
+
+} // namespace vcr
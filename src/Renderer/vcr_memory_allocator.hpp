@@ -0,0 +1,155 @@
+#ifndef VCR_MEMORY_ALLOCATOR_HPP
+#define VCR_MEMORY_ALLOCATOR_HPP
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vcr {
+
+// Two level segregated fit allocator over [0, size), it only hands out offsets.
+// O(1) allocate and free, neighbouring free ranges are merged on free
+class TlsfAllocator {
+public:
+    static constexpr uint32_t INVALID_NODE = ~0u;
+
+    explicit TlsfAllocator(uint64_t size);
+
+    // returns INVALID_NODE when no free range fits, offset is aligned to alignment (a power of 2)
+    uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+    void free(uint32_t node);
+
+    uint64_t getSize() const {return size;}
+    uint64_t getUsedBytes() const {return usedBytes;}
+    uint32_t getAllocationCount() const {return allocationCount;}
+    bool isEmpty() const {return allocationCount == 0;}
+    uint64_t getLargestFreeRange() const;
+
+private:
+    static constexpr uint32_t SL_BITS = 5;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64;
+
+    struct Node {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    uint64_t size;
+    uint64_t usedBytes = 0;
+    uint32_t allocationCount = 0;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint64_t flBitmap = 0;
+    uint32_t slBitmap[FL_COUNT] = {};
+    uint32_t freeLists[FL_COUNT][SL_COUNT];
+
+    uint32_t createNode(uint64_t offset, uint64_t size);
+    void releaseNode(uint32_t node);
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+};
+
+// buffers and linearly tiled images never share a block with optimally tiled images,
+// which takes bufferImageGranularity out of the picture
+enum class AllocationKind : uint32_t {
+    LINEAR,
+    OPTIMAL,
+};
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // persistently mapped when the memory is host visible, nullptr otherwise
+    void* mapped = nullptr;
+    uint32_t memoryType = 0;
+    AllocationKind kind = AllocationKind::LINEAR;
+    // DEDICATED_BLOCK when the allocation owns its VkDeviceMemory
+    uint32_t block = 0;
+    uint32_t node = TlsfAllocator::INVALID_NODE;
+};
+
+struct MemoryHeapStats {
+    VkDeviceSize heapSize = 0;
+    // bytes of VkDeviceMemory allocated from the heap, dedicated included
+    VkDeviceSize allocatedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+};
+
+struct MemoryStats {
+    std::vector<MemoryHeapStats> heaps;
+    // live vkAllocateMemory count, what maxMemoryAllocationCount limits
+    uint32_t deviceMemoryCount = 0;
+    // 1 - largest free range / free bytes over every block, 0 when the free space is contiguous
+    float fragmentation = 0.0f;
+};
+
+// Device memory sub allocator : one pool of large blocks per memory type and kind, TLSF inside each block.
+// Owned by Device, every buffer and image goes through it (see vk_utils createBuffer / createImage)
+class MemoryAllocator {
+public:
+    static constexpr uint32_t DEDICATED_BLOCK = ~0u;
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    MemoryAllocator() = default;
+    ~MemoryAllocator();
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice);
+    // every allocation must have been freed
+    void destroy();
+
+    // dedicated forces an own VkDeviceMemory, big resources get one anyway
+    Allocation allocate(const VkMemoryRequirements& requirements,
+                        VkMemoryPropertyFlags properties,
+                        AllocationKind kind,
+                        bool dedicated = false);
+    void free(Allocation& allocation);
+
+    MemoryStats getStats() const;
+    void logStats() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        TlsfAllocator tlsf;
+
+        explicit Block(VkDeviceSize size) : tlsf(size) {}
+    };
+
+    struct Pool {
+        // a null entry is a released block, its index is reused so allocations keep theirs
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize blockSizes[VK_MAX_MEMORY_TYPES] = {};
+    Pool pools[VK_MAX_MEMORY_TYPES][2];
+    VkDeviceSize dedicatedBytes[VK_MAX_MEMORY_TYPES] = {};
+    uint32_t dedicatedCounts[VK_MAX_MEMORY_TYPES] = {};
+    mutable std::mutex mutex;
+
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+    void freeDeviceMemory(VkDeviceMemory memory, void* mapped);
+    bool isHostVisible(uint32_t memoryType) const;
+};
+
+} // namespace vcr
+
+#endif // VCR_MEMORY_ALLOCATOR_HPP
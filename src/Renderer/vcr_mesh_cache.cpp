@@ -0,0 +1,146 @@
+#include "vcr_mesh_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace vcr {
+
+namespace {
+
+constexpr uint64_t CACHE_ALIGNMENT = 16;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// count elements of size bytes at offset lie past the header and inside the file, without the sum wrapping
+bool isSectionInFile(uint64_t offset, uint32_t count, uint64_t size, uint64_t fileSize) {
+    return offset >= sizeof(MeshCacheHeader) && offset <= fileSize && count * size <= fileSize - offset;
+}
+
+} // namespace
+
+bool MeshCache::open(const std::string& sourcePath) {
+    close();
+    uint64_t sourceKey = computeSourceKey(sourcePath);
+    if (sourceKey == 0) return false;
+    if (!file.open(getCachePath(sourcePath))) return false;
+
+    const MeshCacheHeader* candidate = reinterpret_cast<const MeshCacheHeader*>(file.data());
+    uint64_t fileSize = file.size();
+    bool valid = fileSize >= sizeof(MeshCacheHeader) &&
+                 candidate->magic == MESH_CACHE_MAGIC &&
+                 candidate->version == MESH_CACHE_VERSION &&
+                 candidate->sourceKey == sourceKey &&
+                 candidate->vertexStride == sizeof(Vertex) &&
+                 candidate->vertexOffset % CACHE_ALIGNMENT == 0 &&
+                 candidate->indexOffset % CACHE_ALIGNMENT == 0 &&
+                 isSectionInFile(candidate->vertexOffset, candidate->vertexCount, sizeof(Vertex), fileSize) &&
+                 isSectionInFile(candidate->indexOffset, candidate->indexCount, sizeof(uint32_t), fileSize);
+    valid = valid && candidate->lodCount >= 1 && candidate->lodCount <= MAX_MESH_LODS;
+    for (uint32_t i = 0; valid && i < candidate->lodCount; i++) {
+        const MeshLod& lod = candidate->lods[i];
+        valid = uint64_t(lod.indexOffset) + lod.indexCount <= candidate->indexCount;
+    }
+    if (valid) {
+        // a corrupt index would have the draws read past the vertex buffer, one pass over the mapped indices
+        const uint32_t* indices = reinterpret_cast<const uint32_t*>(file.data() + candidate->indexOffset);
+        uint32_t vertexCount = candidate->vertexCount;
+        valid = std::all_of(indices, indices + candidate->indexCount,
+                            [vertexCount](uint32_t index) { return index < vertexCount; });
+    }
+    if (!valid) {
+        file.close();
+        return false;
+    }
+    header = candidate;
+    return true;
+}
+
+void MeshCache::close() {
+    header = nullptr;
+    file.close();
+}
+
+const Vertex* MeshCache::getVertices() const {
+    return reinterpret_cast<const Vertex*>(file.data() + header->vertexOffset);
+}
+
+const uint32_t* MeshCache::getIndices() const {
+    return reinterpret_cast<const uint32_t*>(file.data() + header->indexOffset);
+}
+
+MeshBounds MeshCache::getBounds() const {
+    MeshBounds bounds;
+    bounds.min = {header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]};
+    bounds.max = {header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]};
+    return bounds;
+}
+
+bool MeshCache::write(const std::string& sourcePath,
+                      const Vertex* vertices,
+                      uint32_t vertexCount,
+                      const uint32_t* indices,
+                      uint32_t indexCount,
+                      const MeshLod* lods,
+                      uint32_t lodCount,
+                      const MeshBounds& bounds) {
+    if (lodCount == 0 || lodCount > MAX_MESH_LODS) return false;
+    MeshCacheHeader header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceKey = computeSourceKey(sourcePath);
+    header.vertexStride = sizeof(Vertex);
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.lodCount = lodCount;
+    for (uint32_t i = 0; i < lodCount; i++) header.lods[i] = lods[i];
+    header.vertexOffset = alignUp(sizeof(MeshCacheHeader), CACHE_ALIGNMENT);
+    header.indexOffset = alignUp(header.vertexOffset + uint64_t(vertexCount) * sizeof(Vertex), CACHE_ALIGNMENT);
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+    if (header.sourceKey == 0) return false;
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string cachePath = getCachePath(sourcePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        const char padding[CACHE_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding, header.vertexOffset - sizeof(header));
+        out.write(reinterpret_cast<const char*>(vertices), uint64_t(vertexCount) * sizeof(Vertex));
+        out.write(padding, header.indexOffset - (header.vertexOffset + uint64_t(vertexCount) * sizeof(Vertex)));
+        out.write(reinterpret_cast<const char*>(indices), uint64_t(indexCount) * sizeof(uint32_t));
+        if (!out.good()) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::string MeshCache::getCachePath(const std::string& sourcePath) {
+    return sourcePath + ".vcrmesh";
+}
+
+uint64_t MeshCache::computeSourceKey(const std::string& sourcePath) {
+    return computeFileKey(sourcePath);
+}
+
+} // namespace vcr
@@ -0,0 +1,83 @@
+#ifndef VCR_MESH_CACHE_HPP
+#define VCR_MESH_CACHE_HPP
+
+#include "vcr_vertex.hpp"
+#include "vcr_mesh_simplifier.hpp"
+
+#include "file_utils.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace vcr {
+
+// "VCRM" in little endian
+constexpr uint32_t MESH_CACHE_MAGIC = 0x4D524356;
+// bump this whenever the layout of the cache, of Vertex, or the import processing changes
+// 2 : vertex cache / overdraw / vertex fetch optimisation
+// 3 : LOD chain appended to the indices
+constexpr uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshBounds {
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+};
+
+// On disk layout : header | Vertex[vertexCount] | uint32_t[indexCount]
+// indexCount covers every LOD, the header lists their ranges
+// the arrays are 16 byte aligned so they can be used in place from the mapped file
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceKey;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+    MeshLod lods[MAX_MESH_LODS];
+};
+
+class MeshCache {
+private:
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+
+public:
+    MeshCache() = default;
+    ~MeshCache() = default;
+
+    // maps the cache of sourcePath, fails if there is none or if it is stale
+    bool open(const std::string& sourcePath);
+    void close();
+
+    bool isOpen() const {return header != nullptr;}
+    const Vertex* getVertices() const;
+    const uint32_t* getIndices() const;
+    uint32_t getVertexCount() const {return header->vertexCount;}
+    uint32_t getIndexCount() const {return header->indexCount;}
+    uint32_t getLodCount() const {return header->lodCount;}
+    const MeshLod* getLods() const {return header->lods;}
+    MeshBounds getBounds() const;
+
+    static bool write(const std::string& sourcePath,
+                      const Vertex* vertices,
+                      uint32_t vertexCount,
+                      const uint32_t* indices,
+                      uint32_t indexCount,
+                      const MeshLod* lods,
+                      uint32_t lodCount,
+                      const MeshBounds& bounds);
+    static std::string getCachePath(const std::string& sourcePath);
+    // hash of the source path, size and modification time, 0 if the source can't be read
+    static uint64_t computeSourceKey(const std::string& sourcePath);
+};
+
+} // namespace vcr
+
+#endif // VCR_MESH_CACHE_HPP
@@ -0,0 +1,337 @@
+#include "vcr_mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vcr {
+
+namespace {
+
+// Forsyth's constants, see "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth, 2006)
+constexpr int FORSYTH_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+constexpr uint32_t MAX_VALENCE_SCORE = 64;
+
+// smallest cluster the overdraw pass will cut, below that sorting costs more cache misses than it saves
+constexpr size_t MIN_CLUSTER_TRIANGLES = 16;
+// how much worse than the imported order the ACMR may get for the overdraw order to be kept
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct ScoreTables {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[MAX_VALENCE_SCORE + 1];
+
+    ScoreTables() {
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            if (i < 3) {
+                // the triangle just drawn, its vertices get a fixed score so it isn't picked again right away
+                cache[i] = LAST_TRIANGLE_SCORE;
+            } else {
+                float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                cache[i] = std::pow(1.0f - (i - 3) * scale, CACHE_DECAY_POWER);
+            }
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i = 1; i <= MAX_VALENCE_SCORE; i++) {
+            valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+        }
+    }
+};
+
+const ScoreTables& getScoreTables() {
+    static const ScoreTables tables;
+    return tables;
+}
+
+float vertexScore(int cachePosition, uint32_t liveTriangles) {
+    // no triangle left to draw with this vertex
+    if (liveTriangles == 0) return -1.0f;
+    const ScoreTables& tables = getScoreTables();
+    float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+    return score + tables.valence[std::min(liveTriangles, MAX_VALENCE_SCORE)];
+}
+
+void checkIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    if (indexCount % 3 != 0) throw std::runtime_error("Failed to optimize mesh: index count is not a multiple of 3");
+    for (size_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) throw std::runtime_error("Failed to optimize mesh: index out of range");
+    }
+}
+
+// FIFO cache simulation, a vertex is in the cache when fewer than cacheSize misses happened since it was loaded
+class FifoCache {
+private:
+    std::vector<uint32_t> timestamps;
+    uint32_t time;
+    uint32_t cacheSize;
+
+public:
+    FifoCache(size_t vertexCount, uint32_t cacheSize)
+        : timestamps(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+
+    // true when the vertex had to be transformed
+    bool access(uint32_t vertex) {
+        if (time - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = time++;
+            return true;
+        }
+        return false;
+    }
+
+    void reset() {time += cacheSize + 1;}
+};
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats{};
+    if (indexCount == 0 || vertexCount == 0) return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t i = 0; i < indexCount; i++) {
+        if (cache.access(indices[i])) stats.transformedVertices++;
+    }
+    stats.acmr = static_cast<float>(stats.transformedVertices) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(stats.transformedVertices) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    checkIndices(indices, indexCount, vertexCount);
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    std::vector<uint32_t> input(indices, indices + indexCount);
+
+    // vertex -> triangles, the live triangles of a vertex are the first liveTriangles[v] entries
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : input) liveTriangles[index]++;
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++) adjacency[fill[input[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[input[3 * t + 0]] + vertexScores[input[3 * t + 1]] + vertexScores[input[3 * t + 2]];
+        if (triangleScores[t] > triangleScores[bestTriangle]) bestTriangle = t;
+    }
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    size_t cacheCount = 0;
+    size_t inputCursor = 0;
+    long long current = static_cast<long long>(bestTriangle);
+
+    for (size_t output = 0; output < triangleCount; output++) {
+        if (current < 0) {
+            // nothing left around the cache, restart from the next triangle in input order
+            while (emitted[inputCursor]) inputCursor++;
+            current = static_cast<long long>(inputCursor);
+        }
+        size_t triangle = static_cast<size_t>(current);
+        const uint32_t* corners = &input[3 * triangle];
+        destination[3 * output + 0] = corners[0];
+        destination[3 * output + 1] = corners[1];
+        destination[3 * output + 2] = corners[2];
+        emitted[triangle] = true;
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t vertex = corners[k];
+            uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t& liveCount = liveTriangles[vertex];
+            for (uint32_t i = 0; i < liveCount; i++) {
+                if (live[i] == triangle) {
+                    std::swap(live[i], live[liveCount - 1]);
+                    liveCount--;
+                    break;
+                }
+            }
+        }
+
+        // LRU update : the triangle goes to the front, the rest keeps its order
+        size_t newCount = 0;
+        for (int k = 0; k < 3; k++) {
+            if (std::find(newCache, newCache + newCount, corners[k]) == newCache + newCount) newCache[newCount++] = corners[k];
+        }
+        size_t triangleVertices = newCount;
+        for (size_t i = 0; i < cacheCount; i++) {
+            if (std::find(newCache, newCache + triangleVertices, cache[i]) == newCache + triangleVertices) {
+                newCache[newCount++] = cache[i];
+            }
+        }
+
+        // rescore everything that moved or fell out, then look for the best triangle around the cache
+        for (size_t i = 0; i < newCount; i++) {
+            uint32_t vertex = newCache[i];
+            int position = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+            cachePositions[vertex] = position;
+            float score = vertexScore(position, liveTriangles[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+            const uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+            for (uint32_t j = 0; j < liveTriangles[vertex]; j++) triangleScores[live[j]] += delta;
+        }
+
+        current = -1;
+        float bestScore = -1.0f;
+        cacheCount = std::min<size_t>(newCount, FORSYTH_CACHE_SIZE);
+        for (size_t i = 0; i < cacheCount; i++) {
+            uint32_t vertex = newCache[i];
+            cache[i] = vertex;
+            const uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+            for (uint32_t j = 0; j < liveTriangles[vertex]; j++) {
+                if (triangleScores[live[j]] > bestScore) {
+                    bestScore = triangleScores[live[j]];
+                    current = live[j];
+                }
+            }
+        }
+    }
+}
+
+void optimizeOverdraw(uint32_t* destination,
+                      const uint32_t* indices,
+                      size_t indexCount,
+                      const Vertex* vertices,
+                      size_t vertexCount,
+                      float threshold) {
+    checkIndices(indices, indexCount, vertexCount);
+    if (destination == indices) throw std::runtime_error("Failed to optimize overdraw: destination aliases indices");
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    float targetAcmr = analyzeVertexCache(indices, indexCount, vertexCount).acmr * threshold;
+
+    // hard boundaries are where the cache is cold anyway (all three vertices miss), clusters can start
+    // there for free. Between them a cluster ends once its own acmr, counted from a cold cache,
+    // is back within threshold of the whole mesh
+    std::vector<size_t> clusterStarts;
+    FifoCache hardCache(vertexCount, VERTEX_CACHE_ANALYSIS_SIZE);
+    std::vector<bool> hardBoundary(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) misses += hardCache.access(indices[3 * t + k]) ? 1 : 0;
+        hardBoundary[t] = t == 0 || misses == 3;
+    }
+
+    FifoCache clusterCache(vertexCount, VERTEX_CACHE_ANALYSIS_SIZE);
+    size_t clusterStart = 0;
+    size_t clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (t == 0 || hardBoundary[t]) {
+            clusterStarts.push_back(t);
+            clusterStart = t;
+            clusterMisses = 0;
+            clusterCache.reset();
+        }
+        for (int k = 0; k < 3; k++) clusterMisses += clusterCache.access(indices[3 * t + k]) ? 1 : 0;
+
+        size_t clusterSize = t + 1 - clusterStart;
+        bool nextIsHard = t + 1 < triangleCount && hardBoundary[t + 1];
+        if (clusterSize >= MIN_CLUSTER_TRIANGLES && !nextIsHard && t + 1 < triangleCount &&
+            static_cast<float>(clusterMisses) <= targetAcmr * static_cast<float>(clusterSize)) {
+            clusterStarts.push_back(t + 1);
+            clusterStart = t + 1;
+            clusterMisses = 0;
+            clusterCache.reset();
+        }
+    }
+    clusterStarts.erase(std::unique(clusterStarts.begin(), clusterStarts.end()), clusterStarts.end());
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+
+    glm::vec3 meshCentroid(0.0f);
+    for (size_t v = 0; v < vertexCount; v++) meshCentroid += vertices[v].pos;
+    meshCentroid /= static_cast<float>(vertexCount);
+
+    // clusters facing away from the mesh centre are the ones seen first from most view points
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            const glm::vec3& p0 = vertices[indices[3 * t + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].pos;
+            glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = std::sqrt(glm::dot(areaNormal, areaNormal));
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += areaNormal;
+            area += triangleArea;
+        }
+        float normalLength = std::sqrt(glm::dot(normal, normal));
+        if (area > 0.0f && normalLength > 0.0f) {
+            centroid /= area;
+            sortKeys[c] = glm::dot(centroid - meshCentroid, normal / normalLength);
+        } else {
+            sortKeys[c] = 0.0f;
+        }
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {return sortKeys[a] > sortKeys[b];});
+
+    size_t output = 0;
+    for (size_t c : order) {
+        size_t begin = 3 * clusterStarts[c];
+        size_t end = 3 * clusterStarts[c + 1];
+        std::copy(indices + begin, indices + end, destination + output);
+        output += end - begin;
+    }
+}
+
+size_t optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+    checkIndices(indices.data(), indices.size(), vertices.size());
+    constexpr uint32_t UNUSED = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> fetchOrder;
+    fetchOrder.reserve(vertices.size());
+    for (uint32_t &index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = static_cast<uint32_t>(fetchOrder.size());
+            fetchOrder.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(fetchOrder);
+    return vertices.size();
+}
+
+MeshOptimizationReport optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+    MeshOptimizationReport report{};
+    report.before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    std::vector<uint32_t> cacheOrder(indices.size());
+    optimizeVertexCache(cacheOrder.data(), indices.data(), indices.size(), vertices.size());
+    // regular grids exported strip by strip can already beat the greedy order, keep whichever is better
+    VertexCacheStats reordered = analyzeVertexCache(cacheOrder.data(), cacheOrder.size(), vertices.size());
+    if (reordered.transformedVertices > report.before.transformedVertices) cacheOrder = indices;
+    optimizeOverdraw(indices.data(), cacheOrder.data(), cacheOrder.size(), vertices.data(), vertices.size(),
+                     OVERDRAW_ACMR_THRESHOLD);
+    // the clusters are bounded against the cache order, their sorted order can still end up worse than
+    // the imported one (small meshes with few clusters), the cache order alone is kept then
+    VertexCacheStats sorted = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    if (sorted.acmr > report.before.acmr * OVERDRAW_ACMR_THRESHOLD) indices = cacheOrder;
+    optimizeVertexFetch(vertices, indices);
+
+    report.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    return report;
+}
+
+} // namespace vcr
@@ -0,0 +1,57 @@
+#ifndef VCR_MESH_OPTIMIZER_HPP
+#define VCR_MESH_OPTIMIZER_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// FIFO size used to measure the post-transform cache, close to what current GPUs keep per wave
+constexpr uint32_t VERTEX_CACHE_ANALYSIS_SIZE = 16;
+
+struct VertexCacheStats {
+    uint32_t transformedVertices = 0;
+    // average cache miss ratio : transformed vertices per triangle, 0.5 is the best a grid can do
+    float acmr = 0.0f;
+    // average transform to vertex ratio : 1.0 means every vertex is shaded exactly once
+    float atvr = 0.0f;
+};
+
+struct MeshOptimizationReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// simulates a FIFO post-transform cache over the triangle list
+VertexCacheStats analyzeVertexCache(const uint32_t* indices,
+                                    size_t indexCount,
+                                    size_t vertexCount,
+                                    uint32_t cacheSize = VERTEX_CACHE_ANALYSIS_SIZE);
+
+// Forsyth's linear-speed vertex cache optimisation, greedy triangle order on an LRU cache model.
+// destination may alias indices
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache optimised triangle list into clusters that keep the cache efficiency within
+// threshold of the whole mesh, then draws the outward facing clusters first so the depth test
+// rejects more of what comes after. destination must not alias indices
+void optimizeOverdraw(uint32_t* destination,
+                      const uint32_t* indices,
+                      size_t indexCount,
+                      const Vertex* vertices,
+                      size_t vertexCount,
+                      float threshold = 1.05f);
+
+// Reorders vertices by first use in the index buffer and drops unreferenced ones,
+// indices are remapped in place. Returns the new vertex count
+size_t optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+// The full import pipeline : vertex cache, overdraw, then vertex fetch order
+MeshOptimizationReport optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+} // namespace vcr
+
+#endif // VCR_MESH_OPTIMIZER_HPP
@@ -0,0 +1,359 @@
+#include "vcr_mesh_simplifier.hpp"
+#include "vcr_mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace vcr {
+
+namespace {
+
+constexpr uint32_t NO_COLLAPSE = ~0u;
+// a collapse may not turn a triangle by more than ~75 degrees
+constexpr float MIN_NORMAL_DOT = 0.25f;
+// a level is only kept when it drops at least 20% of the previous one
+constexpr float LOD_MIN_REDUCTION = 0.8f;
+// error budget of the coarsest level, relative to the bounds diagonal
+constexpr float LOD_MAX_RELATIVE_ERROR = 0.05f;
+
+// symmetric 4x4 matrix of the sum of squared distances to a set of planes, weighted by area
+struct Quadric {
+    float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    float b0 = 0, b1 = 0, b2 = 0;
+    float c = 0;
+    float weight = 0;
+
+    void addPlane(const glm::vec3& n, float d, float w) {
+        a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+        a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a11 += q.a11; a22 += q.a22;
+        a01 += q.a01; a02 += q.a02; a12 += q.a12;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+};
+
+// mean squared distance from p to the planes of both quadrics
+float evaluate(const Quadric& q, const Quadric& r, const glm::vec3& p) {
+    float x = p.x, y = p.y, z = p.z;
+    float value = (q.a00 + r.a00) * x * x + (q.a11 + r.a11) * y * y + (q.a22 + r.a22) * z * z +
+                  2.0f * ((q.a01 + r.a01) * x * y + (q.a02 + r.a02) * x * z + (q.a12 + r.a12) * y * z) +
+                  2.0f * ((q.b0 + r.b0) * x + (q.b1 + r.b1) * y + (q.b2 + r.b2) * z) +
+                  (q.c + r.c);
+    float weight = q.weight + r.weight;
+    return std::fabs(value) / (weight > 0.0f ? weight : 1.0f);
+}
+
+struct Collapse {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+};
+
+// vertices sharing a position are one wedge, topology is built on the first vertex of each wedge
+void buildWedges(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& wedge) {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto less = [&](uint32_t a, uint32_t b) {
+        const glm::vec3& pa = vertices[a].pos;
+        const glm::vec3& pb = vertices[b].pos;
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        if (pa.z != pb.z) return pa.z < pb.z;
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    wedge.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        bool samePosition = i > 0 && vertices[order[i]].pos == vertices[order[i - 1]].pos;
+        wedge[order[i]] = samePosition ? wedge[order[i - 1]] : order[i];
+    }
+}
+
+struct DirectedEdge {
+    uint64_t key;
+    uint32_t from;
+    uint32_t to;
+    uint32_t triangle;
+};
+
+// Open borders, non manifold edges and seam ends / junctions can't move without tearing the mesh.
+// A seam vertex lying on a single seam line may only slide along it, which the target check in
+// simplifyMesh enforces, and gets extra planes through the seam edges so the line stays straight
+void classifyVertices(const uint32_t* indices,
+                      size_t indexCount,
+                      const Vertex* vertices,
+                      const std::vector<uint32_t>& wedge,
+                      std::vector<uint8_t>& locked,
+                      std::vector<Quadric>& quadrics) {
+    size_t vertexCount = wedge.size();
+    locked.assign(vertexCount, 0);
+
+    std::vector<uint32_t> used(vertexCount, NO_COLLAPSE);
+    std::vector<uint8_t> seam(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t w = wedge[indices[i]];
+        if (used[w] == NO_COLLAPSE) used[w] = indices[i];
+        else if (used[w] != indices[i]) seam[w] = 1;
+    }
+
+    std::vector<DirectedEdge> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        for (int e = 0; e < 3; e++) {
+            uint32_t from = indices[i + e];
+            uint32_t to = indices[i + (e + 1) % 3];
+            uint64_t key = (uint64_t(wedge[from]) << 32) | wedge[to];
+            edges.push_back(DirectedEdge{key, from, to, static_cast<uint32_t>(i / 3)});
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](const DirectedEdge& a, const DirectedEdge& b) {return a.key < b.key;});
+    auto findEdge = [&](uint64_t key) {
+        auto it = std::lower_bound(edges.begin(), edges.end(), key,
+                                   [](const DirectedEdge& edge, uint64_t k) {return edge.key < k;});
+        return it != edges.end() && it->key == key ? it : edges.end();
+    };
+
+    std::vector<uint8_t> seamEdges(vertexCount, 0);
+    for (size_t i = 0; i < edges.size(); i++) {
+        const DirectedEdge& edge = edges[i];
+        uint32_t a = static_cast<uint32_t>(edge.key >> 32);
+        uint32_t b = static_cast<uint32_t>(edge.key);
+        bool duplicated = (i > 0 && edges[i - 1].key == edge.key) || (i + 1 < edges.size() && edges[i + 1].key == edge.key);
+        auto opposite = findEdge((uint64_t(b) << 32) | a);
+        if (duplicated || opposite == edges.end()) {
+            locked[a] = 1;
+            locked[b] = 1;
+            continue;
+        }
+        if (opposite->to == edge.from && opposite->from == edge.to) continue;
+
+        // counted from both directions, so once per endpoint
+        seamEdges[a] = static_cast<uint8_t>(std::min(seamEdges[a] + 1, 255));
+        const glm::vec3& p0 = vertices[indices[3 * edge.triangle + 0]].pos;
+        const glm::vec3& p1 = vertices[indices[3 * edge.triangle + 1]].pos;
+        const glm::vec3& p2 = vertices[indices[3 * edge.triangle + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        glm::vec3 direction = vertices[edge.to].pos - vertices[edge.from].pos;
+        glm::vec3 planeNormal = glm::cross(direction, normal);
+        float length = std::sqrt(glm::dot(planeNormal, planeNormal));
+        if (length == 0.0f) continue;
+        planeNormal /= length;
+        float d = -glm::dot(planeNormal, vertices[edge.from].pos);
+        float weight = glm::dot(direction, direction);
+        quadrics[a].addPlane(planeNormal, d, weight);
+        quadrics[b].addPlane(planeNormal, d, weight);
+    }
+
+    for (size_t w = 0; w < vertexCount; w++) {
+        if (seam[w] ? seamEdges[w] != 2 : seamEdges[w] != 0) locked[w] = 1;
+    }
+}
+
+} // namespace
+
+size_t simplifyMesh(uint32_t* destination,
+                    const uint32_t* indices,
+                    size_t indexCount,
+                    const Vertex* vertices,
+                    size_t vertexCount,
+                    size_t targetIndexCount,
+                    float maxError,
+                    float* resultError) {
+    std::vector<uint32_t> wedge;
+    buildWedges(vertices, vertexCount, wedge);
+    std::vector<uint32_t> result(indices, indices + indexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const glm::vec3& p0 = vertices[result[i + 0]].pos;
+        const glm::vec3& p1 = vertices[result[i + 1]].pos;
+        const glm::vec3& p2 = vertices[result[i + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = std::sqrt(glm::dot(normal, normal));
+        if (area == 0.0f) continue;
+        normal /= area;
+        float d = -glm::dot(normal, p0);
+        for (int k = 0; k < 3; k++) quadrics[wedge[result[i + k]]].addPlane(normal, d, area);
+    }
+    std::vector<uint8_t> locked;
+    classifyVertices(indices, indexCount, vertices, wedge, locked, quadrics);
+
+    float maxCost = maxError * maxError;
+    float reachedCost = 0.0f;
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTarget(vertexCount, NO_COLLAPSE);
+    std::vector<uint32_t> collapsedVertices;
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<std::pair<uint32_t, uint32_t>> siblings;
+
+    // Every vertex of wedge u goes to the vertex of wedge to it shares a triangle with. On a seam each
+    // side has its own pair, a collapse across or off the seam leaves a side without one and is rejected
+    auto findTargets = [&](uint32_t u, uint32_t to) {
+        siblings.clear();
+        for (uint32_t t = triangleOffsets[u]; t < triangleOffsets[u + 1]; t++) {
+            const uint32_t* triangle = &result[3 * vertexTriangles[t]];
+            uint32_t from = NO_COLLAPSE;
+            uint32_t target = NO_COLLAPSE;
+            for (int k = 0; k < 3; k++) {
+                if (wedge[triangle[k]] == u) from = triangle[k];
+                if (wedge[triangle[k]] == to) target = triangle[k];
+            }
+            auto it = std::find_if(siblings.begin(), siblings.end(), [&](const auto& pair) {return pair.first == from;});
+            if (it == siblings.end()) siblings.emplace_back(from, target);
+            else if (it->second == NO_COLLAPSE) it->second = target;
+            else if (target != NO_COLLAPSE && it->second != target) return false;
+        }
+        for (const auto &pair : siblings) {
+            if (pair.second == NO_COLLAPSE) return false;
+        }
+        return true;
+    };
+
+    // no triangle left around u may flip or become degenerate
+    auto keepsOrientation = [&](uint32_t u, uint32_t to) {
+        const glm::vec3& target = vertices[to].pos;
+        for (uint32_t t = triangleOffsets[u]; t < triangleOffsets[u + 1]; t++) {
+            const uint32_t* triangle = &result[3 * vertexTriangles[t]];
+            glm::vec3 oldCorners[3];
+            glm::vec3 newCorners[3];
+            bool removed = false;
+            for (int k = 0; k < 3; k++) {
+                removed = removed || wedge[triangle[k]] == to;
+                oldCorners[k] = vertices[triangle[k]].pos;
+                newCorners[k] = wedge[triangle[k]] == u ? target : oldCorners[k];
+            }
+            if (removed) continue;
+            glm::vec3 oldNormal = glm::cross(oldCorners[1] - oldCorners[0], oldCorners[2] - oldCorners[0]);
+            glm::vec3 newNormal = glm::cross(newCorners[1] - newCorners[0], newCorners[2] - newCorners[0]);
+            float oldLength = std::sqrt(glm::dot(oldNormal, oldNormal));
+            float newLength = std::sqrt(glm::dot(newNormal, newNormal));
+            if (newLength == 0.0f || glm::dot(oldNormal, newNormal) < MIN_NORMAL_DOT * oldLength * newLength) return false;
+        }
+        return true;
+    };
+
+    // each pass collapses every independent cheap edge at once, then rebuilds the adjacency
+    while (result.size() > targetIndexCount) {
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+        for (uint32_t index : result) triangleOffsets[wedge[index] + 1]++;
+        for (size_t i = 0; i < vertexCount; i++) triangleOffsets[i + 1] += triangleOffsets[i];
+        vertexTriangles.resize(result.size());
+        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) vertexTriangles[fill[wedge[result[i]]]++] = static_cast<uint32_t>(i / 3);
+
+        collapses.clear();
+        for (uint32_t u = 0; u < vertexCount; u++) {
+            if (wedge[u] != u || locked[u] || triangleOffsets[u] == triangleOffsets[u + 1]) continue;
+
+            Collapse best{maxCost, u, NO_COLLAPSE};
+            for (uint32_t t = triangleOffsets[u]; t < triangleOffsets[u + 1]; t++) {
+                const uint32_t* triangle = &result[3 * vertexTriangles[t]];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t to = wedge[triangle[k]];
+                    if (to == u || to == best.to) continue;
+                    // the position is the same for every vertex of the wedge
+                    float cost = evaluate(quadrics[u], quadrics[to], vertices[to].pos);
+                    if (cost > best.cost || (cost == best.cost && best.to != NO_COLLAPSE)) continue;
+                    if (findTargets(u, to) && keepsOrientation(u, to)) best = Collapse{cost, u, to};
+                }
+            }
+            if (best.to != NO_COLLAPSE) collapses.push_back(best);
+        }
+        if (collapses.empty()) break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {return a.cost < b.cost;});
+
+        // a collapse only stays valid while nothing else in its one ring moves
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangleCount = result.size() / 3;
+        size_t targetTriangles = targetIndexCount / 3;
+        collapsedVertices.clear();
+        for (const auto &collapse : collapses) {
+            if (triangleCount <= targetTriangles) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                const uint32_t* triangle = &result[3 * vertexTriangles[t]];
+                for (int k = 0; k < 3; k++) touched[wedge[triangle[k]]] = 1;
+            }
+            findTargets(collapse.from, collapse.to);
+            for (const auto &pair : siblings) {
+                collapseTarget[pair.first] = pair.second;
+                collapsedVertices.push_back(pair.first);
+            }
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            reachedCost = std::max(reachedCost, collapse.cost);
+            // an interior edge is shared by two triangles
+            triangleCount -= std::min<size_t>(triangleCount, 2);
+        }
+        if (collapsedVertices.empty()) break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t corners[3];
+            for (int k = 0; k < 3; k++) {
+                uint32_t index = result[i + k];
+                corners[k] = collapseTarget[index] != NO_COLLAPSE ? collapseTarget[index] : index;
+            }
+            uint32_t w0 = wedge[corners[0]], w1 = wedge[corners[1]], w2 = wedge[corners[2]];
+            if (w0 == w1 || w1 == w2 || w0 == w2) continue;
+            result[write++] = corners[0];
+            result[write++] = corners[1];
+            result[write++] = corners[2];
+        }
+        result.resize(write);
+        for (uint32_t vertex : collapsedVertices) collapseTarget[vertex] = NO_COLLAPSE;
+    }
+
+    std::copy(result.begin(), result.end(), destination);
+    if (resultError) *resultError = std::sqrt(reachedCost);
+    return result.size();
+}
+
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+    std::vector<MeshLod> lods;
+    lods.push_back(MeshLod{0, static_cast<uint32_t>(indices.size()), 0.0f});
+    if (vertices.empty() || indices.empty()) return lods;
+
+    glm::vec3 min = vertices[0].pos;
+    glm::vec3 max = vertices[0].pos;
+    for (const auto &vertex : vertices) {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+    glm::vec3 extent = max - min;
+    float maxError = std::sqrt(glm::dot(extent, extent)) * LOD_MAX_RELATIVE_ERROR;
+
+    std::vector<uint32_t> lodIndices(indices.size());
+    while (lods.size() < MAX_MESH_LODS) {
+        const MeshLod previous = lods.back();
+        size_t target = (previous.indexCount / 2) / 3 * 3;
+        float error = 0.0f;
+        size_t count = simplifyMesh(lodIndices.data(),
+                                    &indices[previous.indexOffset],
+                                    previous.indexCount,
+                                    vertices.data(),
+                                    vertices.size(),
+                                    target,
+                                    maxError - previous.error,
+                                    &error);
+        if (count == 0 || count > previous.indexCount * LOD_MIN_REDUCTION) break;
+
+        optimizeVertexCache(lodIndices.data(), lodIndices.data(), count, vertices.size());
+        // each level is simplified from the one before, so the errors add up
+        lods.push_back(MeshLod{static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), previous.error + error});
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.begin() + count);
+    }
+    return lods;
+}
+
+} // namespace vcr
@@ -0,0 +1,43 @@
+#ifndef VCR_MESH_SIMPLIFIER_HPP
+#define VCR_MESH_SIMPLIFIER_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// LOD 0 is the full mesh
+constexpr uint32_t MAX_MESH_LODS = 5;
+
+// a range of the shared index buffer, every level indexes the same vertices
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    // how far the surface may be from LOD 0, in model space units
+    float error;
+};
+
+// Quadric error metric simplification by half edge collapses : vertices only ever move onto one of
+// their neighbours, so the vertex buffer is shared with the source. Vertices on a UV / color seam
+// (same position, different attributes) and on open borders are locked to keep the outline intact.
+// Stops at targetIndexCount indices or before the surface moves by more than maxError.
+// destination holds indexCount indices and may not alias indices, returns the written index count
+size_t simplifyMesh(uint32_t* destination,
+                    const uint32_t* indices,
+                    size_t indexCount,
+                    const Vertex* vertices,
+                    size_t vertexCount,
+                    size_t targetIndexCount,
+                    float maxError,
+                    float* resultError = nullptr);
+
+// Appends up to MAX_MESH_LODS - 1 coarser levels to indices, each about half of the previous one
+// and cache optimised. Returns the levels, the first being the original indices
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+} // namespace vcr
+
+#endif // VCR_MESH_SIMPLIFIER_HPP
@@ -0,0 +1,235 @@
+#include "vcr_meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vcr {
+
+namespace {
+
+constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+// normals spreading past ~84 degrees from the average can't be culled as a group
+constexpr float MIN_CONE_SPREAD = 0.1f;
+constexpr float CONE_DISABLED = 2.0f;
+
+// Ritter's bounding sphere, within a few percent of the optimal one
+void computeSphere(const Vertex* vertices, const uint32_t* meshletVertices, uint32_t count, MeshletBounds& bounds) {
+    const glm::vec3& first = vertices[meshletVertices[0]].pos;
+    glm::vec3 a = first;
+    float maxDistance = -1.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 d = vertices[meshletVertices[i]].pos - first;
+        float distance = glm::dot(d, d);
+        if (distance > maxDistance) {
+            maxDistance = distance;
+            a = vertices[meshletVertices[i]].pos;
+        }
+    }
+    glm::vec3 b = a;
+    maxDistance = -1.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 d = vertices[meshletVertices[i]].pos - a;
+        float distance = glm::dot(d, d);
+        if (distance > maxDistance) {
+            maxDistance = distance;
+            b = vertices[meshletVertices[i]].pos;
+        }
+    }
+
+    glm::vec3 center = (a + b) * 0.5f;
+    float radius = std::sqrt(maxDistance) * 0.5f;
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 d = vertices[meshletVertices[i]].pos - center;
+        float distance = std::sqrt(glm::dot(d, d));
+        if (distance > radius) {
+            // grow toward the outlier
+            float newRadius = (radius + distance) * 0.5f;
+            center += d * ((newRadius - radius) / distance);
+            radius = newRadius;
+        }
+    }
+    bounds.center = center;
+    bounds.radius = radius;
+}
+
+void computeCone(const Vertex* vertices, const MeshletData& data, const Meshlet& meshlet, MeshletBounds& bounds) {
+    const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+    const uint8_t* meshletTriangles = &data.triangles[meshlet.triangleOffset];
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const glm::vec3& p0 = vertices[meshletVertices[meshletTriangles[3 * t + 0]]].pos;
+        const glm::vec3& p1 = vertices[meshletVertices[meshletTriangles[3 * t + 1]]].pos;
+        const glm::vec3& p2 = vertices[meshletVertices[meshletTriangles[3 * t + 2]]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = std::sqrt(glm::dot(normal, normal));
+        // degenerate triangles don't face anywhere
+        if (length == 0.0f) continue;
+        normal /= length;
+        normals.push_back(normal);
+        axis += normal;
+    }
+
+    bounds.coneApex = bounds.center;
+    bounds.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    bounds.coneCutoff = CONE_DISABLED;
+    float axisLength = std::sqrt(glm::dot(axis, axis));
+    if (normals.empty() || axisLength == 0.0f) return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto &normal : normals) minDot = std::min(minDot, glm::dot(axis, normal));
+    if (minDot <= MIN_CONE_SPREAD) return;
+
+    // move the apex back along the axis until every triangle plane is in front of it,
+    // so the test stays valid for eyes close to the meshlet
+    float maxT = 0.0f;
+    size_t n = 0;
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const glm::vec3& p0 = vertices[meshletVertices[meshletTriangles[3 * t + 0]]].pos;
+        const glm::vec3& p1 = vertices[meshletVertices[meshletTriangles[3 * t + 1]]].pos;
+        const glm::vec3& p2 = vertices[meshletVertices[meshletTriangles[3 * t + 2]]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (glm::dot(normal, normal) == 0.0f) continue;
+        const glm::vec3& unitNormal = normals[n++];
+        float t0 = glm::dot(bounds.center - p0, unitNormal) / glm::dot(axis, unitNormal);
+        maxT = std::max(maxT, t0);
+    }
+
+    bounds.coneApex = bounds.center - axis * maxT;
+    bounds.coneAxis = axis;
+    bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // namespace
+
+void MeshletData::clear() {
+    meshlets.clear();
+    bounds.clear();
+    vertices.clear();
+    triangles.clear();
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m) {
+    // Gribb / Hartmann, rows of the matrix. The near plane uses the -w..w convention which is
+    // looser than Vulkan's 0..w, so nothing visible is ever rejected
+    auto row = [&](int i) {return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);};
+    Frustum frustum{};
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(3) + row(2);
+    frustum.planes[5] = row(3) - row(2);
+    for (auto &plane : frustum.planes) {
+        glm::vec3 normal(plane.x, plane.y, plane.z);
+        float length = std::sqrt(glm::dot(normal, normal));
+        if (length > 0.0f) plane /= length;
+    }
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for (const auto &plane : planes) {
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+void buildMeshlets(MeshletData& data,
+                   const Vertex* vertices,
+                   size_t vertexCount,
+                   const uint32_t* indices,
+                   size_t indexCount,
+                   uint32_t maxVertices,
+                   uint32_t maxTriangles) {
+    if (maxVertices < 3 || maxVertices > NOT_IN_MESHLET || maxTriangles == 0) {
+        throw std::runtime_error("Failed to build meshlets: invalid meshlet limits");
+    }
+    data.clear();
+    if (indexCount % 3 != 0) throw std::runtime_error("Failed to build meshlets: index count is not a multiple of 3");
+
+    size_t triangleCount = indexCount / 3;
+    data.meshlets.reserve(triangleCount / maxTriangles + 1);
+    data.triangles.reserve(indexCount);
+
+    std::vector<uint8_t> localIndex(vertexCount, NOT_IN_MESHLET);
+    Meshlet current{0, 0, 0, 0};
+
+    auto finish = [&]() {
+        if (current.triangleCount == 0) return;
+        for (uint32_t i = 0; i < current.vertexCount; i++) localIndex[data.vertices[current.vertexOffset + i]] = NOT_IN_MESHLET;
+        data.meshlets.push_back(current);
+        current = Meshlet{static_cast<uint32_t>(data.vertices.size()), static_cast<uint32_t>(data.triangles.size()), 0, 0};
+    };
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t a = indices[3 * t + 0];
+        uint32_t b = indices[3 * t + 1];
+        uint32_t c = indices[3 * t + 2];
+        if (a >= vertexCount || b >= vertexCount || c >= vertexCount) {
+            throw std::runtime_error("Failed to build meshlets: index out of range");
+        }
+        uint32_t newVertices = (localIndex[a] == NOT_IN_MESHLET) +
+                               (localIndex[b] == NOT_IN_MESHLET && b != a) +
+                               (localIndex[c] == NOT_IN_MESHLET && c != a && c != b);
+        if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles) finish();
+
+        for (uint32_t vertex : {a, b, c}) {
+            if (localIndex[vertex] == NOT_IN_MESHLET) {
+                localIndex[vertex] = static_cast<uint8_t>(current.vertexCount++);
+                data.vertices.push_back(vertex);
+            }
+            data.triangles.push_back(localIndex[vertex]);
+        }
+        current.triangleCount++;
+    }
+    finish();
+
+    data.bounds.resize(data.meshlets.size());
+    for (size_t i = 0; i < data.meshlets.size(); i++) {
+        const Meshlet& meshlet = data.meshlets[i];
+        computeSphere(vertices, &data.vertices[meshlet.vertexOffset], meshlet.vertexCount, data.bounds[i]);
+        computeCone(vertices, data, meshlet, data.bounds[i]);
+    }
+}
+
+size_t cullMeshlets(const MeshletData& data,
+                    const Frustum& frustum,
+                    const glm::vec3& eye,
+                    std::vector<uint32_t>& visible) {
+    visible.clear();
+    size_t triangleCount = 0;
+    for (size_t i = 0; i < data.meshlets.size(); i++) {
+        const MeshletBounds& bounds = data.bounds[i];
+        if (!frustum.intersectsSphere(bounds.center, bounds.radius)) continue;
+
+        glm::vec3 view = bounds.coneApex - eye;
+        float distance = std::sqrt(glm::dot(view, view));
+        if (distance > 0.0f && glm::dot(view, bounds.coneAxis) >= bounds.coneCutoff * distance) continue;
+
+        visible.push_back(static_cast<uint32_t>(i));
+        triangleCount += data.meshlets[i].triangleCount;
+    }
+    return triangleCount;
+}
+
+void packMeshlets(const MeshletData& data, size_t first, size_t count, GpuMeshlet* destination) {
+    for (size_t i = 0; i < count; i++) {
+        const Meshlet& meshlet = data.meshlets[first + i];
+        const MeshletBounds& bounds = data.bounds[first + i];
+        GpuMeshlet& packed = destination[i];
+        packed.vertexOffset = meshlet.vertexOffset;
+        packed.triangleOffset = meshlet.triangleOffset;
+        packed.vertexCount = meshlet.vertexCount;
+        packed.triangleCount = meshlet.triangleCount;
+        packed.sphere = glm::vec4(bounds.center, bounds.radius);
+        packed.coneApex = glm::vec4(bounds.coneApex, 0.0f);
+        packed.coneAxisCutoff = glm::vec4(bounds.coneAxis, bounds.coneCutoff);
+    }
+}
+
+} // namespace vcr
@@ -0,0 +1,111 @@
+#ifndef VCR_MESHLET_HPP
+#define VCR_MESHLET_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// limits that fit a mesh shader workgroup on every vendor (local indices are 8 bit)
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+// meshlets culled by one task shader workgroup, must match shaders/meshlet.task
+constexpr uint32_t MESHLET_TASK_GROUP_SIZE = 32;
+
+struct Meshlet {
+    // into MeshletData::vertices
+    uint32_t vertexOffset;
+    // into MeshletData::triangles, in bytes (3 local indices per triangle)
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+struct MeshletBounds {
+    glm::vec3 center;
+    float radius;
+    // normal cone : the meshlet is back facing when dot(normalize(coneApex - eye), coneAxis) >= coneCutoff,
+    // coneCutoff > 1 when the normals spread too much for the test to ever pass
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// a meshlet and its bounds as the task and mesh shaders read them (std430), must match shaders/meshlet.task
+struct GpuMeshlet {
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    // xyz : center, w : radius
+    glm::vec4 sphere;
+    glm::vec4 coneApex;
+    // xyz : axis, w : cutoff
+    glm::vec4 coneAxisCutoff;
+};
+static_assert(sizeof(GpuMeshlet) == 64, "GpuMeshlet must match its std430 layout");
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    // global vertex index of every meshlet vertex
+    std::vector<uint32_t> vertices;
+    // meshlet local vertex index of every triangle corner
+    std::vector<uint8_t> triangles;
+
+    size_t size() const {return meshlets.size();}
+    bool empty() const {return meshlets.empty();}
+    void clear();
+};
+
+// Frustum planes in the space of the matrix input, xyz inward normal, w distance
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+// Greedy partition of the index buffer in its current order, the import optimisation
+// already made it local so consecutive triangles share most of their vertices
+void buildMeshlets(MeshletData& data,
+                   const Vertex* vertices,
+                   size_t vertexCount,
+                   const uint32_t* indices,
+                   size_t indexCount,
+                   uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                   uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// Frustum and normal cone culling. frustum and eye are in model space.
+// visible is cleared and filled with meshlet ids, returns the number of triangles kept
+size_t cullMeshlets(const MeshletData& data,
+                    const Frustum& frustum,
+                    const glm::vec3& eye,
+                    std::vector<uint32_t>& visible);
+
+// meshlets [first, first + count) in the layout of the mesh shader path
+void packMeshlets(const MeshletData& data, size_t first, size_t count, GpuMeshlet* destination);
+
+// writes the triangles of the visible meshlets as a regular index buffer, returns the index count
+template <typename Index>
+size_t writeMeshletIndices(const MeshletData& data, const std::vector<uint32_t>& visible, Index* destination) {
+    size_t written = 0;
+    for (uint32_t id : visible) {
+        const Meshlet& meshlet = data.meshlets[id];
+        const uint32_t* meshletVertices = &data.vertices[meshlet.vertexOffset];
+        const uint8_t* meshletTriangles = &data.triangles[meshlet.triangleOffset];
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++) {
+            destination[written++] = static_cast<Index>(meshletVertices[meshletTriangles[i]]);
+        }
+    }
+    return written;
+}
+
+} // namespace vcr
+
+#endif // VCR_MESHLET_HPP
@@ -0,0 +1,182 @@
+#include "vcr_mipmap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VCR_MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace vcr {
+
+namespace {
+
+// resolution of the linear -> sRGB table, fine enough that every sRGB code round trips
+constexpr uint32_t LINEAR_TABLE_SIZE = 1u << 14;
+
+struct SrgbTables {
+    std::array<float, 256> toLinear;
+    std::array<uint8_t, LINEAR_TABLE_SIZE> toSrgb;
+
+    SrgbTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            float c = static_cast<float>(i) / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (uint32_t i = 0; i < LINEAR_TABLE_SIZE; i++) {
+            float l = static_cast<float>(i) / static_cast<float>(LINEAR_TABLE_SIZE - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, c * 255.0f + 0.5f)));
+        }
+    }
+};
+
+const SrgbTables& getSrgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// the four source texels of a destination texel, clamped at the edges
+struct Footprint {
+    const uint8_t* texels[4];
+};
+
+Footprint getFootprint(const uint8_t* src, const MipLevel& srcLevel, uint32_t x, uint32_t y) {
+    uint32_t x0 = std::min(2 * x, srcLevel.width - 1);
+    uint32_t x1 = std::min(2 * x + 1, srcLevel.width - 1);
+    uint32_t y0 = std::min(2 * y, srcLevel.height - 1);
+    uint32_t y1 = std::min(2 * y + 1, srcLevel.height - 1);
+    const uint8_t* row0 = src + size_t(y0) * srcLevel.width * 4;
+    const uint8_t* row1 = src + size_t(y1) * srcLevel.width * 4;
+    return {{row0 + x0 * 4, row0 + x1 * 4, row1 + x0 * 4, row1 + x1 * 4}};
+}
+
+void downsampleScalar(const uint8_t* src, const MipLevel& srcLevel, uint8_t* dst, const MipLevel& dstLevel) {
+    const SrgbTables& tables = getSrgbTables();
+    const float scale = static_cast<float>(LINEAR_TABLE_SIZE - 1);
+    for (uint32_t y = 0; y < dstLevel.height; y++) {
+        for (uint32_t x = 0; x < dstLevel.width; x++) {
+            Footprint footprint = getFootprint(src, srcLevel, x, y);
+            uint8_t* out = dst + (size_t(y) * dstLevel.width + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                // same association as the SSE2 version so both round the same way
+                float sum = (tables.toLinear[footprint.texels[0][c]] + tables.toLinear[footprint.texels[1][c]]) +
+                            (tables.toLinear[footprint.texels[2][c]] + tables.toLinear[footprint.texels[3][c]]);
+                float linear = sum * 0.25f;
+                out[c] = tables.toSrgb[static_cast<uint32_t>(linear * scale + 0.5f)];
+            }
+            uint32_t alpha = footprint.texels[0][3] + footprint.texels[1][3] + footprint.texels[2][3] + footprint.texels[3][3];
+            out[3] = static_cast<uint8_t>((alpha + 2) / 4);
+        }
+    }
+}
+
+#ifdef VCR_MIPMAP_SSE2
+
+// the table lookups stay scalar (a gather is no faster), the sums, the scaling and the rounding
+// of a texel's channels go four wide, and a pair of source texels is read per load
+void downsampleSse2(const uint8_t* src, const MipLevel& srcLevel, uint8_t* dst, const MipLevel& dstLevel) {
+    const SrgbTables& tables = getSrgbTables();
+    const float* toLinear = tables.toLinear.data();
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 scale = _mm_set1_ps(static_cast<float>(LINEAR_TABLE_SIZE - 1));
+    const __m128 half = _mm_set1_ps(0.5f);
+    // the last column / row clamps when the source size is odd, the footprint takes care of it
+    uint32_t pairedWidth = std::min(dstLevel.width, srcLevel.width / 2);
+    for (uint32_t y = 0; y < dstLevel.height; y++) {
+        const uint8_t* row0 = src + size_t(std::min(2 * y, srcLevel.height - 1)) * srcLevel.width * 4;
+        const uint8_t* row1 = src + size_t(std::min(2 * y + 1, srcLevel.height - 1)) * srcLevel.width * 4;
+        uint8_t* out = dst + size_t(y) * dstLevel.width * 4;
+        for (uint32_t x = 0; x < dstLevel.width; x++) {
+            const uint8_t* a;
+            const uint8_t* b;
+            const uint8_t* c;
+            const uint8_t* d;
+            if (x < pairedWidth) {
+                a = row0 + x * 8;
+                b = a + 4;
+                c = row1 + x * 8;
+                d = c + 4;
+            } else {
+                Footprint footprint = getFootprint(src, srcLevel, x, y);
+                a = footprint.texels[0];
+                b = footprint.texels[1];
+                c = footprint.texels[2];
+                d = footprint.texels[3];
+            }
+            __m128 la = _mm_setr_ps(toLinear[a[0]], toLinear[a[1]], toLinear[a[2]], 0.0f);
+            __m128 lb = _mm_setr_ps(toLinear[b[0]], toLinear[b[1]], toLinear[b[2]], 0.0f);
+            __m128 lc = _mm_setr_ps(toLinear[c[0]], toLinear[c[1]], toLinear[c[2]], 0.0f);
+            __m128 ld = _mm_setr_ps(toLinear[d[0]], toLinear[d[1]], toLinear[d[2]], 0.0f);
+            __m128 linear = _mm_mul_ps(_mm_add_ps(_mm_add_ps(la, lb), _mm_add_ps(lc, ld)), quarter);
+            // truncation of a positive value + 0.5, like the scalar cast
+            __m128i index = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(linear, scale), half));
+            alignas(16) int32_t indices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+            uint8_t* texel = out + x * 4;
+            texel[0] = tables.toSrgb[indices[0]];
+            texel[1] = tables.toSrgb[indices[1]];
+            texel[2] = tables.toSrgb[indices[2]];
+            texel[3] = static_cast<uint8_t>((a[3] + b[3] + c[3] + d[3] + 2) / 4);
+        }
+    }
+}
+
+#endif
+
+using DownsampleFn = void (*)(const uint8_t*, const MipLevel&, uint8_t*, const MipLevel&);
+
+void generateMipChain(uint8_t* data, const std::vector<MipLevel>& levels, DownsampleFn downsample) {
+    for (size_t i = 1; i < levels.size(); i++) {
+        downsample(data + levels[i - 1].offset, levels[i - 1], data + levels[i].offset, levels[i]);
+    }
+}
+
+} // namespace
+
+uint32_t computeMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0 && levels < MAX_MIP_LEVELS) levels++;
+    return levels;
+}
+
+std::vector<MipLevel> computeMipChain(uint32_t width, uint32_t height, uint32_t texelSize, uint32_t blockExtent) {
+    std::vector<MipLevel> levels(computeMipLevelCount(width, height));
+    uint64_t offset = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        MipLevel& level = levels[i];
+        level.width = std::max(width >> i, 1u);
+        level.height = std::max(height >> i, 1u);
+        level.offset = offset;
+        uint64_t blocksWide = (level.width + blockExtent - 1) / blockExtent;
+        uint64_t blocksHigh = (level.height + blockExtent - 1) / blockExtent;
+        level.size = blocksWide * blocksHigh * texelSize;
+        offset = alignUp(offset + level.size, MIP_LEVEL_ALIGNMENT);
+    }
+    return levels;
+}
+
+uint64_t getMipChainSize(const std::vector<MipLevel>& levels) {
+    return levels.empty() ? 0 : levels.back().offset + levels.back().size;
+}
+
+void generateMipChainSrgb(uint8_t* data, const std::vector<MipLevel>& levels) {
+#ifdef VCR_MIPMAP_SSE2
+    generateMipChain(data, levels, downsampleSse2);
+#else
+    generateMipChain(data, levels, downsampleScalar);
+#endif
+}
+
+void generateMipChainSrgbScalar(uint8_t* data, const std::vector<MipLevel>& levels) {
+    generateMipChain(data, levels, downsampleScalar);
+}
+
+} // namespace vcr
@@ -0,0 +1,41 @@
+#ifndef VCR_MIPMAP_HPP
+#define VCR_MIPMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// enough for a 32768 x 32768 texture
+constexpr uint32_t MAX_MIP_LEVELS = 16;
+// every level starts aligned to this, it covers the texel size and STAGING_ALIGNMENT
+constexpr uint64_t MIP_LEVEL_ALIGNMENT = 16;
+// levels this size and smaller make the mip tail, always resident when streaming
+constexpr uint32_t MIP_TAIL_EXTENT = 128;
+
+// a level of a mip chain stored back to back, rows tightly packed.
+// block compressed chains count rows of blocks, width and height stay in texels
+struct MipLevel {
+    uint32_t width;
+    uint32_t height;
+    // from the start of level 0
+    uint64_t offset;
+    uint64_t size;
+};
+
+uint32_t computeMipLevelCount(uint32_t width, uint32_t height);
+// texelSize is the size of a block when blockExtent > 1, partial blocks at the edges are whole blocks
+std::vector<MipLevel> computeMipChain(uint32_t width, uint32_t height, uint32_t texelSize, uint32_t blockExtent = 1);
+// offset + size of the last level
+uint64_t getMipChainSize(const std::vector<MipLevel>& levels);
+
+// Fills levels 1.. of an RGBA8 sRGB chain from level 0 : 2x2 box filter averaged in linear space,
+// alpha averaged as is. Odd sizes clamp at the edge. SSE2 when available, the result is
+// the same as the scalar version bit for bit
+void generateMipChainSrgb(uint8_t* data, const std::vector<MipLevel>& levels);
+void generateMipChainSrgbScalar(uint8_t* data, const std::vector<MipLevel>& levels);
+
+} // namespace vcr
+
+#endif // VCR_MIPMAP_HPP
@@ -1,161 +1,315 @@
 #include "vcr_model.hpp"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include "vcr_obj_parser.hpp"
+#include "vcr_mesh_optimizer.hpp"
+#include "vcr_trace.hpp"
+#include "thread_utils.hpp"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
-#include <unordered_map>
-
-namespace std {
-    template<> struct hash<vcr::Vertex> {
-        size_t operator()(vcr::Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                   (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
+#include <algorithm>
+#include <cstring>
 
 namespace vcr {
 
 Model::Model(Device &device) : device(device) {}
 
 Model::~Model() {
-    vkDestroyBuffer(device.getDevice(), vertexBuffer, nullptr);
-    vkFreeMemory(device.getDevice(), vertexBufferMemory, nullptr);
-    vkDestroyBuffer(device.getDevice(), indexBuffer, nullptr);
-    vkFreeMemory(device.getDevice(), indexBufferMemory, nullptr);
+    destroyBuffer(device.getDevice(), device.getAllocator(), vertexBuffer, vertexBufferAllocation);
+    destroyBuffer(device.getDevice(), device.getAllocator(), indexBuffer, indexBufferAllocation);
+    destroyBuffer(device.getDevice(), device.getAllocator(), meshletBuffer, meshletBufferAllocation);
+    destroyBuffer(device.getDevice(), device.getAllocator(), meshletVertexBuffer, meshletVertexBufferAllocation);
+    destroyBuffer(device.getDevice(), device.getAllocator(), meshletTriangleBuffer, meshletTriangleBufferAllocation);
     vkDestroySampler(device.getDevice(), textureSampler, nullptr);
-    vkDestroyImageView(device.getDevice(), textureImageView, nullptr);
-    vkDestroyImage(device.getDevice(), textureImage, nullptr);
-    vkFreeMemory(device.getDevice(), textureImageMemory, nullptr);
+    destroyTextureLevels(texture);
+    destroyTextureLevels(pendingTexture);
+    releaseRetiredTextures();
 }
 
 void Model::loadModel(const std::string &filePath) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())) {
-        throw std::runtime_error("Failed to load model: " + warn + err);
+    TraceScope trace{"loadModel"};
+    if (meshCache.open(filePath)) {
+        vertexCount = meshCache.getVertexCount();
+        indexCount = meshCache.getIndexCount();
+        bounds = meshCache.getBounds();
+        lods.assign(meshCache.getLods(), meshCache.getLods() + meshCache.getLodCount());
+        indexType = chooseIndexType(vertexCount);
+        vertexEncoding = vertexCompression ? VertexEncoding::choose(meshCache.getVertices(), vertexCount, bounds)
+                                           : VertexEncoding{};
+        buildMeshletData();
+        std::cout << "Model loaded from cache with " << vertexCount << " vertices." << "\n";
+        return;
     }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-    for (const auto &shape : shapes) {
-        for (const auto &index : shape.mesh.indices) {
-            Vertex vertex{};
-
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0 - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.color = {1.0f, 1.0f, 1.0f};
-
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertexData.size());
-                vertexData.push_back(vertex);
-            }
-            indices.push_back(uniqueVertices[vertex]);
+    parseObj(filePath, vertexData, indices);
+    // the optimised order is what goes into the cache, so this only runs on import
+    MeshOptimizationReport report = optimizeMesh(vertexData, indices);
+    std::cout << "Mesh optimized : ACMR " << report.before.acmr << " -> " << report.after.acmr
+              << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << "\n";
+    // coarser levels go after the full mesh in the same index buffer
+    lods = buildLodChain(vertexData, indices);
+    std::cout << "LODs :";
+    for (const auto &lod : lods) std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+    std::cout << "\n";
+    vertexCount = static_cast<uint32_t>(vertexData.size());
+    indexCount = static_cast<uint32_t>(indices.size());
+    indexType = chooseIndexType(vertexCount);
+
+    bounds = {};
+    if (!vertexData.empty()) {
+        bounds.min = bounds.max = vertexData[0].pos;
+        for (const auto &vertex : vertexData) {
+            bounds.min = glm::min(bounds.min, vertex.pos);
+            bounds.max = glm::max(bounds.max, vertex.pos);
         }
     }
-    std::cout << "Model loaded with " << vertexData.size() << " vertices." << "\n";
+
+    vertexEncoding = vertexCompression ? VertexEncoding::choose(vertexData.data(), vertexCount, bounds)
+                                       : VertexEncoding{};
+    buildMeshletData();
+
+    if (!MeshCache::write(filePath,
+                          vertexData.data(),
+                          vertexCount,
+                          indices.data(),
+                          indexCount,
+                          lods.data(),
+                          static_cast<uint32_t>(lods.size()),
+                          bounds)) {
+        std::cerr << "Failed to write mesh cache for " << filePath << "\n";
+    }
+    std::cout << "Model loaded with " << vertexCount << " vertices." << "\n";
+    std::cout << "Vertex stride : " << vertexEncoding.stride << " bytes (" << sizeof(Vertex) << " unencoded)" << "\n";
 }
 
-void Model::createVertexBuffer() {
-    VkDeviceSize bufferSize = sizeof(vertexData[0]) * vertexData.size();
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+void Model::buildMeshletData() {
+    meshlets.clear();
+    if (!meshletsEnabled) return;
+    // runs on the optimised order of LOD 0, cheap enough to not be worth caching
+    buildMeshlets(meshlets, getVertexSource(), vertexCount, getIndexSource() + lods[0].indexOffset, lods[0].indexCount);
+    std::cout << "Meshlets : " << meshlets.size() << " (" << MESHLET_MAX_VERTICES << " vertices / "
+              << MESHLET_MAX_TRIANGLES << " triangles max)" << "\n";
+}
 
-    createBuffer(device.getDevice(),
-                 device.getPhysicalDevice(),
-                 bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer,
-                 stagingBufferMemory);
+const Vertex* Model::getVertexSource() const {
+    return meshCache.isOpen() ? meshCache.getVertices() : vertexData.data();
+}
+
+const uint32_t* Model::getIndexSource() const {
+    return meshCache.isOpen() ? meshCache.getIndices() : indices.data();
+}
 
-    void* data;
-    vkMapMemory(device.getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertexData.data(), (size_t)bufferSize);
-    vkUnmapMemory(device.getDevice(), stagingBufferMemory);
+void Model::createMeshUploads(std::vector<UploadStep> &steps) {
+    createVertexBuffer(steps);
+    createIndexBuffer(steps);
+    if (meshletBuffersEnabled && !meshlets.empty()) createMeshletBuffers(steps);
+}
 
+void Model::createVertexBuffer(std::vector<UploadStep> &steps) {
+    VkDeviceSize bufferSize = vertexEncoding.getEncodedSize(vertexCount);
+    bool meshShaderRead = meshletBuffersEnabled && !meshlets.empty();
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    if (meshShaderRead) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
     createBuffer(device.getDevice(),
-                 device.getPhysicalDevice(),
+                 device.getAllocator(),
                  bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 usage,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  vertexBuffer,
-                 vertexBufferMemory);
-    copyBuffer(device.getDevice(),
-               device.getCommandPool(),
-               device.getGraphicsQueue(),
-               stagingBuffer,
-               vertexBuffer,
-               bufferSize);
-    vkDestroyBuffer(device.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(device.getDevice(), stagingBufferMemory, nullptr);
+                 vertexBufferAllocation);
+
+    // encoded straight into the staging ring, chunk by chunk
+    const Vertex* source = getVertexSource();
+    uint32_t stride = vertexEncoding.stride;
+    appendBufferUploadSteps(steps, vertexBuffer, 0, VkDeviceSize(stride) * vertexCount,
+                            [this, source, stride](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                vertexEncoding.encodeVertices(source + offset / stride, size / stride, dst);
+                            },
+                            stride);
+    UploadStep release;
+    release.bytes = vertexEncoding.color == ColorEncoding::CONSTANT ? 4 * sizeof(uint8_t) : 0;
+    release.record = [this, source, meshShaderRead](UploadBatch &batch) {
+        if (vertexEncoding.color == ColorEncoding::CONSTANT) {
+            StagingRegion staging = batch.allocateStaging(4 * sizeof(uint8_t));
+            vertexEncoding.encodeConstant(source, vertexCount, staging.data);
+            batch.copyBuffer(staging.buffer, vertexBuffer, 4 * sizeof(uint8_t), staging.offset,
+                             vertexEncoding.getConstantOffset(vertexCount));
+        }
+        if (meshShaderRead) {
+            batch.releaseBuffer(vertexBuffer,
+                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT,
+                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+        } else {
+            batch.releaseBuffer(vertexBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        }
+    };
+    steps.push_back(std::move(release));
 }
 
-void Model::createIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    createBuffer(device.getDevice(),
-                 device.getPhysicalDevice(),
-                 bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer,
-                 stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(device.getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device.getDevice(), stagingBufferMemory);
+void Model::createIndexBuffer(std::vector<UploadStep> &steps) {
+    VkDeviceSize indexSize = getIndexSize(indexType);
+    VkDeviceSize bufferSize = indexSize * indexCount;
 
     createBuffer(device.getDevice(),
-                 device.getPhysicalDevice(),
+                 device.getAllocator(),
                  bufferSize,
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  indexBuffer,
-                 indexBufferMemory);
-    copyBuffer(device.getDevice(),
-               device.getCommandPool(),
-               device.getGraphicsQueue(),
-               stagingBuffer,
-               indexBuffer,
-               bufferSize);
-    vkDestroyBuffer(device.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(device.getDevice(), stagingBufferMemory, nullptr);
+                 indexBufferAllocation);
+
+    // narrowed while writing the staging ring when 16 bit, the cache keeps 32 bit indices
+    const uint32_t* source = getIndexSource();
+    VkIndexType type = indexType;
+    appendBufferUploadSteps(steps, indexBuffer, 0, bufferSize,
+                            [source, type, indexSize](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                writeIndices(source + offset / indexSize, size / indexSize, type, dst);
+                            },
+                            indexSize);
+    UploadStep release;
+    release.record = [this](UploadBatch &batch) {
+        batch.releaseBuffer(indexBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+    };
+    steps.push_back(std::move(release));
+}
+
+// GpuMeshlet array, meshlet vertices and the 8 bit local triangles, padded to whole words for the shaders
+void Model::createMeshletBuffers(std::vector<UploadStep> &steps) {
+    VkDeviceSize meshletSize = sizeof(GpuMeshlet) * meshlets.size();
+    VkDeviceSize vertexSize = sizeof(uint32_t) * meshlets.vertices.size();
+    VkDeviceSize triangleSize = (meshlets.triangles.size() + 3) / 4 * 4;
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    createBuffer(device.getDevice(), device.getAllocator(), meshletSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 meshletBuffer, meshletBufferAllocation);
+    createBuffer(device.getDevice(), device.getAllocator(), vertexSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 meshletVertexBuffer, meshletVertexBufferAllocation);
+    createBuffer(device.getDevice(), device.getAllocator(), triangleSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 meshletTriangleBuffer, meshletTriangleBufferAllocation);
+
+    appendBufferUploadSteps(steps, meshletBuffer, 0, meshletSize,
+                            [this](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                packMeshlets(meshlets, offset / sizeof(GpuMeshlet), size / sizeof(GpuMeshlet),
+                                             static_cast<GpuMeshlet*>(dst));
+                            },
+                            sizeof(GpuMeshlet));
+    appendBufferUploadSteps(steps, meshletVertexBuffer, 0, vertexSize,
+                            [this](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                std::memcpy(dst, reinterpret_cast<const uint8_t*>(meshlets.vertices.data()) + offset, size);
+                            },
+                            sizeof(uint32_t));
+    appendBufferUploadSteps(steps, meshletTriangleBuffer, 0, triangleSize,
+                            [this](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                VkDeviceSize available = std::min<VkDeviceSize>(size, meshlets.triangles.size() - offset);
+                                std::memcpy(dst, meshlets.triangles.data() + offset, available);
+                                std::memset(static_cast<uint8_t*>(dst) + available, 0, size - available);
+                            },
+                            sizeof(uint32_t));
+    UploadStep release;
+    release.record = [this](UploadBatch &batch) {
+        // the task shader culls with the meshlet bounds, the mesh shader reads all three
+        batch.releaseBuffer(meshletBuffer,
+                            VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT,
+                            VK_ACCESS_SHADER_READ_BIT);
+        batch.releaseBuffer(meshletVertexBuffer, VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT);
+        batch.releaseBuffer(meshletTriangleBuffer, VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT);
+    };
+    steps.push_back(std::move(release));
+}
+
+void Model::loadTexture(const std::string &filePath) {
+    if (openTextureCache(filePath)) return;
+    std::vector<char> data = readFile(filePath);
+    decodeTexture(filePath, data.data(), data.size());
+}
+
+bool Model::openTextureCache(const std::string &filePath) {
+    if (textureCompression != TextureCompression::NONE) {
+        // a cache written with the other setting is stale, the import runs again
+        if (!compressedCache.open(filePath) ||
+            (compressedCache.getFormat() == BlockFormat::BC7) != (textureCompression == TextureCompression::QUALITY)) {
+            compressedCache.close();
+            return false;
+        }
+        texWidth = compressedCache.getWidth();
+        texHeight = compressedCache.getHeight();
+        mipChain = compressedCache.getMipLevels();
+        mipLevels = static_cast<uint32_t>(mipChain.size());
+        textureFormat = static_cast<VkFormat>(compressedCache.getVkFormat());
+        texelSize = getBlockSize(compressedCache.getFormat());
+        blockExtent = BLOCK_EXTENT;
+        return true;
+    }
+    if (!textureCache.open(filePath)) return false;
+    texWidth = textureCache.getWidth();
+    texHeight = textureCache.getHeight();
+    mipChain = textureCache.getMipLevels();
+    mipLevels = textureCache.getMipLevelCount();
+    textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    texelSize = 4;
+    blockExtent = 1;
+    return true;
 }
 
-void Model::createTextures(const std::string &filePath) {
-    createTextureImage(filePath);
-    createTextureImageView();
+void Model::decodeTexture(const std::string &filePath, const void* data, size_t size) {
+    TraceScope trace{"decodeTexture"};
+    if (!decodeTextureRgba8(data, size, decodedTexture)) {
+        throw std::runtime_error("Failed to load texture image!");
+    }
+    texWidth = decodedTexture.width;
+    texHeight = decodedTexture.height;
+    mipChain = computeMipChain(texWidth, texHeight, 4);
+    mipLevels = static_cast<uint32_t>(mipChain.size());
+    textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    texelSize = 4;
+    blockExtent = 1;
+    // the levels go after level 0 in the same allocation
+    if (!reserveTextureStorage(decodedTexture, getMipChainSize(mipChain))) {
+        throw std::runtime_error("Failed to allocate texture mip chain!");
+    }
+    generateMipChainSrgb(decodedTexture.pixels.get(), mipChain);
+
+    if (textureCompression == TextureCompression::NONE) {
+        if (!TextureCache::write(filePath, decodedTexture.pixels.get(), mipChain)) {
+            std::cerr << "Failed to write texture cache for " << filePath << "\n";
+            return;
+        }
+        // levels are streamed from the cache from now on, no need to keep the texels around
+        if (textureCache.open(filePath)) decodedTexture.pixels.reset();
+        return;
+    }
+
+    // only on import, the blocks are spread over every core
+    BlockFormat format = chooseBlockFormat(textureCompression, decodedTexture.pixels.get(), size_t(texWidth) * texHeight);
+    compressedBlocks = compressMipChain(format, decodedTexture.pixels.get(), mipChain, defaultThreadCount());
+    decodedTexture.pixels.reset();
+    uint64_t uncompressedSize = getMipChainSize(mipChain);
+    mipChain = computeMipChain(texWidth, texHeight, getBlockSize(format), BLOCK_EXTENT);
+    textureFormat = static_cast<VkFormat>(Ktx2Cache::getVkFormat(format));
+    texelSize = getBlockSize(format);
+    blockExtent = BLOCK_EXTENT;
+    std::cout << "Texture compressed to " << getBlockFormatName(format) << " : " << uncompressedSize / 1024
+              << " KB -> " << compressedBlocks.size() / 1024 << " KB" << "\n";
+    if (!Ktx2Cache::write(filePath, format, texWidth, texHeight, compressedBlocks.data(), mipChain)) {
+        std::cerr << "Failed to write texture cache for " << filePath << "\n";
+        return;
+    }
+    if (compressedCache.open(filePath)) compressedBlocks = {};
+}
+
+void Model::createTextureUploads(std::vector<UploadStep> &steps) {
     createTextureSampler();
+    // the tail is enough to draw with, finer levels come with requestTextureLevel
+    createTextureLevelUploads(getTextureTailLevel(), steps);
+}
+
+uint32_t Model::getTextureTailLevel() const {
+    uint32_t level = 0;
+    while (level + 1 < mipLevels && std::max(mipChain[level].width, mipChain[level].height) > MIP_TAIL_EXTENT) level++;
+    return level;
 }
 
-void Model::createTextureImageView() {
-    textureImageView = createImageView(device.getDevice(),
-                                       textureImage,
-                                       VK_FORMAT_R8G8B8A8_SRGB,
-                                       VK_IMAGE_ASPECT_COLOR_BIT,
-                                       mipLevels);
+VkDeviceSize Model::getTextureLevelsSize(uint32_t baseLevel) const {
+    VkDeviceSize size = 0;
+    for (uint32_t level = baseLevel; level < mipLevels; level++) size += mipChain[level].size;
+    return size;
 }
 
 void Model::createTextureSampler() {
@@ -177,6 +331,7 @@ void Model::createTextureSampler() {
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
+    // lod is relative to the view, whose base level follows what is resident
     samplerInfo.minLod = 0.0f;
     samplerInfo.maxLod = static_cast<float>(mipLevels);
 
@@ -185,103 +340,103 @@ void Model::createTextureSampler() {
     }
 }
 
-void Model::createTextureImage(const std::string &filePath) {
-    // TODO : right now we record commands one by one using helper functions (single time commands)
-    // Should add a setupcommandbuffer to record all commands in one go and a flushcommandbuffer to submit them
-    // see https://vulkan-tutorial.com/Texture_mapping/Images at the end of the page
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-    VkDeviceSize imageSize = texWidth * texHeight * 4; // 4 channels for RGBA
-    if (!pixels) {
-        throw std::runtime_error("Failed to load texture image!");
+StagingWriter Model::getTextureSource() const {
+    // no host copy of the texels with a cache, the file is read into the staging ring
+    if (compressedCache.isOpen()) {
+        return [this](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+            if (!compressedCache.read(dst, offset, size)) {
+                throw std::runtime_error("Failed to read texture cache!");
+            }
+        };
+    }
+    if (textureCache.isOpen()) {
+        return [this](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+            if (!textureCache.read(dst, offset, size)) {
+                throw std::runtime_error("Failed to read texture cache!");
+            }
+        };
     }
+    const uint8_t* source = compressedBlocks.empty() ? decodedTexture.pixels.get() : compressedBlocks.data();
+    return [source](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+        std::memcpy(dst, source + offset, size);
+    };
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(device.getDevice(),
-                 device.getPhysicalDevice(),
-                 imageSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer,
-                 stagingBufferMemory);
-    void* data;
-    vkMapMemory(device.getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, (size_t)imageSize);
-    vkUnmapMemory(device.getDevice(), stagingBufferMemory);
-    stbi_image_free(pixels);
+void Model::createTextureLevelUploads(uint32_t baseLevel, std::vector<UploadStep> &steps) {
+    if (!decodedTexture.pixels && !textureCache.isOpen() && compressedBlocks.empty() && !compressedCache.isOpen()) {
+        throw std::runtime_error("Failed to create texture image, nothing loaded!");
+    }
+    if (pendingTexture.image != VK_NULL_HANDLE) {
+        throw std::runtime_error("Failed to create texture image, a level change is already pending!");
+    }
+    baseLevel = std::min(baseLevel, mipLevels - 1);
+    uint32_t levelCount = mipLevels - baseLevel;
 
+    pendingTexture.baseLevel = baseLevel;
     createImage(device.getDevice(),
-                device.getPhysicalDevice(),
-                texWidth,
-                texHeight,
-                mipLevels,
-                VK_FORMAT_R8G8B8A8_SRGB,
+                device.getAllocator(),
+                mipChain[baseLevel].width,
+                mipChain[baseLevel].height,
+                levelCount,
+                textureFormat,
                 VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                textureImage,
-                textureImageMemory);
-
-    transitionImageLayout(device.getDevice(),
-                          device.getCommandPool(),
-                          device.getGraphicsQueue(),
-                          textureImage,
-                          VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          mipLevels);
-
-    copyBufferToImage(device.getDevice(),
-                      device.getCommandPool(),
-                      device.getGraphicsQueue(),
-                      stagingBuffer,
-                      textureImage,
-                      static_cast<uint32_t>(texWidth),
-                      static_cast<uint32_t>(texHeight));
-
-    vkDestroyBuffer(device.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(device.getDevice(), stagingBufferMemory, nullptr);
-
-    generateMipmaps(device.getDevice(),
-                    device.getPhysicalDevice(),
-                    device.getCommandPool(),
-                    device.getGraphicsQueue(),
-                    textureImage,
-                    VK_FORMAT_R8G8B8A8_SRGB,
-                    texWidth,
-                    texHeight,
-                    mipLevels);
+                pendingTexture.image,
+                pendingTexture.allocation);
+
+    VkImage image = pendingTexture.image;
+    UploadStep transition;
+    transition.record = [this, image, levelCount](UploadBatch &batch) {
+        batch.transitionImageLayout(image,
+                                    textureFormat,
+                                    VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    levelCount);
+    };
+    steps.push_back(std::move(transition));
+    // offsets stay those of the whole chain, indices are the image levels
+    std::vector<MipLevel> levels(mipChain.begin() + baseLevel, mipChain.end());
+    appendImageLevelUploadSteps(steps, image, levels, texelSize, getTextureSource(), blockExtent);
+
+    UploadStep release;
+    release.record = [image, levelCount](UploadBatch &batch) {
+        batch.releaseImage(image,
+                           levelCount,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                           VK_ACCESS_SHADER_READ_BIT);
+    };
+    steps.push_back(std::move(release));
+}
+
+void Model::commitTextureLevel() {
+    pendingTexture.view = createImageView(device.getDevice(),
+                                          pendingTexture.image,
+                                          textureFormat,
+                                          VK_IMAGE_ASPECT_COLOR_BIT,
+                                          mipLevels - pendingTexture.baseLevel);
+    if (texture.image != VK_NULL_HANDLE) retiredTextures.push_back(texture);
+    texture = pendingTexture;
+    pendingTexture = {};
+}
+
+VkDeviceSize Model::getRetiredTexturesSize() const {
+    VkDeviceSize size = 0;
+    for (const auto &levels : retiredTextures) size += getTextureLevelsSize(levels.baseLevel);
+    return size;
 }
 
-VkVertexInputBindingDescription Model::getBindingDescription() {
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    return bindingDescription;
+void Model::releaseRetiredTextures() {
+    for (auto &levels : retiredTextures) destroyTextureLevels(levels);
+    retiredTextures.clear();
 }
 
-std::array<VkVertexInputAttributeDescription, 3> Model::getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, color);
-    
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-    return attributeDescriptions;
+void Model::destroyTextureLevels(TextureLevels &levels) {
+    vkDestroyImageView(device.getDevice(), levels.view, nullptr);
+    destroyImage(device.getDevice(), device.getAllocator(), levels.image, levels.allocation);
+    levels = {};
 }
 
-}
\ No newline at end of file
+}
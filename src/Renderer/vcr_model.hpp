@@ -2,6 +2,16 @@
 #define VCR_MODEL_HPP
 
 #include "vcr_device.hpp"
+#include "vcr_vertex.hpp"
+#include "vcr_mesh_cache.hpp"
+#include "vcr_vertex_encoding.hpp"
+#include "vcr_meshlet.hpp"
+#include "vcr_index_buffer.hpp"
+#include "vcr_block_compression.hpp"
+#include "vcr_ktx2.hpp"
+#include "vcr_texture_cache.hpp"
+#include "vcr_texture_decoder.hpp"
+#include "vcr_mesh_simplifier.hpp"
 
 #include "vk_utils.hpp"
 
@@ -12,33 +22,79 @@
 
 #include <vector>
 #include <array>
+#include <memory>
 
 namespace vcr {
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
-
-    bool operator==(const Vertex& other) const {
-        return pos == other.pos && color == other.color && texCoord == other.texCoord;
-    }
-};
-
 class Model {
 private:
     std::vector<Vertex> vertexData;
     std::vector<uint32_t> indices;
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    // when the mesh comes from the binary cache the data stays in the mapped file
+    // and is copied from there straight into the staging buffers
+    MeshCache meshCache;
+    MeshBounds bounds;
+    uint32_t vertexCount = 0;
+    // of every LOD together, the ranges are in lods
+    uint32_t indexCount = 0;
+    std::vector<MeshLod> lods;
+    // 16 bit whenever every vertex is reachable with it, picked in loadModel
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    // layout of the GPU vertex stream, picked in loadModel. without compression the Vertex array as is
+    bool vertexCompression = true;
+    VertexEncoding vertexEncoding;
+    // cluster partition used for culling, only built when enabled before loadModel
+    bool meshletsEnabled = false;
+    MeshletData meshlets;
+    // the meshlets on the GPU for the mesh shader path, which also reads the vertex buffer as storage
+    bool meshletBuffersEnabled = false;
+    VkBuffer meshletBuffer = VK_NULL_HANDLE;
+    Allocation meshletBufferAllocation;
+    VkBuffer meshletVertexBuffer = VK_NULL_HANDLE;
+    Allocation meshletVertexBufferAllocation;
+    VkBuffer meshletTriangleBuffer = VK_NULL_HANDLE;
+    Allocation meshletTriangleBufferAllocation;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    Allocation vertexBufferAllocation;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    Allocation indexBufferAllocation;
+
+    // a texture image holding the levels of the chain from baseLevel down, image level 0 is chain level baseLevel
+    struct TextureLevels {
+        VkImage image = VK_NULL_HANDLE;
+        Allocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t baseLevel = 0;
+    };
+
+    // with a texture cache the texels are read from it straight into the staging ring, the cache
+    // stays open so levels can be streamed in and out. without one (its write failed) the decoded
+    // chain stays in host memory instead. either way the whole mip chain is built on the CPU,
+    // laid out as mipChain says. compressed textures use the KTX2 cache and compressedBlocks
+    TextureCompression textureCompression = TextureCompression::NONE;
+    TextureCache textureCache;
+    Ktx2Cache compressedCache;
+    DecodedTexture decodedTexture;
+    std::vector<uint8_t> compressedBlocks;
+    std::vector<MipLevel> mipChain;
+    VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    // bytes of a texel, of a block when compressed
+    uint32_t texelSize = 4;
+    uint32_t blockExtent = 1;
+    uint32_t texWidth = 0;
+    uint32_t texHeight = 0;
+    // of the whole chain, the image may hold fewer
+    uint32_t mipLevels = 1;
+    TextureLevels texture;
+    // being uploaded, replaces texture in commitTextureLevel
+    TextureLevels pendingTexture;
+    // replaced but maybe still sampled by a frame in flight
+    std::vector<TextureLevels> retiredTextures;
+    VkSampler textureSampler = VK_NULL_HANDLE;
 
-    uint32_t mipLevels;
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
-    VkImageView textureImageView;
-    VkSampler textureSampler;
+    // set by whoever submitted the uploads once they completed
+    bool meshResident = false;
+    bool textureResident = false;
 
     Device &device;
 
@@ -46,26 +102,80 @@ public:
     Model(Device &device);
     ~Model();
 
-    void createVertexBuffer();
-    void createIndexBuffer();
-    void createTextures(const std::string &filePath);
+    // CPU only, safe to run off the main thread as long as nothing else touches the model
     void loadModel(const std::string &filePath);
+    void loadTexture(const std::string &filePath);
+    // the two halves of loadTexture, for callers doing the file read themselves
+    bool openTextureCache(const std::string &filePath);
+    void decodeTexture(const std::string &filePath, const void* data, size_t size);
+    void setMeshletsEnabled(bool enabled) {meshletsEnabled = enabled;}
+    // before createMeshUploads, only on devices with mesh shaders
+    void setMeshletBuffersEnabled(bool enabled) {meshletBuffersEnabled = enabled;}
+    void setVertexCompression(bool enabled) {vertexCompression = enabled;}
+    // before loadTexture, anything but NONE needs textureCompressionBC on the device
+    void setTextureCompression(TextureCompression compression) {textureCompression = compression;}
+
+    // create the GPU resources and append the uploads filling them, in recording order.
+    // the resources are usable once the batches the steps went into complete.
+    // the texture starts with its mip tail only, commitTextureLevel makes it usable
+    void createMeshUploads(std::vector<UploadStep> &steps);
+    void createTextureUploads(std::vector<UploadStep> &steps);
+
+    // mip streaming : a new image with the levels from baseLevel down, filled from the cache
+    // (resident levels included, there is no image to image copy across queues), then swapped in
+    // by commitTextureLevel once its uploads completed. one at a time
+    void createTextureLevelUploads(uint32_t baseLevel, std::vector<UploadStep> &steps);
+    void commitTextureLevel();
+    // destroys the images replaced by commitTextureLevel, once nothing in flight samples them
+    void releaseRetiredTextures();
+    bool hasRetiredTextures() const {return !retiredTextures.empty();}
+    // texel bytes of the retired images
+    VkDeviceSize getRetiredTexturesSize() const;
+    bool isTextureLevelPending() const {return pendingTexture.image != VK_NULL_HANDLE;}
+    uint32_t getTextureBaseLevel() const {return texture.baseLevel;}
+    uint32_t getTextureLevelCount() const {return mipLevels;}
+    // first level of the mip tail, what is uploaded before anything else
+    uint32_t getTextureTailLevel() const;
+    uint32_t getTextureWidth() const {return texWidth;}
+    uint32_t getTextureHeight() const {return texHeight;}
+    // texel bytes of the levels from baseLevel down
+    VkDeviceSize getTextureLevelsSize(uint32_t baseLevel) const;
+    void setMeshResident() {meshResident = true;}
+    void setTextureResident() {textureResident = true;}
+    bool isMeshResident() const {return meshResident;}
+    bool isTextureResident() const {return textureResident;}
     
     VkBuffer getVertexBuffer() const {return vertexBuffer;}
     VkBuffer getIndexBuffer() const {return indexBuffer;}
-    std::vector<Vertex> getVertexData() const {return vertexData;}
-    std::vector<uint32_t> getIndices() const {return indices;}
-    VkImage getTextureImage() const {return textureImage;}
-    VkImageView getTextureImageView() const {return textureImageView;}
+    // VK_NULL_HANDLE unless meshlet buffers are enabled and the model has meshlets
+    VkBuffer getMeshletBuffer() const {return meshletBuffer;}
+    VkBuffer getMeshletVertexBuffer() const {return meshletVertexBuffer;}
+    VkBuffer getMeshletTriangleBuffer() const {return meshletTriangleBuffer;}
+    const std::vector<Vertex>& getVertexData() const {return vertexData;}
+    const std::vector<uint32_t>& getIndices() const {return indices;}
+    uint32_t getVertexCount() const {return vertexCount;}
+    uint32_t getIndexCount() const {return indexCount;}
+    VkIndexType getIndexType() const {return indexType;}
+    const VertexEncoding& getVertexEncoding() const {return vertexEncoding;}
+    const MeshBounds& getBounds() const {return bounds;}
+    const MeshletData& getMeshlets() const {return meshlets;}
+    const std::vector<MeshLod>& getLods() const {return lods;}
+    VkImage getTextureImage() const {return texture.image;}
+    VkFormat getTextureFormat() const {return textureFormat;}
+    VkImageView getTextureImageView() const {return texture.view;}
     VkSampler getTextureSampler() const {return textureSampler;}
     
-    static VkVertexInputBindingDescription getBindingDescription();
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
-    
+
 private:
     
-    void createTextureImage(const std::string &filePath);
-    void createTextureImageView();
+    const Vertex* getVertexSource() const;
+    const uint32_t* getIndexSource() const;
+    void buildMeshletData();
+    void createVertexBuffer(std::vector<UploadStep> &steps);
+    void createIndexBuffer(std::vector<UploadStep> &steps);
+    void createMeshletBuffers(std::vector<UploadStep> &steps);
+    StagingWriter getTextureSource() const;
+    void destroyTextureLevels(TextureLevels &levels);
     void createTextureSampler();
 
 };
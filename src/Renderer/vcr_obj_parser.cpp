@@ -0,0 +1,391 @@
+#include "vcr_obj_parser.hpp"
+
+#include "file_utils.hpp"
+#include "thread_utils.hpp"
+#include "vcr_vertex_dedup.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace vcr {
+
+namespace {
+
+// chunks smaller than this are not worth a thread
+constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+constexpr uint32_t MAX_SHARDS = 64;
+constexpr int32_t NO_TEXCOORD = std::numeric_limits<int32_t>::min();
+
+constexpr uint8_t RELATIVE_POSITION = 1;
+constexpr uint8_t RELATIVE_TEXCOORD = 2;
+
+struct RelativeCorner {
+    uint32_t corner;
+    uint8_t mask;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    // one entry per triangle corner, absolute zero based indices except for the
+    // corners listed in relativeCorners which are relative to the start of the chunk
+    std::vector<int32_t> positionRefs;
+    std::vector<int32_t> texCoordRefs;
+    std::vector<RelativeCorner> relativeCorners;
+    size_t positionBase = 0;
+    size_t texCoordBase = 0;
+    size_t cornerBase = 0;
+};
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+bool parseFloat(const char*& p, const char* end, float& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') p++;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+bool parseInt(const char*& p, const char* end, int32_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') return false;
+    int64_t result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        if (result > std::numeric_limits<int32_t>::max()) return false;
+        p++;
+    }
+    value = static_cast<int32_t>(negative ? -result : result);
+    return true;
+}
+
+[[noreturn]] void throwParseError(const std::string &message) {
+    throw std::runtime_error("Failed to load model: " + message);
+}
+
+// resolves an OBJ reference (1 based, or negative relative to the current count) to a zero based
+// index, returns true when the result is relative to the start of the chunk
+bool resolveReference(int32_t reference, size_t localCount, int32_t& index) {
+    if (reference > 0) {
+        index = reference - 1;
+        return false;
+    }
+    if (reference == 0) throwParseError("zero index in face");
+    index = static_cast<int32_t>(localCount) + reference;
+    return true;
+}
+
+void parseChunk(ObjChunk& chunk) {
+    struct FaceCorner {
+        int32_t position;
+        int32_t texCoord;
+        uint8_t mask;
+    };
+    std::vector<FaceCorner> face;
+
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+        if (lineEnd == nullptr) lineEnd = chunk.end;
+        p = skipBlanks(p, lineEnd);
+
+        if (lineEnd - p > 2 && p[0] == 'v' && isBlank(p[1])) {
+            p++;
+            float x, y, z;
+            if (!parseFloat(p, lineEnd, x) || !parseFloat(p, lineEnd, y) || !parseFloat(p, lineEnd, z)) {
+                throwParseError("malformed vertex position");
+            }
+            chunk.positions.push_back(x);
+            chunk.positions.push_back(y);
+            chunk.positions.push_back(z);
+        } else if (lineEnd - p > 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            p += 2;
+            float u, v;
+            if (!parseFloat(p, lineEnd, u) || !parseFloat(p, lineEnd, v)) {
+                throwParseError("malformed texture coordinate");
+            }
+            chunk.texCoords.push_back(u);
+            chunk.texCoords.push_back(v);
+        } else if (lineEnd - p > 2 && p[0] == 'f' && isBlank(p[1])) {
+            p++;
+            face.clear();
+            while (true) {
+                p = skipBlanks(p, lineEnd);
+                if (p >= lineEnd) break;
+                int32_t reference;
+                if (!parseInt(p, lineEnd, reference)) throwParseError("malformed face");
+
+                FaceCorner corner{0, NO_TEXCOORD, 0};
+                if (resolveReference(reference, chunk.positions.size() / 3, corner.position)) {
+                    corner.mask |= RELATIVE_POSITION;
+                }
+                if (p < lineEnd && *p == '/') {
+                    p++;
+                    if (p < lineEnd && *p != '/') {
+                        if (!parseInt(p, lineEnd, reference)) throwParseError("malformed face");
+                        if (resolveReference(reference, chunk.texCoords.size() / 2, corner.texCoord)) {
+                            corner.mask |= RELATIVE_TEXCOORD;
+                        }
+                    }
+                    // normals are not part of Vertex, skip the reference
+                    if (p < lineEnd && *p == '/') {
+                        p++;
+                        if (!parseInt(p, lineEnd, reference)) throwParseError("malformed face");
+                    }
+                }
+                face.push_back(corner);
+            }
+            if (face.size() < 3) throwParseError("face with less than 3 vertices");
+
+            // fan triangulation, same as tinyobj
+            for (size_t i = 1; i + 1 < face.size(); i++) {
+                for (size_t j : {size_t(0), i, i + 1}) {
+                    if (face[j].mask != 0) {
+                        chunk.relativeCorners.push_back(
+                            {static_cast<uint32_t>(chunk.positionRefs.size()), face[j].mask});
+                    }
+                    chunk.positionRefs.push_back(face[j].position);
+                    chunk.texCoordRefs.push_back(face[j].texCoord);
+                }
+            }
+        }
+        // everything else (vn, o, g, s, usemtl, comments...) is ignored
+        p = lineEnd + 1;
+    }
+}
+
+// closed triangle meshes share every position between ~6 corners, uv seams bring that down,
+// a third covers the assets without rehashing and the table grows past it anyway
+size_t estimateUniqueVertices(size_t indexCount) {
+    return indexCount / 3 + 1;
+}
+
+uint32_t shardOf(const Vertex& vertex, uint32_t shardCount) {
+    // the shard tables index with the low half of the hash, the shard comes from the high half
+    return static_cast<uint32_t>((hashVertex(vertex) >> 32) % shardCount);
+}
+
+} // namespace
+
+void parseObj(const std::string &filePath,
+              std::vector<Vertex> &vertices,
+              std::vector<uint32_t> &indices,
+              uint32_t threadCount) {
+    MappedFile file;
+    if (!file.open(filePath)) throwParseError("cannot open " + filePath);
+    if (threadCount == 0) threadCount = defaultThreadCount();
+    threadCount = std::min(threadCount, MAX_SHARDS);
+
+    // split the file at line boundaries
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.size() / MIN_CHUNK_SIZE));
+    // small files don't pay for threads they can't feed
+    threadCount = static_cast<uint32_t>(chunkCount);
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* fileEnd = file.data() + file.size();
+    const char* chunkBegin = file.data();
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = fileEnd;
+        if (i + 1 < chunkCount) {
+            chunkEnd = std::max(chunkBegin, file.data() + file.size() * (i + 1) / chunkCount);
+            const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', fileEnd - chunkEnd));
+            chunkEnd = newline != nullptr ? newline + 1 : fileEnd;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    parallelFor(chunkCount, threadCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; i++) parseChunk(chunks[i]);
+    });
+
+    // offsets of every chunk in the merged arrays
+    size_t positionCount = 0, texCoordCount = 0, cornerCount = 0;
+    for (auto &chunk : chunks) {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.cornerBase = cornerCount;
+        positionCount += chunk.positions.size() / 3;
+        texCoordCount += chunk.texCoords.size() / 2;
+        cornerCount += chunk.positionRefs.size();
+    }
+    if (cornerCount > std::numeric_limits<uint32_t>::max()) throwParseError("too many face vertices");
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    parallelFor(chunkCount, threadCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; i++) {
+            const ObjChunk& chunk = chunks[i];
+            for (size_t v = 0; v < chunk.positions.size() / 3; v++) {
+                positions[chunk.positionBase + v] = {
+                    chunk.positions[3 * v + 0], chunk.positions[3 * v + 1], chunk.positions[3 * v + 2]};
+            }
+            for (size_t t = 0; t < chunk.texCoords.size() / 2; t++) {
+                texCoords[chunk.texCoordBase + t] = {chunk.texCoords[2 * t + 0], chunk.texCoords[2 * t + 1]};
+            }
+        }
+    });
+
+    // build the vertex of every triangle corner and bucket the corners by shard,
+    // every worker keeps its buckets in corner order
+    uint32_t shardCount = threadCount;
+    std::vector<Vertex> corners(cornerCount);
+    std::vector<std::vector<std::vector<uint32_t>>> shardCorners(
+        chunkCount, std::vector<std::vector<uint32_t>>(shardCount));
+    parallelFor(chunkCount, threadCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; i++) {
+            ObjChunk& chunk = chunks[i];
+            for (const auto &relative : chunk.relativeCorners) {
+                if (relative.mask & RELATIVE_POSITION) {
+                    chunk.positionRefs[relative.corner] += static_cast<int32_t>(chunk.positionBase);
+                }
+                if (relative.mask & RELATIVE_TEXCOORD) {
+                    chunk.texCoordRefs[relative.corner] += static_cast<int32_t>(chunk.texCoordBase);
+                }
+            }
+            for (auto &bucket : shardCorners[i]) bucket.reserve(chunk.positionRefs.size() / shardCount + 1);
+
+            for (size_t c = 0; c < chunk.positionRefs.size(); c++) {
+                int32_t positionIndex = chunk.positionRefs[c];
+                int32_t texCoordIndex = chunk.texCoordRefs[c];
+                if (positionIndex < 0 || static_cast<size_t>(positionIndex) >= positionCount) {
+                    throwParseError("vertex index out of range");
+                }
+                Vertex vertex{};
+                vertex.pos = positions[positionIndex];
+                if (texCoordIndex == NO_TEXCOORD) {
+                    vertex.texCoord = {0.0f, 1.0f};
+                } else if (texCoordIndex < 0 || static_cast<size_t>(texCoordIndex) >= texCoordCount) {
+                    throwParseError("texture coordinate index out of range");
+                } else {
+                    vertex.texCoord = {texCoords[texCoordIndex].x, 1.0f - texCoords[texCoordIndex].y};
+                }
+                vertex.color = {1.0f, 1.0f, 1.0f};
+
+                uint32_t corner = static_cast<uint32_t>(chunk.cornerBase + c);
+                corners[corner] = vertex;
+                shardCorners[i][shardOf(vertex, shardCount)].push_back(corner);
+            }
+        }
+    });
+
+    // dedup : every shard owns the vertices hashing to it, walks its corners in file order
+    // and hands out local ids in order of first occurrence
+    std::vector<uint32_t> cornerLocal(cornerCount);
+    std::vector<uint32_t> shardUniqueCount(shardCount, 0);
+    parallelFor(shardCount, threadCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t shard = begin; shard < end; shard++) {
+            size_t shardSize = 0;
+            for (size_t i = 0; i < chunkCount; i++) shardSize += shardCorners[i][shard].size();
+            VertexDedupTable uniqueVertices;
+            uniqueVertices.reserve(estimateUniqueVertices(shardSize));
+
+            for (size_t i = 0; i < chunkCount; i++) {
+                for (uint32_t corner : shardCorners[i][shard]) {
+                    cornerLocal[corner] = uniqueVertices.insert(corners[corner]);
+                }
+            }
+            shardUniqueCount[shard] = static_cast<uint32_t>(uniqueVertices.size());
+        }
+    });
+
+    // global ids in order of first occurrence across all shards : a corner is the first occurrence
+    // of its vertex exactly when its local id is the next one its shard hasn't handed out yet
+    std::vector<std::vector<uint32_t>> shardToGlobal(shardCount);
+    size_t uniqueCount = 0;
+    for (uint32_t shard = 0; shard < shardCount; shard++) {
+        shardToGlobal[shard].reserve(shardUniqueCount[shard]);
+        uniqueCount += shardUniqueCount[shard];
+    }
+    std::vector<uint8_t> cornerShard(cornerCount);
+    for (size_t i = 0; i < chunkCount; i++) {
+        for (uint32_t shard = 0; shard < shardCount; shard++) {
+            for (uint32_t corner : shardCorners[i][shard]) cornerShard[corner] = static_cast<uint8_t>(shard);
+        }
+    }
+
+    vertices.clear();
+    vertices.reserve(uniqueCount);
+    for (uint32_t corner = 0; corner < cornerCount; corner++) {
+        auto &globalIds = shardToGlobal[cornerShard[corner]];
+        if (cornerLocal[corner] == globalIds.size()) {
+            globalIds.push_back(static_cast<uint32_t>(vertices.size()));
+            vertices.push_back(corners[corner]);
+        }
+    }
+
+    indices.resize(cornerCount);
+    parallelFor(cornerCount, threadCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t corner = begin; corner < end; corner++) {
+            indices[corner] = shardToGlobal[cornerShard[corner]][cornerLocal[corner]];
+        }
+    });
+}
+
+void parseObjTinyObj(const std::string &filePath,
+                     std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())) {
+        throw std::runtime_error("Failed to load model: " + warn + err);
+    }
+
+    vertices.clear();
+    indices.clear();
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+    for (const auto &shape : shapes) {
+        for (const auto &index : shape.mesh.indices) {
+            Vertex vertex{};
+
+            vertex.pos = {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2]
+            };
+
+            if (index.texcoord_index < 0) {
+                vertex.texCoord = {0.0f, 1.0f};
+            } else {
+                vertex.texCoord = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+
+            vertex.color = {1.0f, 1.0f, 1.0f};
+
+            if (uniqueVertices.count(vertex) == 0) {
+                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            indices.push_back(uniqueVertices[vertex]);
+        }
+    }
+}
+
+} // namespace vcr
@@ -0,0 +1,29 @@
+#ifndef VCR_OBJ_PARSER_HPP
+#define VCR_OBJ_PARSER_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vcr {
+
+// Multi-threaded OBJ loader : the file is split at line boundaries, every chunk parses its
+// v/vt/vn/f records on its own thread, the chunks are merged with index fixup and the vertex
+// dedup runs on hash sharded tables. The output is identical to a sequential first-occurrence
+// dedup, whatever the thread count. threadCount = 0 uses every hardware thread.
+// vertices and indices are overwritten.
+void parseObj(const std::string &filePath,
+              std::vector<Vertex> &vertices,
+              std::vector<uint32_t> &indices,
+              uint32_t threadCount = 0);
+
+// Single threaded tinyobj path, kept as the reference for benchmarks and validation
+void parseObjTinyObj(const std::string &filePath,
+                     std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices);
+
+} // namespace vcr
+
+#endif // VCR_OBJ_PARSER_HPP
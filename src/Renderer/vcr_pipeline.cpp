@@ -2,6 +2,19 @@
 
 namespace vcr {
 
+void PipelineConfig::setVertexInput(const VkVertexInputBindingDescription* bindings,
+                                    uint32_t bindingCount,
+                                    const VkVertexInputAttributeDescription* attributes,
+                                    uint32_t attributeCount) {
+    if (bindingCount > MAX_VERTEX_BINDINGS || attributeCount > MAX_VERTEX_ATTRIBUTES) {
+        throw std::runtime_error("Failed to set vertex input: too many bindings or attributes");
+    }
+    std::copy(bindings, bindings + bindingCount, vertexBindingDescriptions.begin());
+    std::copy(attributes, attributes + attributeCount, vertexAttributeDescriptions.begin());
+    vertexBindingCount = bindingCount;
+    vertexAttributeCount = attributeCount;
+}
+
 Pipeline::Pipeline(Device &device, Model& model) : device(device), model(model) {}
 
 Pipeline::~Pipeline() {
@@ -11,13 +24,15 @@ Pipeline::~Pipeline() {
     }
     vkDestroyShaderModule(device.getDevice(), vertShaderModule, nullptr);
     vkDestroyShaderModule(device.getDevice(), fragShaderModule, nullptr);
+    vkDestroyShaderModule(device.getDevice(), taskShaderModule, nullptr);
+    vkDestroyShaderModule(device.getDevice(), meshShaderModule, nullptr);
 }
 
 void Pipeline::createGraphicsPipeline(VkRenderPass& renderPass,
                                       VkDescriptorSetLayout& descriptorSetLayout,
+                                      PipelineConfig& config,
                                       const std::string& vertShaderPath,
                                       const std::string& fragShaderPath) {
-    PipelineConfig config{};
     config.setSamples(device.getMsaaSamples());
     Pipeline::defaultPipelineConfig(config);
 
@@ -27,7 +42,11 @@ void Pipeline::createGraphicsPipeline(VkRenderPass& renderPass,
 
     auto shaderStages = createShaderStages(vertShaderModule, fragShaderModule);
 
-    pipelineLayout = createPipelineLayout(device, descriptorSetLayout);
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(VertexDequantization);
+    pipelineLayout = createPipelineLayout(device, {descriptorSetLayout}, pushConstantRange);
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -51,6 +70,57 @@ void Pipeline::createGraphicsPipeline(VkRenderPass& renderPass,
     }
 }
 
+void Pipeline::createMeshPipeline(VkRenderPass& renderPass,
+                                  const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+                                  uint32_t pushConstantSize,
+                                  const std::string& taskShaderPath,
+                                  const std::string& meshShaderPath,
+                                  const std::string& fragShaderPath) {
+    PipelineConfig config{};
+    config.setSamples(device.getMsaaSamples());
+    Pipeline::defaultPipelineConfig(config);
+
+    taskShaderModule = createShaderModule(readFile(taskShaderPath));
+    meshShaderModule = createShaderModule(readFile(meshShaderPath));
+    fragShaderModule = createShaderModule(readFile(fragShaderPath));
+
+    std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages = {};
+    const VkShaderStageFlagBits stages[] = {VK_SHADER_STAGE_TASK_BIT_EXT, VK_SHADER_STAGE_MESH_BIT_EXT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    const VkShaderModule modules[] = {taskShaderModule, meshShaderModule, fragShaderModule};
+    for (size_t i = 0; i < shaderStages.size(); i++) {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].stage = stages[i];
+        shaderStages[i].module = modules[i];
+        shaderStages[i].pName = "main";
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+    pipelineLayout = createPipelineLayout(device, descriptorSetLayouts, pushConstantRange);
+
+    // the mesh shader assembles the primitives itself, there is no vertex input nor input assembly
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pViewportState = &config.viewportState;
+    pipelineInfo.pRasterizationState = &config.rasterizationState;
+    pipelineInfo.pMultisampleState = &config.multisampleState;
+    pipelineInfo.pColorBlendState = &config.colorBlendState;
+    pipelineInfo.pDynamicState = &config.dynamicState;
+    pipelineInfo.pDepthStencilState = &config.depthStencilState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    if (vkCreateGraphicsPipelines(device.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mesh pipeline!");
+    }
+}
+
 std::array<VkShaderModule, 2> Pipeline::createShaderModules(
     const std::string &vertexShaderPath,
     const std::string &fragmentShaderPath) {
@@ -102,14 +172,11 @@ void Pipeline::createDynamicState(PipelineConfig &configInfo) {
 }
 
 void Pipeline::createVertexInputState(PipelineConfig &configInfo) {
-    configInfo.vertexBindingDescription = Model::getBindingDescription();
-    configInfo.vertexAttributeDescriptions = Model::getAttributeDescriptions();
-    size_t attributeCount = configInfo.vertexAttributeDescriptions.size();
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeCount);
-    vertexInputInfo.pVertexBindingDescriptions = &configInfo.vertexBindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = configInfo.vertexBindingCount;
+    vertexInputInfo.vertexAttributeDescriptionCount = configInfo.vertexAttributeCount;
+    vertexInputInfo.pVertexBindingDescriptions = configInfo.vertexBindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = configInfo.vertexAttributeDescriptions.data();
     configInfo.vertexInputState = vertexInputInfo;
 }
@@ -190,12 +257,15 @@ void Pipeline::createDepthStencilState(PipelineConfig &configInfo) {
     configInfo.depthStencilState = depthStencilState;
 }
 
-VkPipelineLayout Pipeline::createPipelineLayout(Device& device, VkDescriptorSetLayout& descriptorSetLayout) {
+VkPipelineLayout Pipeline::createPipelineLayout(Device& device,
+                                                const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+                                                const VkPushConstantRange& pushConstantRange) {
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     VkPipelineLayout pipelineLayout;
     if (vkCreatePipelineLayout(device.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -4,14 +4,19 @@
 #include "vcr_device.hpp"
 #include "vcr_swapchain.hpp"
 #include "vcr_model.hpp"
+#include "vcr_vertex_layout.hpp"
 #include "file_utils.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <array>
+#include <algorithm>
 
 namespace vcr {
 
+constexpr uint32_t MAX_VERTEX_BINDINGS = 4;
+constexpr uint32_t MAX_VERTEX_ATTRIBUTES = 8;
+
 struct PipelineConfig {
     std::vector<VkDynamicState> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
@@ -28,10 +33,30 @@ struct PipelineConfig {
     VkPipelineColorBlendAttachmentState colorBlendAttachment;
     VkPipelineColorBlendStateCreateInfo colorBlendState;
     VkPipelineDepthStencilStateCreateInfo depthStencilState;
-    VkVertexInputBindingDescription vertexBindingDescription;
-    std::array<VkVertexInputAttributeDescription, 3> vertexAttributeDescriptions;
+    // set by the caller, with setVertexLayout or setVertexInput
+    std::array<VkVertexInputBindingDescription, MAX_VERTEX_BINDINGS> vertexBindingDescriptions;
+    std::array<VkVertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> vertexAttributeDescriptions;
+    uint32_t vertexBindingCount = 0;
+    uint32_t vertexAttributeCount = 0;
 
     void setSamples(VkSampleCountFlagBits samples) {msaaSamples = samples;}
+
+    // single binding layout reflected from VertexLayout<VertexType>
+    template <typename VertexType>
+    void setVertexLayout() {
+        static_assert(vertexAttributeCountOf<VertexType>() <= MAX_VERTEX_ATTRIBUTES, "Too many vertex attributes");
+        constexpr auto attributes = makeAttributeDescriptions<VertexType>();
+        vertexBindingDescriptions[0] = makeBindingDescription<VertexType>();
+        vertexBindingCount = 1;
+        for (size_t i = 0; i < attributes.size(); i++) vertexAttributeDescriptions[i] = attributes[i];
+        vertexAttributeCount = static_cast<uint32_t>(attributes.size());
+    }
+
+    // layouts only known at runtime, e.g. the model vertex encoding
+    void setVertexInput(const VkVertexInputBindingDescription* bindings,
+                        uint32_t bindingCount,
+                        const VkVertexInputAttributeDescription* attributes,
+                        uint32_t attributeCount);
 };
 
 class Pipeline {
@@ -40,11 +65,14 @@ private:
     Model& model;
     VkExtent2D extent;
 
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    // mesh pipelines only
+    VkShaderModule taskShaderModule = VK_NULL_HANDLE;
+    VkShaderModule meshShaderModule = VK_NULL_HANDLE;
 
-    VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline graphicsPipeline = VK_NULL_HANDLE;
 public:
     Pipeline(Device &device, Model& model);
     ~Pipeline();
@@ -54,10 +82,20 @@ public:
 
     void setExtent(const VkExtent2D &extent) {this->extent = extent;}
 
+    // config holds the vertex input, the rest of it is filled here
     void createGraphicsPipeline(VkRenderPass& renderPass,
                                 VkDescriptorSetLayout& descriptorSetLayout,
+                                PipelineConfig& config,
                                 const std::string& vertShaderPath,
                                 const std::string& fragShaderPath);
+    // task, mesh and fragment stages, no vertex input. the layout has the set layouts in order
+    // and pushConstantSize bytes for the task and mesh stages. needs VK_EXT_mesh_shader
+    void createMeshPipeline(VkRenderPass& renderPass,
+                            const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+                            uint32_t pushConstantSize,
+                            const std::string& taskShaderPath,
+                            const std::string& meshShaderPath,
+                            const std::string& fragShaderPath);
     std::array<VkShaderModule, 2> createShaderModules(
         const std::string &vertexShaderPath,
         const std::string &fragmentShaderPath);
@@ -77,7 +115,9 @@ private:
     static void createColorBlendAttachment(PipelineConfig &configInfo);
     static void createColorBlendState(PipelineConfig &configInfo);
     static void createDepthStencilState(PipelineConfig &configInfo);
-    static VkPipelineLayout createPipelineLayout(Device& device, VkDescriptorSetLayout& descriptorSetLayout);
+    static VkPipelineLayout createPipelineLayout(Device& device,
+                                                 const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+                                                 const VkPushConstantRange& pushConstantRange);
 };
 }
 
@@ -1,8 +1,13 @@
 #include "vcr_renderer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
 namespace vcr {
 
-Renderer::Renderer() {}
+Renderer::Renderer(const RendererOptions& options)
+    : options(options), window(width, height, name, options.headless) {}
 
 Renderer::~Renderer() {
     for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -13,38 +18,76 @@ Renderer::~Renderer() {
         vkDestroySemaphore(device.getDevice(), renderFinishedSemaphores[i], nullptr);
     }
     for (size_t i = 0; i < uniformBuffers.size(); i++) {
-        vkDestroyBuffer(device.getDevice(), uniformBuffers[i], nullptr);
-        vkFreeMemory(device.getDevice(), uniformBuffersMemory[i], nullptr);
+        destroyBuffer(device.getDevice(), device.getAllocator(), uniformBuffers[i], uniformBuffersAllocation[i]);
+    }
+    for (size_t i = 0; i < culledIndexBuffers.size(); i++) {
+        destroyBuffer(device.getDevice(), device.getAllocator(), culledIndexBuffers[i], culledIndexBuffersAllocation[i]);
     }
+    vkDestroySampler(device.getDevice(), placeholderSampler, nullptr);
+    vkDestroyImageView(device.getDevice(), placeholderImageView, nullptr);
+    destroyImage(device.getDevice(), device.getAllocator(), placeholderImage, placeholderImageAllocation);
     vkDestroyRenderPass(device.getDevice(), renderPass, nullptr);
     vkDestroyDescriptorPool(device.getDevice(), descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(device.getDevice(), descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device.getDevice(), meshletSetLayout, nullptr);
 }
 
 void Renderer::init() {
+    if (options.checkAllocations && !isAllocationCountingEnabled()) {
+        throw std::runtime_error("Failed to check the frame allocations, they are only counted in debug builds!");
+    }
+    if (!options.traceFile.empty()) {
+        // before the first asset request so the loads show up
+        setTraceThreadName("main");
+        setTracingEnabled(true);
+    }
+    scene = findScene(options.scene);
+    if (!scene) throw std::runtime_error("Failed to find scene " + options.scene + "!");
+    if (!options.cameraPath.empty() && options.cameraPath != "orbit" && !cameraPath.load(options.cameraPath)) {
+        throw std::runtime_error("Failed to load camera path " + options.cameraPath + "!");
+    }
     window.init();
+    device.setPreferredDevice(options.device);
     device.init();
+    useMeshShaders = options.meshShaders && device.isMeshShaderSupported() &&
+                     std::filesystem::exists(MESHLET_TASK_SHADER) && std::filesystem::exists(MESHLET_MESH_SHADER);
+    if (options.meshShaders && device.isMeshShaderSupported() && !useMeshShaders) {
+        std::cout << "Mesh shaders supported but " << MESHLET_TASK_SHADER << " or " << MESHLET_MESH_SHADER
+                  << " missing, drawing compacted index buffers" << "\n";
+    }
     swapChain.init();
     pipeline.setExtent(swapChain.getExtent());
     createRenderPass();
     createDescriptorSetLayout();
-    pipeline.createGraphicsPipeline(renderPass,
-                                    descriptorSetLayout,
-                                    "../shaders/shader.vert.spv",
-                                    "../shaders/shader.frag.spv");
+    // mesh and texture load in the background, frames are drawn with what is resident meanwhile
+    model.setMeshletsEnabled(true);
+    model.setMeshletBuffersEnabled(useMeshShaders);
+    model.setVertexCompression(options.vertexCompression);
+    // BC7 where the device samples it, a quarter of the RGBA8 memory. RGBA8 otherwise
+    model.setTextureCompression(device.isTextureCompressionBCSupported() ? TextureCompression::QUALITY
+                                                                         : TextureCompression::NONE);
+    // the texture is drawn from its mip tail first, finer levels follow the camera
+    streamer.setTextureMemoryBudget(TEXTURE_MEMORY_BUDGET);
+    streamer.requestModel(model, scene->modelPath);
+    if (scene->texturePath) streamer.requestTexture(model, scene->texturePath);
     swapChain.createColorResources();
     swapChain.createDepthResources();
     swapChain.createFramebuffers(renderPass);
     framebuffers = swapChain.getFramebuffers();
-    model.loadModel("../assets/models/viking_room.obj");
-    model.createTextures("../assets/textures/viking_room.png");
-    model.createVertexBuffer();
-    model.createIndexBuffer();
+    UploadBatch& uploads = device.getUploadContext().begin();
+    createPlaceholderTexture(uploads);
+    UploadTicket uploadTicket = device.getUploadContext().submit();
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
     createSyncObjects();
+    gpuProfiler.init(options.pipelineStatistics);
+    if (!options.traceFile.empty()) gpuProfiler.calibrate();
+    timestampFrames.assign(MAX_FRAMES_IN_FLIGHT, -1);
+    if (options.frameCount > 0) frameTimings.reserve(options.frameCount);
+    device.getUploadContext().wait(uploadTicket);
+    device.getAllocator().logStats();
 }
 
 void Renderer::run() {
@@ -64,13 +107,22 @@ void Renderer::mainLoop() {
                             glm::vec3(0.0f, 0.0f, -1.0f),
                             glm::vec3(0.0f, -1.0f, 0.0f));
     
-    while (!window.windowShouldClose()) {
+    if (options.warmUp) warmUp();
+    timingFrames = true;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    uint32_t frameCount = 0;
+    while (!window.windowShouldClose() && (options.frameCount == 0 || frameCount < options.frameCount)) {
         currentTime = std::chrono::high_resolution_clock::now();
         window.pollEvents();
+        AllocationScope frameAllocations;
         drawFrame();
+        checkFrameAllocations(frameAllocations.getCount());
         frameTime = std::chrono::duration<float, std::chrono::seconds::period>
             (std::chrono::high_resolution_clock::now() - currentTime).count();
+        if (options.frameCount > 0) frameTimings.push_back({frameTime * 1000.0, -1.0});
 
+        frameCount++;
         counter++;
         if (counter >= 500) {
             //std::cout << "Frames per second : " << 1.0f / frameTime << "\n";
@@ -78,35 +130,141 @@ void Renderer::mainLoop() {
         }
     }
     vkDeviceWaitIdle(device.getDevice());
+    for (uint32_t frame = 0; frame < timestampFrames.size(); frame++) collectFrameTimestamps(frame);
+    if (!options.recordCameraPath.empty() && !recordedCameraPath.save(options.recordCameraPath)) {
+        throw std::runtime_error("Failed to save camera path " + options.recordCameraPath + "!");
+    }
+    if (!options.traceFile.empty()) {
+        setTracingEnabled(false);
+        if (!writeChromeTrace(options.traceFile)) {
+            throw std::runtime_error("Failed to write trace " + options.traceFile + "!");
+        }
+        std::cout << "Trace written to " << options.traceFile << "\n";
+    }
+    if (options.frameCount == 0) return;
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << frameCount << " frames in " << seconds << " s, " << seconds * 1000.0 / frameCount << " ms per frame"
+              << "\n";
+    // averages of the last frames
+    for (size_t i = 0; i < gpuProfiler.getScopeCount(); i++) {
+        const GpuScopeStats& scope = gpuProfiler.getScope(i);
+        std::cout << "GPU " << scope.name << " : " << scope.averageTime << " ms";
+        if (scope.hasStatistics) {
+            std::cout << ", " << scope.statistics.vertexShaderInvocations << " vertex invocations, "
+                      << scope.statistics.clippingPrimitives << " clipped primitives, "
+                      << scope.statistics.fragmentShaderInvocations << " fragment invocations";
+        }
+        std::cout << "\n";
+    }
+    if (isAllocationCountingEnabled()) {
+        std::cout << "steady frame allocations : " << steadyFrameAllocations << "\n";
+    }
+    // a fixed frame count is a test run, fail it
+    if (steadyFrameAllocations > 0) {
+        throw std::runtime_error("Failed to keep the frame loop allocation free!");
+    }
+    if (options.checkAllocations && steadyFrameCount == 0) {
+        throw std::runtime_error("Failed to check the frame allocations, no frame was steady!");
+    }
+}
+
+void Renderer::warmUp() {
+    for (uint32_t frame = 0; !isSceneResident(); frame++) {
+        if (window.windowShouldClose()) return;
+        if (frame == WARM_UP_FRAME_LIMIT) throw std::runtime_error("Failed to load scene " + options.scene + "!");
+        window.pollEvents();
+        drawFrame();
+    }
+}
+
+bool Renderer::isSceneResident() {
+    // texture levels requested by the first frames count too
+    return meshReady && (!scene->texturePath || model.isTextureResident()) && streamer.isIdle();
+}
+
+void Renderer::updateCamera() {
+    if (options.cameraPath.empty()) {
+        cameraController.processInput(frameTime);
+        if (!options.recordCameraPath.empty()) {
+            // the path grows, such a frame is not a steady one
+            recordedCameraPath.addKey(recordedTime, camera);
+            recordedTime += frameTime;
+            steadyFrame = false;
+        }
+        return;
+    }
+    if (cameraPath.empty() && meshReady) {
+        // sized on the scene, known once the mesh is loaded
+        const MeshBounds& bounds = model.getBounds();
+        cameraPath = CameraPath::orbit((bounds.min + bounds.max) * 0.5f, 2.0f * getBoundingRadius(), CAMERA_ORBIT_DURATION);
+    }
+    cameraPath.apply(static_cast<float>(cameraPathFrame) * CAMERA_PATH_STEP, camera);
+    if (timingFrames) cameraPathFrame++;
+}
+
+void Renderer::collectFrameTimestamps(uint32_t frame) {
+    // the fence of the frame signaled, the results are there without waiting
+    if (gpuProfiler.collect(frame) && timestampFrames[frame] >= 0) {
+        frameTimings[timestampFrames[frame]].gpuTime = gpuProfiler.getFrameTime();
+    }
+    timestampFrames[frame] = -1;
 }
 
 void Renderer::updateUniformBuffer(uint32_t currentImage) {
+    TraceScope trace{"updateUniformBuffer"};
 
-    cameraController.processInput(frameTime);
+    updateCamera();
 
     //ubo.model = glm::rotate(ubo.model, glm::radians(45.0f) * frameTime , glm::vec3(0.0f, 0.0f, 1.0f));
     ubo.view = camera.getViewMatrix();
     ubo.proj = camera.getProjectionMatrix();
+    // cull in model space so the meshlet bounds are used as stored
+    ubo.frustum = Frustum::fromMatrix(ubo.proj * ubo.view * ubo.model);
+    ubo.eye = glm::vec4(getModelSpaceEye(), 1.0f);
     memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
 
+void Renderer::checkFrameAllocations(uint64_t allocations) {
+    // a request or a completion during the frame leaves the streamer busy
+    if (!steadyFrame || !streamer.isIdle()) return;
+    steadyFrameCount++;
+    if (allocations == 0) return;
+    if (steadyFrameAllocations == 0) {
+        std::cerr << "Steady frame allocated " << allocations << " times on the render thread, "
+                  << "later ones are only counted" << "\n";
+    }
+    steadyFrameAllocations += allocations;
+}
+
 void Renderer::drawFrame() {
-    vkWaitForFences(device.getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    TraceScope trace{"drawFrame"};
+    steadyFrame = streamer.isIdle();
+    {
+        TraceScope waitTrace{"vkWaitForFences"};
+        vkWaitForFences(device.getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    collectFrameTimestamps(currentFrame);
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device.getDevice(),
-                                            swapChain.getSwapChain(),
-                                            UINT64_MAX,
-                                            imageAvailableSemaphores[currentFrame],
-                                            VK_NULL_HANDLE,
-                                            &imageIndex);
+    VkResult result;
+    {
+        TraceScope acquireTrace{"vkAcquireNextImageKHR"};
+        result = swapChain.acquireNextImage(imageAvailableSemaphores[currentFrame], &imageIndex);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         std::cout << "Swap chain out of date, recreating..." << std::endl;
+        steadyFrame = false;
         swapChain.recreateSwapChain(renderPass);
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         throw std::runtime_error("Failed to acquire swap chain image!");
     }
+    // the fence of this frame was waited on, its descriptor set can be rewritten
+    updateStreaming();
     updateUniformBuffer(currentFrame);
+    selectLod();
+    selectTextureLevel();
+    updateCulledIndices(currentFrame);
     vkResetFences(device.getDevice(), 1, &inFlightFences[currentFrame]);
     vkResetCommandBuffer(commandBuffers[currentFrame], 0);
     recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
@@ -119,30 +277,34 @@ void Renderer::drawFrame() {
     // (the stage we wait on is the color attachment output stage)
     // meaning we already start doing everything until this bit
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    // headless images are free once the fence of their last frame signaled, no semaphore in between
+    uint32_t semaphoreCount = swapChain.isHeadless() ? 0 : 1;
+    submitInfo.waitSemaphoreCount = semaphoreCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = semaphoreCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
-    if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command buffer!");
-    }
-    VkSwapchainKHR swapChains[] = {swapChain.getSwapChain()};
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
-    result = vkQueuePresentKHR(device.getPresentQueue(), &presentInfo);
+    {
+        TraceScope submitTrace{"vkQueueSubmit"};
+        if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit draw command buffer!");
+        }
+    }
+    // the loop adds the frame to frameTimings right after
+    bool timed = timingFrames && options.frameCount > 0;
+    timestampFrames[currentFrame] = timed ? static_cast<int64_t>(frameTimings.size()) : -1;
+    {
+        TraceScope presentTrace{"vkQueuePresentKHR"};
+        result = swapChain.present(renderFinishedSemaphores[imageIndex], imageIndex);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR ||
         result == VK_SUBOPTIMAL_KHR ||
         window.isFramebufferResized()) {
         window.setFramebufferResized(false);
+        steadyFrame = false;
         swapChain.recreateSwapChain(renderPass);
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swap chain image!");
@@ -151,11 +313,13 @@ void Renderer::drawFrame() {
 }
 
 void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    TraceScope trace{"recordCommandBuffer"};
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
+    gpuProfiler.beginFrame(commandBuffer, currentFrame);
 
     std::array<VkClearValue, 2> clearValues{};
     clearValues[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
@@ -168,15 +332,11 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image
     renderPassInfo.renderArea.extent = swapChain.getExtent();
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
+    // the MSAA resolve happens at the end of the subpass, it is part of this scope
+    uint32_t renderPassScope = gpuProfiler.beginScope(commandBuffer, "render pass");
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.getGraphicsPipeline());
-
-        VkBuffer vertexBuffers[] = {model.getVertexBuffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, model.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-        
+    // nothing to draw until the mesh is resident, the pass still clears
+    if (meshReady) {
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -191,70 +351,268 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image
         scissor.extent = swapChain.getExtent();
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        vkCmdBindDescriptorSets(commandBuffer,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipeline.getPipelineLayout(),
-                                0,
-                                1,
-                                &descriptorSets[currentFrame],
-                                0,
-                                nullptr);
-
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(model.getIndices().size()), 1, 0, 0, 0);
+        if (meshShaderDraw && currentLod == 0) recordMeshletDraw(commandBuffer);
+        else recordIndexedDraw(commandBuffer);
+    }
     vkCmdEndRenderPass(commandBuffer);
+    gpuProfiler.endScope(commandBuffer, renderPassScope);
+    gpuProfiler.endFrame(commandBuffer);
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to record command buffer!");
     }
 }
 
-VkCommandBuffer Renderer::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = device.getCommandPool();
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
+// the task shader culls the meshlets of LOD 0, one task workgroup per MESHLET_TASK_GROUP_SIZE of them
+void Renderer::recordMeshletDraw(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline.getGraphicsPipeline());
+    std::array<VkDescriptorSet, 2> sets = {descriptorSets[currentFrame], meshletSet};
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            meshPipeline.getPipelineLayout(),
+                            0,
+                            static_cast<uint32_t>(sets.size()),
+                            sets.data(),
+                            0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer,
+                       meshPipeline.getPipelineLayout(),
+                       VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+                       0,
+                       sizeof(MeshletConstants),
+                       &meshletConstants);
+
+    uint32_t groupCount = (meshletConstants.meshletCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE;
+    GpuScope drawScope{gpuProfiler, commandBuffer, "draw", true};
+    device.cmdDrawMeshTasks(commandBuffer, groupCount);
 }
 
-void Renderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(device.getGraphicsQueue());
+void Renderer::recordIndexedDraw(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.getGraphicsPipeline());
+
+    // a constant color lives at the end of the vertex buffer and is bound as a second stream
+    const VertexEncoding& vertexEncoding = model.getVertexEncoding();
+    VkBuffer vertexBuffers[] = {model.getVertexBuffer(), model.getVertexBuffer()};
+    VkDeviceSize offsets[] = {0, vertexEncoding.getConstantOffset(model.getVertexCount())};
+    vkCmdBindVertexBuffers(commandBuffer, 0, vertexEncoding.getBindingCount(), vertexBuffers, offsets);
+    vkCmdPushConstants(commandBuffer,
+                       pipeline.getPipelineLayout(),
+                       VK_SHADER_STAGE_VERTEX_BIT,
+                       0,
+                       sizeof(VertexDequantization),
+                       &vertexEncoding.dequantization);
+    // meshlet culling only covers the full mesh, the coarser levels are drawn whole
+    const MeshLod& lod = model.getLods()[currentLod];
+    uint32_t indexCount = lod.indexCount;
+    uint32_t firstIndex = lod.indexOffset;
+    if (currentLod == 0 && !culledIndexBuffers.empty()) {
+        vkCmdBindIndexBuffer(commandBuffer, culledIndexBuffers[currentFrame], 0, model.getIndexType());
+        indexCount = culledIndexCount;
+        firstIndex = 0;
+    } else {
+        vkCmdBindIndexBuffer(commandBuffer, model.getIndexBuffer(), 0, model.getIndexType());
+    }
 
-    vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline.getPipelineLayout(),
+                            0,
+                            1,
+                            &descriptorSets[currentFrame],
+                            0,
+                            nullptr);
+
+    GpuScope drawScope{gpuProfiler, commandBuffer, "draw", true};
+    vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, 0, 0);
 }
 
 void Renderer::createUniformBuffers() {
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
     uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    uniformBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
     uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         createBuffer(device.getDevice(),
-                     device.getPhysicalDevice(),
+                     device.getAllocator(),
                      bufferSize,
                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                      uniformBuffers[i],
-                     uniformBuffersMemory[i]);
-        vkMapMemory(device.getDevice(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+                     uniformBuffersAllocation[i]);
+        uniformBuffersMapped[i] = uniformBuffersAllocation[i].mapped;
+    }
+}
+
+void Renderer::createCulledIndexBuffers() {
+    if (model.getMeshlets().empty()) return;
+    // worst case every meshlet of LOD 0 is visible
+    VkDeviceSize bufferSize = getIndexSize(model.getIndexType()) * model.getLods()[0].indexCount;
+    culledIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    culledIndexBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+    culledIndexBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    visibleMeshlets.reserve(model.getMeshlets().size());
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(device.getDevice(),
+                     device.getAllocator(),
+                     bufferSize,
+                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     culledIndexBuffers[i],
+                     culledIndexBuffersAllocation[i]);
+        culledIndexBuffersMapped[i] = culledIndexBuffersAllocation[i].mapped;
+    }
+}
+
+glm::vec3 Renderer::getModelSpaceEye() const {
+    return glm::vec3(glm::inverse(ubo.view * ubo.model)[3]);
+}
+
+float Renderer::getBoundingRadius() const {
+    const MeshBounds& bounds = model.getBounds();
+    glm::vec3 extent = bounds.max - bounds.min;
+    return std::sqrt(glm::dot(extent, extent)) * 0.5f;
+}
+
+float Renderer::getPixelsPerUnit() const {
+    const MeshBounds& bounds = model.getBounds();
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 toCenter = center - getModelSpaceEye();
+    // nearest point of the bounding sphere, 0 when the camera is inside it
+    float distance = std::sqrt(glm::dot(toCenter, toCenter)) - getBoundingRadius();
+    if (distance <= 0.0f) return 0.0f;
+    // proj[1][1] is cot(fov / 2), negative because of the Y flip
+    return std::fabs(ubo.proj[1][1]) * 0.5f * static_cast<float>(swapChain.getExtent().height) / distance;
+}
+
+void Renderer::selectLod() {
+    currentLod = 0;
+    // a worker may still be filling the model
+    if (!meshReady) return;
+    const std::vector<MeshLod>& lods = model.getLods();
+    if (lods.size() <= 1) return;
+
+    // the full mesh when the camera is inside the bounding sphere
+    float pixelsPerUnit = getPixelsPerUnit();
+    if (pixelsPerUnit <= 0.0f) return;
+    for (size_t i = lods.size() - 1; i > 0; i--) {
+        if (lods[i].error * pixelsPerUnit <= LOD_PIXEL_ERROR) {
+            currentLod = static_cast<uint32_t>(i);
+            return;
+        }
+    }
+}
+
+void Renderer::selectTextureLevel() {
+    if (!meshReady || !model.isTextureResident()) return;
+    // the texture is taken to span the object once, its level 0 then covers the bounding sphere diameter
+    uint32_t level = 0;
+    float pixelsPerUnit = getPixelsPerUnit();
+    if (pixelsPerUnit > 0.0f) {
+        float texels = static_cast<float>(std::max(model.getTextureWidth(), model.getTextureHeight()));
+        float pixels = 2.0f * getBoundingRadius() * pixelsPerUnit;
+        level = static_cast<uint32_t>(std::max(0.0f, std::floor(std::log2(texels / pixels))));
+    }
+    // finer levels as soon as they are needed, coarser ones two levels late so a camera
+    // hovering at a boundary does not stream the same level in and out
+    uint32_t baseLevel = model.getTextureBaseLevel();
+    if (level < baseLevel || level >= baseLevel + 2) streamer.requestTextureLevel(model, level);
+}
+
+void Renderer::updateCulledIndices(uint32_t currentImage) {
+    if (culledIndexBuffers.empty() || currentLod != 0) return;
+    const MeshletData& meshlets = model.getMeshlets();
+    cullMeshlets(meshlets, ubo.frustum, glm::vec3(ubo.eye), visibleMeshlets);
+    size_t written = writeMeshletIndices(meshlets, visibleMeshlets, model.getIndexType(), culledIndexBuffersMapped[currentImage]);
+    culledIndexCount = static_cast<uint32_t>(written);
+}
+
+void Renderer::updateStreaming() {
+    TraceScope trace{"updateStreaming"};
+    streamer.update(STREAMING_BUDGET);
+    if (model.isMeshResident() && !meshReady) {
+        // the vertex input state of the pipeline follows the encoding picked for the model
+        PipelineConfig config{};
+        const VertexEncoding& vertexEncoding = model.getVertexEncoding();
+        if (vertexEncoding.isUnencoded()) {
+            // the Vertex array as is, its layout reflected at compile time
+            config.setVertexLayout<Vertex>();
+        } else {
+            auto bindingDescriptions = vertexEncoding.getBindingDescriptions();
+            auto attributeDescriptions = vertexEncoding.getAttributeDescriptions();
+            config.setVertexInput(bindingDescriptions.data(),
+                                  vertexEncoding.getBindingCount(),
+                                  attributeDescriptions.data(),
+                                  static_cast<uint32_t>(attributeDescriptions.size()));
+        }
+        pipeline.createGraphicsPipeline(renderPass,
+                                        descriptorSetLayout,
+                                        config,
+                                        "../shaders/shader_quantized.vert.spv",
+                                        "../shaders/shader.frag.spv");
+        // the task shader culls on the GPU, the CPU culling only feeds the fallback
+        if (useMeshShaders && model.getMeshletBuffer() != VK_NULL_HANDLE) createMeshPipeline();
+        else createCulledIndexBuffers();
+        meshReady = true;
+        device.getAllocator().logStats();
+    }
+    if (model.isTextureResident() && boundTextureViews[currentFrame] != model.getTextureImageView()) {
+        writeTextureDescriptor(currentFrame, model.getTextureImageView(), model.getTextureSampler());
+    }
+    // a set is only rewritten after the fence of its frame, once all of them moved on
+    // no frame in flight samples the replaced mips anymore
+    if (model.hasRetiredTextures() &&
+        std::all_of(boundTextureViews.begin(), boundTextureViews.end(),
+                    [this](VkImageView view) {return view == model.getTextureImageView();})) {
+        streamer.releaseRetiredTextures(model);
+    }
+}
+
+void Renderer::createPlaceholderTexture(UploadBatch& batch) {
+    createImage(device.getDevice(),
+                device.getAllocator(),
+                1,
+                1,
+                1,
+                VK_FORMAT_R8G8B8A8_SRGB,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                placeholderImage,
+                placeholderImageAllocation);
+    placeholderImageView = createImageView(device.getDevice(),
+                                           placeholderImage,
+                                           VK_FORMAT_R8G8B8A8_SRGB,
+                                           VK_IMAGE_ASPECT_COLOR_BIT,
+                                           1);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    if (vkCreateSampler(device.getDevice(), &samplerInfo, nullptr, &placeholderSampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create placeholder sampler!");
     }
+
+    const uint8_t grey[4] = {128, 128, 128, 255};
+    batch.transitionImageLayout(placeholderImage,
+                                VK_FORMAT_R8G8B8A8_SRGB,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                1);
+    batch.uploadImage(placeholderImage, 1, 1, sizeof(grey), grey);
+    batch.releaseImage(placeholderImage,
+                       1,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_ACCESS_SHADER_READ_BIT);
 }
 
 void Renderer::createDescriptorSetLayout() {
@@ -263,6 +621,7 @@ void Renderer::createDescriptorSetLayout() {
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    if (useMeshShaders) uboLayoutBinding.stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
     VkDescriptorSetLayoutBinding samplerLayoutBinding{};
@@ -282,20 +641,40 @@ void Renderer::createDescriptorSetLayout() {
     if (vkCreateDescriptorSetLayout(device.getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout!");
     }
+    if (!useMeshShaders) return;
+
+    // meshlets, meshlet vertices, meshlet triangles and the vertex buffer
+    std::array<VkDescriptorSetLayoutBinding, 4> meshletBindings{};
+    for (uint32_t i = 0; i < meshletBindings.size(); i++) {
+        meshletBindings[i].binding = i;
+        meshletBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        meshletBindings[i].descriptorCount = 1;
+        meshletBindings[i].stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+    meshletBindings[0].stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT;
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(meshletBindings.size());
+    layoutInfo.pBindings = meshletBindings.data();
+    if (vkCreateDescriptorSetLayout(device.getDevice(), &layoutInfo, nullptr, &meshletSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create meshlet descriptor set layout!");
+    }
 }
 
 void Renderer::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    // the meshlet set is one more, with its 4 storage buffers
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = 4;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.poolSizeCount = static_cast<uint32_t>(useMeshShaders ? poolSizes.size() : 2);
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) + (useMeshShaders ? 1 : 0);
 
     if (vkCreateDescriptorPool(device.getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor pool!");
@@ -321,34 +700,101 @@ void Renderer::createDescriptorSets() {
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(UniformBufferObject);
 
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = model.getTextureImageView();
-        imageInfo.sampler = model.getTextureSampler();
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
 
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device.getDevice(), 1, &descriptorWrite, 0, nullptr);
+    }
 
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
+    boundTextureViews.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT); i++) {
+        writeTextureDescriptor(i, placeholderImageView, placeholderSampler);
+    }
+}
+
+// no frame has used the set yet, it is written once
+void Renderer::createMeshletDescriptorSet() {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &meshletSetLayout;
+    if (vkAllocateDescriptorSets(device.getDevice(), &allocInfo, &meshletSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate meshlet descriptor set!");
+    }
 
-        vkUpdateDescriptorSets(device.getDevice(),
-                               static_cast<uint32_t>(descriptorWrites.size()), 
-                               descriptorWrites.data(),
-                               0,
-                               nullptr);
+    std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0].buffer = model.getMeshletBuffer();
+    bufferInfos[1].buffer = model.getMeshletVertexBuffer();
+    bufferInfos[2].buffer = model.getMeshletTriangleBuffer();
+    bufferInfos[3].buffer = model.getVertexBuffer();
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = meshletSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
     }
+    vkUpdateDescriptorSets(device.getDevice(),
+                           static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(),
+                           0,
+                           nullptr);
+}
+
+void Renderer::createMeshPipeline() {
+    createMeshletDescriptorSet();
+    meshPipeline.createMeshPipeline(renderPass,
+                                    {descriptorSetLayout, meshletSetLayout},
+                                    sizeof(MeshletConstants),
+                                    MESHLET_TASK_SHADER,
+                                    MESHLET_MESH_SHADER,
+                                    "../shaders/shader.frag.spv");
+
+    const VertexEncoding& vertexEncoding = model.getVertexEncoding();
+    meshletConstants.dequantization = vertexEncoding.dequantization;
+    meshletConstants.vertexStride = vertexEncoding.stride;
+    meshletConstants.positionAttributeOffset = vertexEncoding.positionOffset;
+    meshletConstants.colorAttributeOffset = vertexEncoding.colorOffset;
+    meshletConstants.texCoordAttributeOffset = vertexEncoding.texCoordOffset;
+    meshletConstants.constantColorOffset = static_cast<uint32_t>(vertexEncoding.getConstantOffset(model.getVertexCount()));
+    meshletConstants.positionEncoding = static_cast<uint32_t>(vertexEncoding.position);
+    meshletConstants.texCoordEncoding = static_cast<uint32_t>(vertexEncoding.texCoord);
+    meshletConstants.colorEncoding = static_cast<uint32_t>(vertexEncoding.color);
+    meshletConstants.meshletCount = static_cast<uint32_t>(model.getMeshlets().size());
+    meshShaderDraw = true;
+    std::cout << "Drawing " << meshletConstants.meshletCount << " meshlets with task and mesh shaders" << "\n";
+}
+
+// the set must not be in use by a pending frame
+void Renderer::writeTextureDescriptor(uint32_t frame, VkImageView imageView, VkSampler sampler) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = imageView;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSets[frame];
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device.getDevice(), 1, &descriptorWrite, 0, nullptr);
+    boundTextureViews[frame] = imageView;
 }
 
 void Renderer::createRenderPass() {
@@ -380,7 +826,7 @@ void Renderer::createRenderPass() {
     colorAttachementResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachementResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachementResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachementResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachementResolve.finalLayout = swapChain.getFinalLayout();
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -6,6 +6,12 @@
 #include "vcr_swapchain.hpp"
 #include "vcr_pipeline.hpp"
 #include "vcr_camera.hpp"
+#include "vcr_camera_path.hpp"
+#include "vcr_scene.hpp"
+#include "vcr_asset_streamer.hpp"
+#include "vcr_gpu_profiler.hpp"
+#include "vcr_trace.hpp"
+#include "vcr_allocation_counter.hpp"
 #include "keyboard_movement_controller.hpp"
 
 #include <glm/glm.hpp>
@@ -19,67 +25,213 @@ const std::string name = "test App";
 
 namespace vcr {
 
+struct RendererOptions {
+    // no window, frames go to offscreen images. for the machines without a display or a GPU
+    bool headless = false;
+    // run returns after this many frames, 0 keeps going until the window is closed
+    uint32_t frameCount = 0;
+    // see Device::setPreferredDevice
+    std::string device;
+    // one of SCENES
+    std::string scene = "viking_room";
+    // a CameraPath file replayed instead of the keyboard, "orbit" goes around the scene bounds
+    std::string cameraPath;
+    // the keyboard driven camera is saved there as a CameraPath when run returns
+    std::string recordCameraPath;
+    // the frameCount frames only start once the scene is resident and nothing streams anymore
+    bool warmUp = false;
+    // quantised vertex streams, off draws the full precision Vertex array to compare against
+    bool vertexCompression = true;
+    // the full mesh goes through task and mesh shaders where the device has VK_EXT_mesh_shader,
+    // off draws the compacted index buffers of the CPU culling everywhere
+    bool meshShaders = true;
+    // vertex and fragment invocations and clipped primitives of the draws, see GpuProfiler
+    bool pipelineStatistics = false;
+    // CPU scopes, and the GPU profiler scopes on the same clock, written there as a Chrome trace when run returns
+    std::string traceFile;
+    // --check-allocations, the steady_frame_allocations test. with a frameCount the steady frames have to be
+    // allocation free, fails without allocation counting (release builds) or when no frame was steady,
+    // rather than passing without having checked anything
+    bool checkAllocations = false;
+};
+
+// of one of the frameCount frames, in milliseconds
+struct FrameTiming {
+    // the whole loop iteration on the CPU
+    double cpuTime;
+    // from the first to the last command of the frame, negative when the queue has no timestamps
+    double gpuTime;
+};
+
 struct UniformBufferObject {
     glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view;
     glm::mat4 proj;
+    // model space, for the meshlet culling of the task shader
+    Frustum frustum{};
+    glm::vec4 eye{0.0f};
 };
 
+// Push constants of the mesh shader path, the vertex buffer is read as storage and decoded
+// with the model vertex encoding. Must match shaders/meshlet.task and shaders/meshlet.mesh
+struct MeshletConstants {
+    VertexDequantization dequantization;
+    uint32_t vertexStride;
+    uint32_t positionAttributeOffset;
+    uint32_t colorAttributeOffset;
+    uint32_t texCoordAttributeOffset;
+    uint32_t constantColorOffset;
+    uint32_t positionEncoding;
+    uint32_t texCoordEncoding;
+    uint32_t colorEncoding;
+    uint32_t meshletCount;
+};
+static_assert(sizeof(MeshletConstants) <= 128, "MeshletConstants past the push constant size every device has");
+
 class Renderer {
 private:
+    RendererOptions options;
     std::chrono::high_resolution_clock::time_point currentTime;
     float frameTime = 0.0f;
 
     UniformBufferObject ubo;
 
     const int MAX_FRAMES_IN_FLIGHT = 2;
+    // how far, in pixels, the drawn LOD may stray from the full mesh on screen
+    const float LOD_PIXEL_ERROR = 1.0f;
+    // upload share of a frame while assets stream in
+    const StreamingBudget STREAMING_BUDGET{8ull * 1024 * 1024, std::chrono::microseconds(2000)};
+    // GPU memory the texture mips may take, coarser levels are streamed in past it
+    const VkDeviceSize TEXTURE_MEMORY_BUDGET = 64ull * 1024 * 1024;
+    // simulated time between two frames of a camera path, whatever the real frame time
+    const float CAMERA_PATH_STEP = 1.0f / 60.0f;
+    // a scene still not resident after that many warm up frames failed to load
+    const uint32_t WARM_UP_FRAME_LIMIT = 100000;
+    // one turn of the "orbit" camera path, in simulated seconds
+    const float CAMERA_ORBIT_DURATION = 10.0f;
+    // only there when the build found a glslc, see compile.sh
+    const std::string MESHLET_TASK_SHADER = "../shaders/meshlet.task.spv";
+    const std::string MESHLET_MESH_SHADER = "../shaders/meshlet.mesh.spv";
+
+    const SceneDescription* scene = nullptr;
+    CameraPath cameraPath;
+    // frames into cameraPath, warm up frames stay on its first pose
+    uint32_t cameraPathFrame = 0;
+    CameraPath recordedCameraPath;
+    float recordedTime = 0.0f;
+
+    // frames of a fixed frame count run, reserved up front
+    std::vector<FrameTiming> frameTimings;
+    // the frames are counted, past the warm up
+    bool timingFrames = false;
+    // frameTimings entry each frame in flight measures, -1 when none
+    std::vector<int64_t> timestampFrames;
 
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
+    // the meshlet storage buffers of the mesh shader path, set 1, written once the mesh is resident
+    VkDescriptorSetLayout meshletSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet meshletSet = VK_NULL_HANDLE;
+    // image view each descriptor set samples, the placeholder until the model texture is resident
+    std::vector<VkImageView> boundTextureViews;
+
+    // 1x1 grey texture drawn while the model texture streams in
+    VkImage placeholderImage = VK_NULL_HANDLE;
+    Allocation placeholderImageAllocation;
+    VkImageView placeholderImageView = VK_NULL_HANDLE;
+    VkSampler placeholderSampler = VK_NULL_HANDLE;
 
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<Allocation> uniformBuffersAllocation;
     std::vector<void*> uniformBuffersMapped;
 
+    // index buffers holding only the meshlets that survive culling, rewritten every frame
+    std::vector<VkBuffer> culledIndexBuffers;
+    std::vector<Allocation> culledIndexBuffersAllocation;
+    std::vector<void*> culledIndexBuffersMapped;
+    std::vector<uint32_t> visibleMeshlets;
+    uint32_t culledIndexCount = 0;
+    uint32_t currentLod = 0;
+    // picked in init : mesh shaders asked for, supported and compiled. the coarser LODs still use pipeline
+    bool useMeshShaders = false;
+    // the full mesh goes through meshPipeline, once it is created
+    bool meshShaderDraw = false;
+    MeshletConstants meshletConstants{};
+    // the pipeline and the culled index buffers depend on the mesh, created once it is resident
+    bool meshReady = false;
+
     VkRenderPass renderPass;
     std::vector<VkFramebuffer> framebuffers;
     std::vector<VkCommandBuffer> commandBuffers;
 
     uint32_t currentFrame = 0;
+    // nothing streamed and the swap chain stayed, the frame loop must not allocate then
+    bool steadyFrame = false;
+    // heap allocations of the render thread during steady frames, only counted in debug builds
+    uint64_t steadyFrameAllocations = 0;
+    uint64_t steadyFrameCount = 0;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
 
-    Window window{width, height, name};
+    Window window;
     Device device{window};
+    GpuProfiler gpuProfiler{device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT)};
     SwapChain swapChain{device, window};
     Model model{device};
     Pipeline pipeline{device, model};
+    Pipeline meshPipeline{device, model};
     Camera camera;
     KeyboardMovementController cameraController{window, camera};
+    // after the model, the workers must be gone before it is destroyed
+    AssetStreamer streamer{device};
 public:
-    Renderer();
+    Renderer(const RendererOptions& options = {});
     ~Renderer();
 
     void init();
     void run();
+    uint64_t getSteadyFrameAllocations() const {return steadyFrameAllocations;}
+    const std::vector<FrameTiming>& getFrameTimings() const {return frameTimings;}
+    std::string getDeviceName() const {return device.getDeviceName();}
+    VkExtent2D getExtent() const {return swapChain.getExtent();}
+    const GpuProfiler& getGpuProfiler() const {return gpuProfiler;}
+    // the full mesh went through the task and mesh shaders
+    bool isMeshShaderDraw() const {return meshShaderDraw;}
 private:
     void mainLoop();
     void drawFrame();
+    void warmUp();
+    bool isSceneResident();
+    void updateCamera();
+    void collectFrameTimestamps(uint32_t frame);
+    void checkFrameAllocations(uint64_t allocations);
 
     void createRenderPass();
     void createCommandBuffers();
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordMeshletDraw(VkCommandBuffer commandBuffer);
+    void recordIndexedDraw(VkCommandBuffer commandBuffer);
     void createSyncObjects();
     void createDescriptorSetLayout();
     void createDescriptorPool();
     void createDescriptorSets();
+    void createMeshletDescriptorSet();
+    void createMeshPipeline();
+    void writeTextureDescriptor(uint32_t frame, VkImageView imageView, VkSampler sampler);
+    void createPlaceholderTexture(UploadBatch& batch);
+    void updateStreaming();
     void createUniformBuffers();
     void updateUniformBuffer(uint32_t currentImage);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    void selectLod();
+    void selectTextureLevel();
+    float getBoundingRadius() const;
+    float getPixelsPerUnit() const;
+    glm::vec3 getModelSpaceEye() const;
+    void createCulledIndexBuffers();
+    void updateCulledIndices(uint32_t currentImage);
 };
 
 }
@@ -0,0 +1,35 @@
+#ifndef VCR_SCENE_HPP
+#define VCR_SCENE_HPP
+
+#include <string>
+
+namespace vcr {
+
+// what the renderer loads, by name so benchmark runs can be reproduced and compared.
+// paths are relative to the build directory, like everywhere else
+struct SceneDescription {
+    const char* name;
+    const char* modelPath;
+    // nullptr draws the placeholder texture
+    const char* texturePath;
+};
+
+inline constexpr SceneDescription SCENES[] = {
+    {"viking_room", "../assets/models/viking_room.obj", "../assets/textures/viking_room.png"},
+    {"bunny", "../assets/models/bunny.obj", nullptr},
+    {"teapot", "../assets/models/teapot.obj", nullptr},
+    {"elephant", "../assets/models/elephant.obj", nullptr},
+    {"smooth_vase", "../assets/models/smooth_vase.obj", nullptr},
+};
+
+// nullptr when there is no such scene
+inline const SceneDescription* findScene(const std::string& name) {
+    for (const auto& scene : SCENES) {
+        if (name == scene.name) return &scene;
+    }
+    return nullptr;
+}
+
+} // namespace vcr
+
+#endif // VCR_SCENE_HPP
@@ -0,0 +1,66 @@
+#include "vcr_staging_ring.hpp"
+
+#include "vk_utils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vcr {
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void StagingRing::init(VkDevice device, MemoryAllocator& allocator, VkDeviceSize capacity) {
+    this->device = device;
+    this->allocator = &allocator;
+    this->capacity = capacity;
+    head = tail = 0;
+    // lives as long as the device, no reason to hold a block of the shared pool
+    createBuffer(device,
+                 allocator,
+                 capacity,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer,
+                 allocation,
+                 true);
+    if (!allocation.mapped) {
+        throw std::runtime_error("Failed to map staging ring!");
+    }
+}
+
+void StagingRing::destroy() {
+    if (buffer == VK_NULL_HANDLE) return;
+    destroyBuffer(device, *allocator, buffer, allocation);
+    head = tail = 0;
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    if (size > capacity) return false;
+    if (head == tail) {
+        // nothing in use, restart at the beginning of the buffer so the whole capacity is available
+        head = tail = alignUp(head, capacity);
+    }
+    uint64_t position = alignUp(head, alignment);
+    uint64_t bufferOffset = position % capacity;
+    if (bufferOffset + size > capacity) {
+        // the end of the buffer is skipped, it is released along with the region
+        position += capacity - bufferOffset;
+        bufferOffset = 0;
+    }
+    if (position + size - tail > capacity) return false;
+    head = position + size;
+    offset = bufferOffset;
+    return true;
+}
+
+void StagingRing::release(uint64_t position) {
+    tail = std::min(std::max(tail, position), head);
+}
+
+} // namespace vcr
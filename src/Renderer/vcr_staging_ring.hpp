@@ -0,0 +1,52 @@
+#ifndef VCR_STAGING_RING_HPP
+#define VCR_STAGING_RING_HPP
+
+#include "vcr_memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace vcr {
+
+constexpr VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+// covers the texel / block size of every format we upload and optimalBufferCopyOffsetAlignment in practice
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// One persistently mapped host visible buffer handed out front to back.
+// Positions only grow, position % capacity is the offset in the buffer : a region
+// never wraps around the end, and the space before tail is free again
+class StagingRing {
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+    VkDeviceSize capacity = 0;
+    uint64_t head = 0;
+    uint64_t tail = 0;
+
+public:
+    StagingRing() = default;
+    ~StagingRing() = default;
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    void init(VkDevice device, MemoryAllocator& allocator, VkDeviceSize capacity = STAGING_RING_SIZE);
+    void destroy();
+
+    // false when the region doesn't fit before the space still in use, alignment must divide the capacity
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    // everything before position is no longer read by the GPU
+    void release(uint64_t position);
+
+    uint64_t getHead() const {return head;}
+    VkDeviceSize getUsedBytes() const {return head - tail;}
+    VkDeviceSize getCapacity() const {return capacity;}
+    VkBuffer getBuffer() const {return buffer;}
+    void* getData(VkDeviceSize offset) const {return static_cast<char*>(allocation.mapped) + offset;}
+};
+
+} // namespace vcr
+
+#endif // VCR_STAGING_RING_HPP
@@ -16,18 +16,21 @@ SwapChain::~SwapChain() {
 
 void SwapChain::cleanupSwapChain() {
     vkDestroyImageView(device.getDevice(), colorImageView, nullptr);
-    vkDestroyImage(device.getDevice(), colorImage, nullptr);
-    vkFreeMemory(device.getDevice(), colorImageMemory, nullptr);
+    destroyImage(device.getDevice(), device.getAllocator(), colorImage, colorImageAllocation);
     vkDestroyImageView(device.getDevice(), depthImageView, nullptr);
-    vkDestroyImage(device.getDevice(), depthImage, nullptr);
-    vkFreeMemory(device.getDevice(), depthImageMemory, nullptr);
+    destroyImage(device.getDevice(), device.getAllocator(), depthImage, depthImageAllocation);
     for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
         vkDestroyFramebuffer(device.getDevice(), swapChainFramebuffers[i], nullptr);
     }
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         vkDestroyImageView(device.getDevice(), swapChainImageViews[i], nullptr);
     }
-    vkDestroySwapchainKHR(device.getDevice(), swapChain, nullptr);
+    for (size_t i = 0; i < offscreenImageAllocations.size(); i++) {
+        destroyImage(device.getDevice(), device.getAllocator(), swapChainImages[i], offscreenImageAllocations[i]);
+    }
+    offscreenImageAllocations.clear();
+    if (swapChain != VK_NULL_HANDLE) vkDestroySwapchainKHR(device.getDevice(), swapChain, nullptr);
+    swapChain = VK_NULL_HANDLE;
 }
 
 void SwapChain::init() {
@@ -37,9 +40,10 @@ void SwapChain::init() {
 }
 
 void SwapChain::recreateSwapChain(VkRenderPass& renderPass) {
+    // minimized, wait until there is something to draw to again
     int width = 0, height = 0;
-    glfwGetFramebufferSize(window.getWindow(), &width, &height);
-    while (width == 0 || height == 0) {
+    if (!window.isHeadless()) glfwGetFramebufferSize(window.getWindow(), &width, &height);
+    while (!window.isHeadless() && (width == 0 || height == 0)) {
         glfwGetFramebufferSize(window.getWindow(), &width, &height);
         glfwWaitEvents();
     }
@@ -54,6 +58,27 @@ void SwapChain::recreateSwapChain(VkRenderPass& renderPass) {
     createFramebuffers(renderPass);
 }
 
+VkResult SwapChain::acquireNextImage(VkSemaphore imageAvailable, uint32_t* imageIndex) {
+    if (window.isHeadless()) {
+        *imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % imageCount;
+        return VK_SUCCESS;
+    }
+    return vkAcquireNextImageKHR(device.getDevice(), swapChain, UINT64_MAX, imageAvailable, VK_NULL_HANDLE, imageIndex);
+}
+
+VkResult SwapChain::present(VkSemaphore renderFinished, uint32_t imageIndex) {
+    if (window.isHeadless()) return VK_SUCCESS;
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &renderFinished;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapChain;
+    presentInfo.pImageIndices = &imageIndex;
+    return vkQueuePresentKHR(device.getPresentQueue(), &presentInfo);
+}
+
 void SwapChain::createFramebuffers(VkRenderPass& renderPass) {
     swapChainFramebuffers.resize(imageCount);
 
@@ -83,7 +108,7 @@ void SwapChain::createFramebuffers(VkRenderPass& renderPass) {
 void SwapChain::createDepthResources() {
     VkFormat depthFormat = findDepthFormat();
     createImage(device.getDevice(),
-                device.getPhysicalDevice(),
+                device.getAllocator(),
                 extent.width,
                 extent.height,
                 1,
@@ -92,25 +117,17 @@ void SwapChain::createDepthResources() {
                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 depthImage,
-                depthImageMemory,
+                depthImageAllocation,
                 device.getMsaaSamples());
 
     depthImageView = createImageView(device.getDevice(), depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-
-    transitionImageLayout(device.getDevice(),
-                          device.getCommandPool(),
-                          device.getGraphicsQueue(),
-                          depthImage,
-                          depthFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                          1);
+    // no layout transition, the render pass takes the depth attachment from UNDEFINED
 }
 
 void SwapChain::createColorResources() {
     VkFormat colorFormat = swapChainImageFormat;
     createImage(device.getDevice(),
-                device.getPhysicalDevice(),
+                device.getAllocator(),
                 extent.width,
                 extent.height,
                 1,
@@ -119,7 +136,7 @@ void SwapChain::createColorResources() {
                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 colorImage,
-                colorImageMemory,
+                colorImageAllocation,
                 device.getMsaaSamples());
     colorImageView = createImageView(device.getDevice(),
                                      colorImage,
@@ -136,6 +153,10 @@ VkFormat SwapChain::findDepthFormat() {
 }
 
 void SwapChain::createSwapChain() {
+    if (window.isHeadless()) {
+        createOffscreenImages();
+        return;
+    }
     SwapChainSupportDetails swapChainSupport =
         SwapChain::querySwapChainSupport(device.getPhysicalDevice(), device.getSurface());
     surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -185,6 +206,31 @@ void SwapChain::createSwapChain() {
     vkGetSwapchainImagesKHR(device.getDevice(), swapChain, &imageCount, swapChainImages.data());
 }
 
+void SwapChain::createOffscreenImages() {
+    // what a surface would most likely offer, and copyable so frames can be read back
+    swapChainImageFormat = device.findSupportedFormat({VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+                                                      VK_IMAGE_TILING_OPTIMAL,
+                                                      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+    extent = {window.getWidth(), window.getHeight()};
+    imageCount = OFFSCREEN_IMAGE_COUNT;
+    nextOffscreenImage = 0;
+    swapChainImages.resize(imageCount);
+    offscreenImageAllocations.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        createImage(device.getDevice(),
+                    device.getAllocator(),
+                    extent.width,
+                    extent.height,
+                    1,
+                    swapChainImageFormat,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    swapChainImages[i],
+                    offscreenImageAllocations[i]);
+    }
+}
+
 void SwapChain::createImageViews() {
     swapChainImageViews.resize(swapChainImages.size());
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
@@ -264,4 +310,8 @@ SwapChainSupportDetails SwapChain::querySwapChainSupport(VkPhysicalDevice physic
 void SwapChain::logSwapPresentMode() {
     std::cout << "Swap chain present mode: " << presentModeToString(presentMode) << "\n";
 }
+
+void SwapChain::logOffscreenImages() {
+    std::cout << "Headless, " << imageCount << " offscreen images of " << extent.width << "x" << extent.height << "\n";
+}
 } // namespace vcr
\ No newline at end of file
@@ -5,20 +5,28 @@
 
 namespace vcr {
 
+// headless, enough that an image is never rendered to while a frame in flight still uses it
+constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
+
+// The presentation target. with a headless window there is no VkSwapchainKHR, the images are
+// plain offscreen ones handed out in turn, never shown, with the same acquire / present calls
 class SwapChain {
 private:
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     VkFormat swapChainImageFormat;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkFramebuffer> swapChainFramebuffers;
+    // headless only, the images of swapChainImages are ours then
+    std::vector<Allocation> offscreenImageAllocations;
+    uint32_t nextOffscreenImage = 0;
 
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    Allocation depthImageAllocation;
     VkImageView depthImageView;
 
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
+    Allocation colorImageAllocation;
     VkImageView colorImageView;
     
     VkSurfaceFormatKHR surfaceFormat;
@@ -39,6 +47,9 @@ public:
     void createDepthResources();
     void createColorResources();
     void recreateSwapChain(VkRenderPass &renderPass);
+    // headless, the semaphores are neither signaled nor waited on and both always succeed
+    VkResult acquireNextImage(VkSemaphore imageAvailable, uint32_t* imageIndex);
+    VkResult present(VkSemaphore renderFinished, uint32_t imageIndex);
 
     VkFormat findDepthFormat();
     VkExtent2D getExtent() const {return extent;}
@@ -46,13 +57,19 @@ public:
     uint32_t getImageCount() const {return imageCount;}
     std::vector<VkImageView> getImageViews() const {return swapChainImageViews;}
     VkSwapchainKHR getSwapChain() const {return swapChain;}
-    std::vector<VkFramebuffer> getFramebuffers() const {return swapChainFramebuffers;}
+    const std::vector<VkFramebuffer>& getFramebuffers() const {return swapChainFramebuffers;}
     bool isFramebufferResized() const {return window.isFramebufferResized();}
+    bool isHeadless() const {return window.isHeadless();}
+    // the layout a frame leaves its image in, ready to be presented or read back
+    VkImageLayout getFinalLayout() const {
+        return window.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
 
     static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 private:
 
     void createSwapChain();
+    void createOffscreenImages();
     void createImageViews();
 
     void cleanupSwapChain();
@@ -65,9 +82,11 @@ private:
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
     void log() {
-        logSwapPresentMode();
+        if (window.isHeadless()) logOffscreenImages();
+        else logSwapPresentMode();
     }
     void logSwapPresentMode();
+    void logOffscreenImages();
     std::string presentModeToString(VkPresentModeKHR mode) {
         switch (mode) {
             case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
@@ -0,0 +1,115 @@
+#include "vcr_texture_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace vcr {
+
+namespace {
+
+constexpr uint64_t CACHE_ALIGNMENT = 16;
+constexpr uint32_t CACHE_TEXEL_SIZE = 4;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// the levels have to be the ones computeMipChain gives for the size, anything else is a corrupt file
+bool hasValidLevels(const TextureCacheHeader& header) {
+    std::vector<MipLevel> expected = computeMipChain(header.width, header.height, header.texelSize);
+    if (header.mipLevels != expected.size()) return false;
+    for (uint32_t i = 0; i < header.mipLevels; i++) {
+        const MipLevel& level = header.levels[i];
+        if (level.width != expected[i].width || level.height != expected[i].height ||
+            level.offset != expected[i].offset || level.size != expected[i].size) {
+            return false;
+        }
+    }
+    return header.dataSize == getMipChainSize(expected);
+}
+
+} // namespace
+
+bool TextureCache::open(const std::string& sourcePath) {
+    close();
+    uint64_t sourceKey = computeFileKey(sourcePath);
+    if (sourceKey == 0) return false;
+    if (!file.open(getCachePath(sourcePath))) return false;
+
+    TextureCacheHeader candidate{};
+    bool valid = file.size() >= sizeof(candidate) &&
+                 file.read(&candidate, 0, sizeof(candidate)) &&
+                 candidate.magic == TEXTURE_CACHE_MAGIC &&
+                 candidate.version == TEXTURE_CACHE_VERSION &&
+                 candidate.sourceKey == sourceKey &&
+                 candidate.texelSize == CACHE_TEXEL_SIZE &&
+                 candidate.width > 0 && candidate.height > 0 &&
+                 hasValidLevels(candidate) &&
+                 candidate.dataOffset + candidate.dataSize <= file.size();
+    if (!valid) {
+        file.close();
+        return false;
+    }
+    header = candidate;
+    return true;
+}
+
+void TextureCache::close() {
+    header = {};
+    file.close();
+}
+
+bool TextureCache::read(void* dst, uint64_t offset, size_t size) const {
+    if (offset + size > header.dataSize) return false;
+    return file.read(dst, header.dataOffset + offset, size);
+}
+
+bool TextureCache::write(const std::string& sourcePath, const void* data, const std::vector<MipLevel>& levels) {
+    if (levels.empty() || levels.size() > MAX_MIP_LEVELS) return false;
+    TextureCacheHeader header{};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceKey = computeFileKey(sourcePath);
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.texelSize = CACHE_TEXEL_SIZE;
+    header.mipLevels = static_cast<uint32_t>(levels.size());
+    header.dataOffset = alignUp(sizeof(TextureCacheHeader), CACHE_ALIGNMENT);
+    header.dataSize = getMipChainSize(levels);
+    std::copy(levels.begin(), levels.end(), header.levels);
+    if (header.sourceKey == 0 || !hasValidLevels(header)) return false;
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string cachePath = getCachePath(sourcePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        const char padding[CACHE_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding, header.dataOffset - sizeof(header));
+        out.write(static_cast<const char*>(data), header.dataSize);
+        if (!out.good()) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::string TextureCache::getCachePath(const std::string& sourcePath) {
+    return sourcePath + ".vcrtex";
+}
+
+} // namespace vcr
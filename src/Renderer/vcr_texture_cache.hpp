@@ -0,0 +1,66 @@
+#ifndef VCR_TEXTURE_CACHE_HPP
+#define VCR_TEXTURE_CACHE_HPP
+
+#include "file_utils.hpp"
+#include "vcr_mipmap.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vcr {
+
+// "VCRT" in little endian
+constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x54524356;
+// bump this whenever the layout of the cache or the import processing changes
+constexpr uint32_t TEXTURE_CACHE_VERSION = 2;
+
+// On disk layout : header | texels
+// decoded RGBA8, the whole mip chain back to back as computeMipChain lays it out,
+// rows tightly packed, every level starts 16 byte aligned. level offsets are from dataOffset
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceKey;
+    uint32_t width;
+    uint32_t height;
+    uint32_t texelSize;
+    uint32_t mipLevels;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    MipLevel levels[MAX_MIP_LEVELS];
+};
+
+// Pre-decoded copy of a texture next to its source. The texels are never held in host memory,
+// read copies them from the file straight to where the caller wants them (the staging ring)
+class TextureCache {
+private:
+    FileReader file;
+    TextureCacheHeader header{};
+
+public:
+    TextureCache() = default;
+    ~TextureCache() = default;
+
+    // fails if there is no cache for sourcePath or if it is stale
+    bool open(const std::string& sourcePath);
+    void close();
+
+    bool isOpen() const {return file.isOpen();}
+    uint32_t getWidth() const {return header.width;}
+    uint32_t getHeight() const {return header.height;}
+    uint32_t getTexelSize() const {return header.texelSize;}
+    uint64_t getDataSize() const {return header.dataSize;}
+    uint32_t getMipLevelCount() const {return header.mipLevels;}
+    std::vector<MipLevel> getMipLevels() const {return {header.levels, header.levels + header.mipLevels};}
+    // size bytes of the texels starting at offset, from the start of level 0
+    bool read(void* dst, uint64_t offset, size_t size) const;
+
+    // data holds the chain described by levels, level 0 is width x height
+    static bool write(const std::string& sourcePath, const void* data, const std::vector<MipLevel>& levels);
+    static std::string getCachePath(const std::string& sourcePath);
+};
+
+} // namespace vcr
+
+#endif // VCR_TEXTURE_CACHE_HPP
@@ -0,0 +1,37 @@
+#include "vcr_texture_decoder.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <climits>
+
+namespace vcr {
+
+bool decodeTextureRgba8(const void* data, size_t size, DecodedTexture& texture) {
+    if (size > INT_MAX) return false;
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(static_cast<const stbi_uc*>(data),
+                                            static_cast<int>(size),
+                                            &width,
+                                            &height,
+                                            &channels,
+                                            STBI_rgb_alpha);
+    if (pixels == nullptr) return false;
+    texture.pixels.reset(pixels);
+    texture.width = static_cast<uint32_t>(width);
+    texture.height = static_cast<uint32_t>(height);
+    texture.sourceChannels = static_cast<uint32_t>(channels);
+    return true;
+}
+
+bool reserveTextureStorage(DecodedTexture& texture, size_t size) {
+    if (size <= texture.getSize()) return true;
+    // same allocator as stb_image so stbi_image_free still releases it
+    void* pixels = STBI_REALLOC(texture.pixels.get(), size);
+    if (pixels == nullptr) return false;
+    texture.pixels.release();
+    texture.pixels.reset(static_cast<stbi_uc*>(pixels));
+    return true;
+}
+
+} // namespace vcr
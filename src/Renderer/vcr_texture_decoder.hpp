@@ -0,0 +1,34 @@
+#ifndef VCR_TEXTURE_DECODER_HPP
+#define VCR_TEXTURE_DECODER_HPP
+
+#include <stb_image.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vcr {
+
+// RGBA8 texels, rows tightly packed
+struct DecodedTexture {
+    std::unique_ptr<stbi_uc, void (*)(void*)> pixels{nullptr, stbi_image_free};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // channel count of the source, informative only
+    uint32_t sourceChannels = 0;
+
+    size_t getSize() const {return size_t(width) * height * 4;}
+};
+
+// PNG / JPG / anything stb_image reads, thread safe as long as nobody flips on load globally.
+// the RGBA8 expansion happens inside the decode (JPEG color conversion, PNG unfiltering),
+// a separate pass over the decoded image measured slower in cascade_texture_bench.
+// false on failure, stbi_failure_reason says why
+bool decodeTextureRgba8(const void* data, size_t size, DecodedTexture& texture);
+// grows the pixel storage to size bytes keeping the decoded texels, room for the mip chain
+// without a copy into a second buffer (the allocator usually extends in place or remaps)
+bool reserveTextureStorage(DecodedTexture& texture, size_t size);
+
+} // namespace vcr
+
+#endif // VCR_TEXTURE_DECODER_HPP
@@ -0,0 +1,161 @@
+#include "vcr_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vcr {
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct TraceBuffer {
+    uint32_t id = 0;
+    const char* name = nullptr;
+    // only contended while a trace is written
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t count = 0;
+};
+
+// buffers outlive their threads, a worker gone still shows in the trace
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    TraceBuffer gpu;
+};
+
+TraceRegistry& getRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+thread_local TraceBuffer* threadBuffer = nullptr;
+thread_local const char* threadName = nullptr;
+
+TraceBuffer& getThreadBuffer() {
+    if (threadBuffer) return *threadBuffer;
+    auto buffer = std::make_unique<TraceBuffer>();
+    buffer->name = threadName;
+    buffer->events.resize(TRACE_EVENTS_PER_THREAD);
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffer->id = static_cast<uint32_t>(registry.buffers.size()) + 1;
+    threadBuffer = buffer.get();
+    registry.buffers.push_back(std::move(buffer));
+    return *threadBuffer;
+}
+
+void pushEvent(TraceBuffer& buffer, const TraceEvent& event) {
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.empty()) buffer.events.resize(TRACE_EVENTS_PER_THREAD);
+    buffer.events[buffer.count % buffer.events.size()] = event;
+    buffer.count++;
+}
+
+// oldest first
+void copyEvents(TraceBuffer& buffer, std::vector<TraceEvent>& events, const char*& name) {
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    name = buffer.name;
+    events.clear();
+    if (buffer.events.empty()) return;
+    uint64_t kept = std::min<uint64_t>(buffer.count, buffer.events.size());
+    for (uint64_t i = buffer.count - kept; i < buffer.count; i++) {
+        events.push_back(buffer.events[i % buffer.events.size()]);
+    }
+}
+
+void writeEvents(FILE* file, const std::vector<TraceEvent>& events, uint32_t pid, uint32_t tid, uint64_t origin) {
+    for (const auto& event : events) {
+        std::fprintf(file,
+                     ",\n{\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}",
+                     pid,
+                     tid,
+                     event.name,
+                     (event.start - origin) / 1000.0,
+                     (event.end - event.start) / 1000.0);
+    }
+}
+
+} // namespace
+
+void setTracingEnabled(bool enabled) {
+    if (enabled) {
+        getThreadBuffer();
+        // the GPU events come from the render thread too
+        TraceBuffer& gpu = getRegistry().gpu;
+        std::lock_guard<std::mutex> lock(gpu.mutex);
+        if (gpu.events.empty()) gpu.events.resize(TRACE_EVENTS_PER_THREAD);
+    }
+    tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const char* name) {
+    threadName = name;
+    if (!threadBuffer) return;
+    std::lock_guard<std::mutex> lock(threadBuffer->mutex);
+    threadBuffer->name = name;
+}
+
+void recordTraceEvent(const char* name, uint64_t start, uint64_t end) {
+    pushEvent(getThreadBuffer(), {name, start, end});
+}
+
+void recordGpuTraceEvent(const char* name, uint64_t start, uint64_t end) {
+    pushEvent(getRegistry().gpu, {name, start, end});
+}
+
+bool writeChromeTrace(const std::string& filePath) {
+    TraceRegistry& registry = getRegistry();
+    struct ThreadEvents {
+        TraceBuffer* buffer;
+        const char* name;
+        std::vector<TraceEvent> events;
+    };
+    std::vector<ThreadEvents> threads;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers) threads.push_back({buffer.get(), nullptr, {}});
+    }
+    uint64_t origin = ~0ull;
+    for (auto& thread : threads) {
+        copyEvents(*thread.buffer, thread.events, thread.name);
+        if (!thread.events.empty()) origin = std::min(origin, thread.events.front().start);
+    }
+    std::vector<TraceEvent> gpuEvents;
+    const char* gpuName = nullptr;
+    copyEvents(registry.gpu, gpuEvents, gpuName);
+    for (const auto& event : gpuEvents) origin = std::min(origin, event.start);
+    if (origin == ~0ull) origin = 0;
+
+    FILE* file = std::fopen(filePath.c_str(), "w");
+    if (!file) return false;
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"CPU\"}}");
+    for (const auto& thread : threads) {
+        if (thread.name) {
+            std::fprintf(file,
+                         ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                         thread.buffer->id,
+                         thread.name);
+        }
+        writeEvents(file, thread.events, 1, thread.buffer->id, origin);
+    }
+    if (!gpuEvents.empty()) {
+        std::fprintf(file, ",\n{\"ph\":\"M\",\"pid\":2,\"name\":\"process_name\",\"args\":{\"name\":\"GPU\"}}");
+        std::fprintf(file, ",\n{\"ph\":\"M\",\"pid\":2,\"tid\":1,\"name\":\"thread_name\",\"args\":{\"name\":\"graphics queue\"}}");
+        writeEvents(file, gpuEvents, 2, 1, origin);
+    }
+    std::fprintf(file, "\n]}\n");
+    bool ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+} // namespace vcr
@@ -0,0 +1,54 @@
+#ifndef VCR_TRACE_HPP
+#define VCR_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace vcr {
+
+// events kept per thread, the oldest are overwritten
+constexpr uint32_t TRACE_EVENTS_PER_THREAD = 1u << 15;
+
+inline std::atomic<bool> tracingEnabled{false};
+
+inline bool isTracingEnabled() {return tracingEnabled.load(std::memory_order_relaxed);}
+
+// nanoseconds on the steady clock, what the events are stamped with
+inline uint64_t getTraceTime() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// a thread gets its ring buffer on its first event. the calling thread's is made here, so a
+// render thread turning tracing on doesn't allocate in a frame
+void setTracingEnabled(bool enabled);
+// how the calling thread shows up in the trace, the name has to outlive the trace
+void setTraceThreadName(const char* name);
+// names are string literals, they are kept as pointers
+void recordTraceEvent(const char* name, uint64_t start, uint64_t end);
+// on a GPU track of its own, start and end already on the trace clock
+void recordGpuTraceEvent(const char* name, uint64_t start, uint64_t end);
+// the events held so far as Chrome trace JSON (chrome://tracing, Perfetto), threads may keep recording
+bool writeChromeTrace(const std::string& filePath);
+
+// records the time between construction and destruction, a relaxed load when tracing is off
+class TraceScope {
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit TraceScope(const char* name)
+        : name(isTracingEnabled() ? name : nullptr), start(this->name ? getTraceTime() : 0) {}
+    ~TraceScope() {
+        if (name) recordTraceEvent(name, start, getTraceTime());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+} // namespace vcr
+
+#endif // VCR_TRACE_HPP
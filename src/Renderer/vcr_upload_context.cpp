@@ -0,0 +1,596 @@
+#include "vcr_upload_context.hpp"
+
+#include "vk_utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace vcr {
+
+StagingRegion UploadBatch::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    return context->allocateStaging(size, alignment);
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer,
+                               VkDeviceSize dstOffset,
+                               VkDeviceSize size,
+                               const StagingWriter& write,
+                               VkDeviceSize granularity) {
+    VkDeviceSize chunkSize = std::max(STAGING_CHUNK_SIZE / granularity, VkDeviceSize(1)) * granularity;
+    for (VkDeviceSize offset = 0; offset < size; offset += chunkSize) {
+        VkDeviceSize bytes = std::min(chunkSize, size - offset);
+        StagingRegion staging = allocateStaging(bytes);
+        write(staging.data, offset, bytes);
+        copyBuffer(staging.buffer, dstBuffer, bytes, staging.offset, dstOffset + offset);
+    }
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    const char* bytes = static_cast<const char*>(data);
+    uploadBuffer(dstBuffer, dstOffset, size, [bytes](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+        memcpy(dst, bytes + offset, size);
+    });
+}
+
+void UploadBatch::uploadImage(VkImage image,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t texelSize,
+                              const void* pixels,
+                              uint32_t mipLevel,
+                              uint32_t firstRow) {
+    const char* bytes = static_cast<const char*>(pixels);
+    uploadImage(image, width, height, texelSize,
+                [bytes](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                    memcpy(dst, bytes + offset, size);
+                },
+                mipLevel,
+                firstRow);
+}
+
+void UploadBatch::uploadImage(VkImage image,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t texelSize,
+                              const StagingWriter& write,
+                              uint32_t mipLevel,
+                              uint32_t firstRow,
+                              uint32_t blockExtent) {
+    // a row is a row of blocks, the copies still give texel rows and stop at the edge of the image
+    VkDeviceSize rowSize = VkDeviceSize((width + blockExtent - 1) / blockExtent) * texelSize;
+    uint32_t blockRows = (height + blockExtent - 1) / blockExtent;
+    uint32_t rowsPerChunk = static_cast<uint32_t>(std::max(STAGING_CHUNK_SIZE / rowSize, VkDeviceSize(1)));
+    for (uint32_t row = 0; row < blockRows; row += rowsPerChunk) {
+        uint32_t rows = std::min(rowsPerChunk, blockRows - row);
+        StagingRegion staging = allocateStaging(rowSize * rows);
+        write(staging.data, rowSize * row, rowSize * rows);
+        uint32_t texelRow = row * blockExtent;
+        recordCopyBufferToImage(commandBuffer, staging.buffer, image, width,
+                                std::min(rows * blockExtent, height - texelRow),
+                                staging.offset, mipLevel, firstRow + texelRow);
+        commandCount++;
+    }
+}
+
+namespace {
+
+// levels from first whose staging fits in a chunk together, at least one
+uint32_t countLevelsInChunk(const std::vector<MipLevel>& levels, uint32_t first, uint32_t last) {
+    uint32_t count = 1;
+    while (first + count < last &&
+           levels[first + count].offset + levels[first + count].size - levels[first].offset <= STAGING_CHUNK_SIZE) {
+        count++;
+    }
+    return count;
+}
+
+} // namespace
+
+void UploadBatch::uploadImageLevels(VkImage image,
+                                    const std::vector<MipLevel>& levels,
+                                    uint32_t firstLevel,
+                                    uint32_t levelCount,
+                                    uint32_t texelSize,
+                                    const StagingWriter& write,
+                                    uint32_t blockExtent) {
+    uint32_t lastLevel = firstLevel + levelCount;
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t level = firstLevel; level < lastLevel;) {
+        const MipLevel& first = levels[level];
+        if (first.size > STAGING_CHUNK_SIZE) {
+            uploadImage(image, first.width, first.height, texelSize,
+                        [&write, &first](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                            write(dst, first.offset + offset, size);
+                        },
+                        level,
+                        0,
+                        blockExtent);
+            level++;
+            continue;
+        }
+
+        // the chain keeps the padding between levels, so the group is one contiguous read
+        uint32_t count = countLevelsInChunk(levels, level, lastLevel);
+        const MipLevel& last = levels[level + count - 1];
+        StagingRegion staging = allocateStaging(last.offset + last.size - first.offset);
+        write(staging.data, first.offset, last.offset + last.size - first.offset);
+
+        regions.clear();
+        for (uint32_t i = level; i < level + count; i++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = staging.offset + (levels[i].offset - first.offset);
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = i;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {levels[i].width, levels[i].height, 1};
+            regions.push_back(region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer,
+                               staging.buffer,
+                               image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()),
+                               regions.data());
+        commandCount++;
+        level += count;
+    }
+}
+
+void appendBufferUploadSteps(std::vector<UploadStep>& steps,
+                             VkBuffer dstBuffer,
+                             VkDeviceSize dstOffset,
+                             VkDeviceSize size,
+                             const StagingWriter& write,
+                             VkDeviceSize granularity) {
+    VkDeviceSize chunkSize = std::max(STAGING_CHUNK_SIZE / granularity, VkDeviceSize(1)) * granularity;
+    for (VkDeviceSize offset = 0; offset < size; offset += chunkSize) {
+        VkDeviceSize bytes = std::min(chunkSize, size - offset);
+        UploadStep step;
+        step.bytes = bytes;
+        step.record = [=](UploadBatch& batch) {
+            batch.uploadBuffer(dstBuffer, dstOffset + offset, bytes,
+                               [&write, offset](void* dst, VkDeviceSize chunkOffset, VkDeviceSize chunkSize) {
+                                   write(dst, offset + chunkOffset, chunkSize);
+                               },
+                               granularity);
+        };
+        steps.push_back(std::move(step));
+    }
+}
+
+void appendImageUploadSteps(std::vector<UploadStep>& steps,
+                            VkImage image,
+                            uint32_t width,
+                            uint32_t height,
+                            uint32_t texelSize,
+                            const void* pixels,
+                            uint32_t mipLevel) {
+    const char* bytes = static_cast<const char*>(pixels);
+    appendImageUploadSteps(steps, image, width, height, texelSize,
+                           [bytes](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                               memcpy(dst, bytes + offset, size);
+                           },
+                           mipLevel);
+}
+
+void appendImageUploadSteps(std::vector<UploadStep>& steps,
+                            VkImage image,
+                            uint32_t width,
+                            uint32_t height,
+                            uint32_t texelSize,
+                            const StagingWriter& write,
+                            uint32_t mipLevel,
+                            uint32_t blockExtent) {
+    VkDeviceSize rowSize = VkDeviceSize((width + blockExtent - 1) / blockExtent) * texelSize;
+    uint32_t blockRows = (height + blockExtent - 1) / blockExtent;
+    uint32_t rowsPerChunk = static_cast<uint32_t>(std::max(STAGING_CHUNK_SIZE / rowSize, VkDeviceSize(1)));
+    for (uint32_t row = 0; row < blockRows; row += rowsPerChunk) {
+        uint32_t rows = std::min(rowsPerChunk, blockRows - row);
+        uint32_t texelRow = row * blockExtent;
+        UploadStep step;
+        step.bytes = rowSize * rows;
+        step.record = [=](UploadBatch& batch) {
+            batch.uploadImage(image, width, std::min(rows * blockExtent, height - texelRow), texelSize,
+                              [&write, rowSize, row](void* dst, VkDeviceSize offset, VkDeviceSize size) {
+                                  write(dst, rowSize * row + offset, size);
+                              },
+                              mipLevel,
+                              texelRow,
+                              blockExtent);
+        };
+        steps.push_back(std::move(step));
+    }
+}
+
+void appendImageLevelUploadSteps(std::vector<UploadStep>& steps,
+                                 VkImage image,
+                                 const std::vector<MipLevel>& levels,
+                                 uint32_t texelSize,
+                                 const StagingWriter& write,
+                                 uint32_t blockExtent) {
+    uint32_t levelCount = static_cast<uint32_t>(levels.size());
+    for (uint32_t level = 0; level < levelCount;) {
+        if (levels[level].size > STAGING_CHUNK_SIZE) {
+            // row chunks, a step each
+            const MipLevel& mip = levels[level];
+            appendImageUploadSteps(steps, image, mip.width, mip.height, texelSize,
+                                   [write, offset = mip.offset](void* dst, VkDeviceSize chunkOffset, VkDeviceSize size) {
+                                       write(dst, offset + chunkOffset, size);
+                                   },
+                                   level,
+                                   blockExtent);
+            level++;
+            continue;
+        }
+        uint32_t count = countLevelsInChunk(levels, level, levelCount);
+        UploadStep step;
+        step.bytes = levels[level + count - 1].offset + levels[level + count - 1].size - levels[level].offset;
+        step.record = [=](UploadBatch& batch) {
+            batch.uploadImageLevels(image, levels, level, count, texelSize, write, blockExtent);
+        };
+        steps.push_back(std::move(step));
+        level += count;
+    }
+}
+
+void UploadBatch::copyBuffer(VkBuffer srcBuffer,
+                             VkBuffer dstBuffer,
+                             VkDeviceSize size,
+                             VkDeviceSize srcOffset,
+                             VkDeviceSize dstOffset) {
+    recordCopyBuffer(commandBuffer, srcBuffer, dstBuffer, size, srcOffset, dstOffset);
+    commandCount++;
+}
+
+void UploadBatch::copyBufferToImage(VkBuffer buffer,
+                                    VkDeviceSize bufferOffset,
+                                    VkImage image,
+                                    uint32_t width,
+                                    uint32_t height) {
+    recordCopyBufferToImage(commandBuffer, buffer, image, width, height, bufferOffset);
+    commandCount++;
+}
+
+void UploadBatch::transitionImageLayout(VkImage image,
+                                        VkFormat format,
+                                        VkImageLayout oldLayout,
+                                        VkImageLayout newLayout,
+                                        uint32_t mipLevels) {
+    recordTransitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
+    commandCount++;
+}
+
+void UploadBatch::releaseBuffer(VkBuffer buffer, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+
+    if (!context->hasDedicatedTransfer()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        commandCount++;
+        return;
+    }
+    // released on the transfer queue and acquired on the graphics queue, each side only has its own access
+    barrier.srcQueueFamilyIndex = context->transferFamily;
+    barrier.dstQueueFamilyIndex = context->graphicsFamily;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(graphicsCommandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dstStage,
+                         0,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr);
+    graphicsUsed = true;
+    commandCount++;
+}
+
+void UploadBatch::releaseImage(VkImage image,
+                               uint32_t mipLevels,
+                               VkImageLayout oldLayout,
+                               VkImageLayout newLayout,
+                               VkPipelineStageFlags dstStage,
+                               VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+
+    if (!context->hasDedicatedTransfer()) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        commandCount++;
+        return;
+    }
+    barrier.srcQueueFamilyIndex = context->transferFamily;
+    barrier.dstQueueFamilyIndex = context->graphicsFamily;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(graphicsCommandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dstStage,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+    graphicsUsed = true;
+    commandCount++;
+}
+
+void UploadContext::init(VkDevice device,
+                         MemoryAllocator& allocator,
+                         VkQueue graphicsQueue,
+                         uint32_t graphicsFamily,
+                         VkQueue transferQueue,
+                         uint32_t transferFamily) {
+    this->device = device;
+    this->graphicsQueue = graphicsQueue;
+    this->graphicsFamily = graphicsFamily;
+    this->transferQueue = transferQueue;
+    this->transferFamily = transferFamily;
+    batch.context = this;
+
+    commandPool = createCommandPool(transferFamily);
+    if (hasDedicatedTransfer()) graphicsCommandPool = createCommandPool(graphicsFamily);
+    stagingRing.init(device, allocator);
+}
+
+void UploadContext::destroy() {
+    if (device == VK_NULL_HANDLE) return;
+    waitIdle();
+    if (recording) {
+        // recorded but never submitted, nothing references it on the GPU
+        vkEndCommandBuffer(current.commandBuffer);
+        if (hasDedicatedTransfer()) vkEndCommandBuffer(current.graphicsCommandBuffer);
+        freeSubmissions.push_back(current);
+        recording = false;
+    }
+    for (auto& submission : freeSubmissions) {
+        vkDestroyFence(device, submission.fence, nullptr);
+        vkDestroySemaphore(device, submission.semaphore, nullptr);
+    }
+    freeSubmissions.clear();
+    stagingRing.destroy();
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    if (graphicsCommandPool != VK_NULL_HANDLE) vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
+    commandPool = VK_NULL_HANDLE;
+    graphicsCommandPool = VK_NULL_HANDLE;
+    device = VK_NULL_HANDLE;
+}
+
+VkCommandPool UploadContext::createCommandPool(uint32_t queueFamilyIndex) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // submissions are short lived and their command buffers get reset one by one
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create upload command pool!");
+    }
+    return pool;
+}
+
+VkCommandBuffer UploadContext::allocateCommandBuffer(VkCommandPool pool) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate upload command buffer!");
+    }
+    return commandBuffer;
+}
+
+UploadContext::Submission UploadContext::acquireSubmission() {
+    Submission submission;
+    if (!freeSubmissions.empty()) {
+        submission = freeSubmissions.back();
+        freeSubmissions.pop_back();
+        vkResetCommandBuffer(submission.commandBuffer, 0);
+        if (hasDedicatedTransfer()) vkResetCommandBuffer(submission.graphicsCommandBuffer, 0);
+        vkResetFences(device, 1, &submission.fence);
+    } else {
+        submission.commandBuffer = allocateCommandBuffer(commandPool);
+        submission.graphicsCommandBuffer = submission.commandBuffer;
+        if (hasDedicatedTransfer()) {
+            submission.graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+            // binary, waited on by the graphics part of the same submission before it is reused
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &submission.semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create upload semaphore!");
+            }
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &submission.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload fence!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(submission.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin upload command buffer!");
+    }
+    if (hasDedicatedTransfer() && vkBeginCommandBuffer(submission.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin upload command buffer!");
+    }
+    return submission;
+}
+
+void UploadContext::retire(const Submission& submission) {
+    stagingRing.release(submission.stagingEnd);
+    completedTicket = submission.ticket;
+    freeSubmissions.push_back(submission);
+}
+
+void UploadContext::retireCompleted() {
+    while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+        retire(inFlight.front());
+        inFlight.pop_front();
+    }
+}
+
+void UploadContext::waitOldest() {
+    vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    retire(inFlight.front());
+    inFlight.pop_front();
+}
+
+StagingRegion UploadContext::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > stagingRing.getCapacity()) {
+        throw std::runtime_error("Staging allocation is larger than the staging ring!");
+    }
+    VkDeviceSize offset;
+    while (!stagingRing.allocate(size, alignment, offset)) {
+        if (!batch.isEmpty()) {
+            // hand what is recorded to the GPU so its staging space can come back, then keep recording
+            submit();
+            begin();
+        } else if (!inFlight.empty()) {
+            waitOldest();
+        } else {
+            throw std::runtime_error("Failed to allocate staging memory!");
+        }
+    }
+
+    StagingRegion region;
+    region.buffer = stagingRing.getBuffer();
+    region.offset = offset;
+    region.data = stagingRing.getData(offset);
+    return region;
+}
+
+UploadBatch& UploadContext::begin() {
+    if (!recording) {
+        // recycles the finished submissions before growing the pool
+        retireCompleted();
+        current = acquireSubmission();
+        batch.commandBuffer = current.commandBuffer;
+        batch.graphicsCommandBuffer = current.graphicsCommandBuffer;
+        batch.graphicsUsed = false;
+        batch.commandCount = 0;
+        recording = true;
+    }
+    return batch;
+}
+
+UploadTicket UploadContext::submit() {
+    if (!recording || batch.isEmpty()) return UploadTicket{};
+
+    if (vkEndCommandBuffer(current.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record upload command buffer!");
+    }
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &current.commandBuffer;
+
+    if (!hasDedicatedTransfer() || !batch.graphicsUsed) {
+        if (hasDedicatedTransfer()) vkEndCommandBuffer(current.graphicsCommandBuffer);
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+    } else {
+        if (vkEndCommandBuffer(current.graphicsCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record upload command buffer!");
+        }
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &current.semaphore;
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo graphicsSubmitInfo{};
+        graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        graphicsSubmitInfo.waitSemaphoreCount = 1;
+        graphicsSubmitInfo.pWaitSemaphores = &current.semaphore;
+        graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+        graphicsSubmitInfo.commandBufferCount = 1;
+        graphicsSubmitInfo.pCommandBuffers = &current.graphicsCommandBuffer;
+        if (vkQueueSubmit(graphicsQueue, 1, &graphicsSubmitInfo, current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+    }
+    submitCount++;
+
+    current.ticket = nextTicket++;
+    // every region handed out so far is read by this submission or an earlier one
+    current.stagingEnd = stagingRing.getHead();
+    inFlight.push_back(current);
+    recording = false;
+    return UploadTicket{current.ticket};
+}
+
+bool UploadContext::isComplete(UploadTicket ticket) {
+    retireCompleted();
+    return ticket.value <= completedTicket;
+}
+
+void UploadContext::wait(UploadTicket ticket) {
+    // tickets complete in order, every submission up to this one is retired with it
+    while (!inFlight.empty() && inFlight.front().ticket <= ticket.value) {
+        waitOldest();
+    }
+}
+
+void UploadContext::waitIdle() {
+    wait(UploadTicket{nextTicket - 1});
+}
+
+} // namespace vcr
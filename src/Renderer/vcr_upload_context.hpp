@@ -0,0 +1,244 @@
+#ifndef VCR_UPLOAD_CONTEXT_HPP
+#define VCR_UPLOAD_CONTEXT_HPP
+
+#include "vcr_memory_allocator.hpp"
+#include "vcr_mipmap.hpp"
+#include "vcr_staging_ring.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace vcr {
+
+// uploads bigger than this are split, so the ring keeps room for the next chunk while the GPU copies
+constexpr VkDeviceSize STAGING_CHUNK_SIZE = 8ull * 1024 * 1024;
+
+// identifies a submission, tickets of the same context complete in order
+struct UploadTicket {
+    uint64_t value = 0;
+};
+
+// a region of the staging ring, valid until the submission that reads it completes
+struct StagingRegion {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void* data = nullptr;
+};
+
+// fills size bytes of the source starting at offset into dst
+using StagingWriter = std::function<void(void* dst, VkDeviceSize offset, VkDeviceSize size)>;
+
+class UploadBatch;
+
+// a slice of an upload, what AssetStreamer spreads over frames. bytes is the staging it needs
+struct UploadStep {
+    VkDeviceSize bytes = 0;
+    std::function<void(UploadBatch&)> record;
+};
+
+class UploadContext;
+
+// Commands recorded for UploadContext::submit. When the staging ring runs out the context
+// submits what has been recorded so far and carries on in a new command buffer, so one
+// batch can end up as several submissions.
+// Copies run on the transfer queue, everything the renderer reads afterwards has to be released
+// to the graphics queue, which is also where the graphics only commands (blits) are recorded
+class UploadBatch {
+    friend class UploadContext;
+
+private:
+    UploadContext* context = nullptr;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // commandBuffer when the transfer queue is the graphics queue
+    VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+    bool graphicsUsed = false;
+    uint32_t commandCount = 0;
+
+public:
+    // size is at most the capacity of the ring
+    StagingRegion allocateStaging(VkDeviceSize size, VkDeviceSize alignment = STAGING_ALIGNMENT);
+
+    // staged and copied in chunks, chunk sizes are a multiple of granularity
+    void uploadBuffer(VkBuffer dstBuffer,
+                      VkDeviceSize dstOffset,
+                      VkDeviceSize size,
+                      const StagingWriter& write,
+                      VkDeviceSize granularity = 1);
+    void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // height tightly packed rows starting at firstRow, the image has to be in TRANSFER_DST_OPTIMAL
+    void uploadImage(VkImage image,
+                     uint32_t width,
+                     uint32_t height,
+                     uint32_t texelSize,
+                     const void* pixels,
+                     uint32_t mipLevel = 0,
+                     uint32_t firstRow = 0);
+    // write gets whole rows, offsets are relative to the first row.
+    // block compressed images count rows of blocks : texelSize is the block size, firstRow a multiple of blockExtent
+    void uploadImage(VkImage image,
+                     uint32_t width,
+                     uint32_t height,
+                     uint32_t texelSize,
+                     const StagingWriter& write,
+                     uint32_t mipLevel = 0,
+                     uint32_t firstRow = 0,
+                     uint32_t blockExtent = 1);
+    // levels [firstLevel, firstLevel + levelCount) of a chain laid out as computeMipChain does,
+    // write gets offsets from the start of level 0. levels sharing a chunk go in one staging
+    // allocation and one copy with a region per level, a level bigger than a chunk is split in rows.
+    // texelSize and blockExtent as for uploadImage
+    void uploadImageLevels(VkImage image,
+                           const std::vector<MipLevel>& levels,
+                           uint32_t firstLevel,
+                           uint32_t levelCount,
+                           uint32_t texelSize,
+                           const StagingWriter& write,
+                           uint32_t blockExtent = 1);
+
+    void copyBuffer(VkBuffer srcBuffer,
+                    VkBuffer dstBuffer,
+                    VkDeviceSize size,
+                    VkDeviceSize srcOffset = 0,
+                    VkDeviceSize dstOffset = 0);
+    void copyBufferToImage(VkBuffer buffer,
+                           VkDeviceSize bufferOffset,
+                           VkImage image,
+                           uint32_t width,
+                           uint32_t height);
+    // transfer queue, UNDEFINED -> TRANSFER_DST_OPTIMAL is the only transition that works on every family
+    void transitionImageLayout(VkImage image,
+                               VkFormat format,
+                               VkImageLayout oldLayout,
+                               VkImageLayout newLayout,
+                               uint32_t mipLevels);
+
+    // ownership transfer to the graphics queue (a plain barrier when both are the same family),
+    // the resource is then ready for dstStage / dstAccess in the graphics command buffer and after the batch
+    void releaseBuffer(VkBuffer buffer, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    void releaseImage(VkImage image,
+                      uint32_t mipLevels,
+                      VkImageLayout oldLayout,
+                      VkImageLayout newLayout,
+                      VkPipelineStageFlags dstStage,
+                      VkAccessFlags dstAccess);
+
+    // for commands the helpers above don't cover, don't hold on to them across allocateStaging
+    VkCommandBuffer getCommandBuffer() {commandCount++; return commandBuffer;}
+    VkCommandBuffer getGraphicsCommandBuffer() {commandCount++; graphicsUsed = true; return graphicsCommandBuffer;}
+    bool isEmpty() const {return commandCount == 0;}
+};
+
+// Replaces the single time commands for resource uploads : one command buffer per submission,
+// a fence per submission, and a ticket the caller can poll or wait on instead of vkQueueWaitIdle.
+// Staging memory comes from a persistent ring, a region is recycled once its submission completes.
+// With a dedicated transfer family a submission is a transfer part signalling a semaphore and,
+// when something was released or blitted, a graphics part waiting on it and owning the fence
+class UploadContext {
+    friend class UploadBatch;
+
+private:
+    struct Submission {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t ticket = 0;
+        // ring position after the last region the submission reads
+        uint64_t stagingEnd = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    uint32_t graphicsFamily = 0;
+    uint32_t transferFamily = 0;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    // only with a dedicated transfer family
+    VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+    StagingRing stagingRing;
+
+    UploadBatch batch;
+    bool recording = false;
+    Submission current;
+    // oldest first
+    std::deque<Submission> inFlight;
+    std::vector<Submission> freeSubmissions;
+    uint64_t nextTicket = 1;
+    uint64_t completedTicket = 0;
+    uint32_t submitCount = 0;
+
+    VkCommandPool createCommandPool(uint32_t queueFamilyIndex);
+    VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+    Submission acquireSubmission();
+    void retire(const Submission& submission);
+    void retireCompleted();
+    void waitOldest();
+    StagingRegion allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+
+public:
+    UploadContext() = default;
+    ~UploadContext() = default;
+    UploadContext(const UploadContext&) = delete;
+    UploadContext& operator=(const UploadContext&) = delete;
+
+    void init(VkDevice device,
+              MemoryAllocator& allocator,
+              VkQueue graphicsQueue,
+              uint32_t graphicsFamily,
+              VkQueue transferQueue,
+              uint32_t transferFamily);
+    // waits for every submission
+    void destroy();
+
+    // the batch being recorded, opened on the first call after a submit
+    UploadBatch& begin();
+    // the ticket of the last submission of the batch, an empty batch is not submitted and its ticket is complete
+    UploadTicket submit();
+
+    bool isComplete(UploadTicket ticket);
+    void wait(UploadTicket ticket);
+    void waitIdle();
+
+    uint32_t getSubmitCount() const {return submitCount;}
+    bool hasDedicatedTransfer() const {return transferFamily != graphicsFamily;}
+    const StagingRing& getStagingRing() const {return stagingRing;}
+};
+
+// split into STAGING_CHUNK_SIZE steps, the source has to stay alive until the steps are recorded
+void appendBufferUploadSteps(std::vector<UploadStep>& steps,
+                             VkBuffer dstBuffer,
+                             VkDeviceSize dstOffset,
+                             VkDeviceSize size,
+                             const StagingWriter& write,
+                             VkDeviceSize granularity = 1);
+void appendImageUploadSteps(std::vector<UploadStep>& steps,
+                            VkImage image,
+                            uint32_t width,
+                            uint32_t height,
+                            uint32_t texelSize,
+                            const void* pixels,
+                            uint32_t mipLevel = 0);
+// the writer is copied into the steps, offsets are relative to the first row of the image
+void appendImageUploadSteps(std::vector<UploadStep>& steps,
+                            VkImage image,
+                            uint32_t width,
+                            uint32_t height,
+                            uint32_t texelSize,
+                            const StagingWriter& write,
+                            uint32_t mipLevel = 0,
+                            uint32_t blockExtent = 1);
+// every level of a chain laid out as computeMipChain does, grouped the way uploadImageLevels does
+void appendImageLevelUploadSteps(std::vector<UploadStep>& steps,
+                                 VkImage image,
+                                 const std::vector<MipLevel>& levels,
+                                 uint32_t texelSize,
+                                 const StagingWriter& write,
+                                 uint32_t blockExtent = 1);
+
+} // namespace vcr
+
+#endif // VCR_UPLOAD_CONTEXT_HPP
@@ -0,0 +1,59 @@
+#ifndef VCR_VERTEX_HPP
+#define VCR_VERTEX_HPP
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace vcr {
+
+struct Vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+
+    bool operator==(const Vertex& other) const {
+        return pos == other.pos && color == other.color && texCoord == other.texCoord;
+    }
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed for hashVertex");
+
+// 64 bit hash over the raw vertex bytes, every bit of every attribute ends up in every output bit.
+// -0.0f is folded into 0.0f so that vertices comparing equal also hash equal
+inline uint64_t hashVertex(const Vertex& vertex) {
+    float components[8] = {
+        vertex.pos.x + 0.0f, vertex.pos.y + 0.0f, vertex.pos.z + 0.0f,
+        vertex.color.x + 0.0f, vertex.color.y + 0.0f, vertex.color.z + 0.0f,
+        vertex.texCoord.x + 0.0f, vertex.texCoord.y + 0.0f
+    };
+    uint64_t words[4];
+    std::memcpy(words, components, sizeof(words));
+
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    for (uint64_t word : words) {
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    // splitmix64 finalizer
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // namespace vcr
+
+namespace std {
+    template<> struct hash<vcr::Vertex> {
+        size_t operator()(vcr::Vertex const& vertex) const {
+            return static_cast<size_t>(vcr::hashVertex(vertex));
+        }
+    };
+}
+
+#endif // VCR_VERTEX_HPP
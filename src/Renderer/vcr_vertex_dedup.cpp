@@ -0,0 +1,77 @@
+#include "vcr_vertex_dedup.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vcr {
+
+namespace {
+
+// the table is kept at most 3/4 full, linear probing degrades quickly past that
+constexpr size_t MIN_SLOT_COUNT = 16;
+
+size_t slotCountFor(size_t vertexCount) {
+    size_t needed = vertexCount + vertexCount / 3 + 1;
+    size_t slotCount = MIN_SLOT_COUNT;
+    while (slotCount < needed) slotCount <<= 1;
+    return slotCount;
+}
+
+} // namespace
+
+void VertexDedupTable::reserve(size_t vertexCount) {
+    if (vertexCount >= EMPTY_SLOT) throw std::runtime_error("Failed to reserve vertex dedup table: too many vertices");
+    vertices.reserve(vertexCount);
+    size_t slotCount = slotCountFor(vertexCount);
+    if (slotCount > slots.size()) rehash(slotCount);
+}
+
+void VertexDedupTable::clear() {
+    vertices.clear();
+    std::fill(slots.begin(), slots.end(), Slot{0, EMPTY_SLOT});
+}
+
+uint32_t VertexDedupTable::insert(const Vertex& vertex) {
+    if ((vertices.size() + 1) * 4 > slots.size() * 3) {
+        if (vertices.size() >= EMPTY_SLOT - 1) throw std::runtime_error("Failed to insert vertex: too many unique vertices");
+        rehash(std::max(MIN_SLOT_COUNT, slots.size() * 2));
+    }
+
+    uint32_t hash = static_cast<uint32_t>(hashVertex(vertex));
+    size_t index = hash & mask;
+    while (true) {
+        Slot& slot = slots[index];
+        if (slot.id == EMPTY_SLOT) {
+            slot.hash = hash;
+            slot.id = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vertex);
+            return slot.id;
+        }
+        if (slot.hash == hash && vertices[slot.id] == vertex) return slot.id;
+        index = (index + 1) & mask;
+    }
+}
+
+std::vector<Vertex> VertexDedupTable::releaseVertices() {
+    std::vector<Vertex> released = std::move(vertices);
+    vertices = {};
+    slots.clear();
+    mask = 0;
+    return released;
+}
+
+void VertexDedupTable::rehash(size_t slotCount) {
+    std::vector<Slot> oldSlots = std::move(slots);
+    slots.assign(slotCount, Slot{0, EMPTY_SLOT});
+    mask = slotCount - 1;
+
+    // the stored hash is enough to place every entry again, no vertex is touched
+    for (const Slot& slot : oldSlots) {
+        if (slot.id == EMPTY_SLOT) continue;
+        size_t index = slot.hash & mask;
+        while (slots[index].id != EMPTY_SLOT) index = (index + 1) & mask;
+        slots[index] = slot;
+    }
+}
+
+} // namespace vcr
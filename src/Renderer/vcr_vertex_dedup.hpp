@@ -0,0 +1,49 @@
+#ifndef VCR_VERTEX_DEDUP_HPP
+#define VCR_VERTEX_DEDUP_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+// Flat open addressing table mapping a vertex to its id, ids are handed out in insertion order.
+// Slots are 8 bytes (low half of the hash + id) probed linearly, the vertices themselves live in a
+// dense array so a lookup only touches a vertex when the stored hash already matches.
+class VertexDedupTable {
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<Vertex> vertices;
+    size_t mask = 0;
+
+    void rehash(size_t slotCount);
+
+public:
+    VertexDedupTable() = default;
+    ~VertexDedupTable() = default;
+
+    // sizes the table for vertexCount unique vertices without rehashing,
+    // callers usually only know the index count and pass an estimate derived from it
+    void reserve(size_t vertexCount);
+    void clear();
+
+    // id of vertex, a vertex seen for the first time gets id size()
+    uint32_t insert(const Vertex& vertex);
+
+    size_t size() const {return vertices.size();}
+    const std::vector<Vertex>& getVertices() const {return vertices;}
+    // moves the unique vertices out, the table is empty afterwards
+    std::vector<Vertex> releaseVertices();
+};
+
+} // namespace vcr
+
+#endif // VCR_VERTEX_DEDUP_HPP
@@ -0,0 +1,246 @@
+#include "vcr_vertex_encoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vcr {
+
+namespace {
+
+constexpr float UNORM16_MAX = 65535.0f;
+constexpr float HALF_MAX = 65504.0f;
+constexpr uint32_t CONSTANT_ALIGNMENT = 4;
+
+uint16_t quantizeUnorm16(float value, float offset, float scale) {
+    float normalized = scale > 0.0f ? (value - offset) / scale : 0.0f;
+    normalized = std::min(std::max(normalized, 0.0f), 1.0f);
+    return static_cast<uint16_t>(normalized * UNORM16_MAX + 0.5f);
+}
+
+uint8_t quantizeUnorm8(float value) {
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
+// round to nearest even, overflow goes to infinity
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t floatExponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (floatExponent == 0xFFu) return static_cast<uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u));
+
+    int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00u);
+    if (exponent <= 0) {
+        // subnormal half
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+// worst rounding error of a half around magnitude
+float halfError(float magnitude) {
+    if (magnitude < 6.1035e-5f) return 2.98e-8f;
+    return std::ldexp(1.0f, static_cast<int>(std::floor(std::log2(magnitude))) - 11);
+}
+
+// sizes and formats come from the storage types, see vcr_vertex_layout.hpp
+uint32_t positionSize(PositionEncoding encoding) {
+    return encoding == PositionEncoding::UNORM16 ? sizeof(Unorm16x4) : sizeof(glm::vec3);
+}
+
+VkFormat positionFormat(PositionEncoding encoding) {
+    return encoding == PositionEncoding::UNORM16 ? VertexFormatOf<Unorm16x4>::value : VertexFormatOf<glm::vec3>::value;
+}
+
+uint32_t texCoordSize(TexCoordEncoding encoding) {
+    switch (encoding) {
+        case TexCoordEncoding::FLOAT2: return sizeof(glm::vec2);
+        case TexCoordEncoding::HALF2: return sizeof(Half2);
+        case TexCoordEncoding::UNORM16: return sizeof(Unorm16x2);
+    }
+    return 0;
+}
+
+VkFormat texCoordFormat(TexCoordEncoding encoding) {
+    switch (encoding) {
+        case TexCoordEncoding::FLOAT2: return VertexFormatOf<glm::vec2>::value;
+        case TexCoordEncoding::HALF2: return VertexFormatOf<Half2>::value;
+        case TexCoordEncoding::UNORM16: return VertexFormatOf<Unorm16x2>::value;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+// in the vertex, a constant color is stored once
+uint32_t colorSize(ColorEncoding encoding) {
+    switch (encoding) {
+        case ColorEncoding::FLOAT3: return sizeof(glm::vec3);
+        case ColorEncoding::UNORM8: return sizeof(Unorm8x4);
+        case ColorEncoding::CONSTANT: return 0;
+    }
+    return 0;
+}
+
+VkFormat colorFormat(ColorEncoding encoding) {
+    return encoding == ColorEncoding::FLOAT3 ? VertexFormatOf<glm::vec3>::value : VertexFormatOf<Unorm8x4>::value;
+}
+
+} // namespace
+
+VertexEncoding VertexEncoding::choose(const Vertex* vertices,
+                                      size_t vertexCount,
+                                      const MeshBounds& bounds,
+                                      const VertexEncodingOptions& options) {
+    VertexEncoding encoding{};
+    if (vertexCount == 0) return encoding;
+
+    glm::vec2 texCoordMin = vertices[0].texCoord;
+    glm::vec2 texCoordMax = vertices[0].texCoord;
+    bool constantColor = true;
+    bool unitColor = true;
+    for (size_t i = 0; i < vertexCount; i++) {
+        const Vertex& vertex = vertices[i];
+        texCoordMin = glm::min(texCoordMin, vertex.texCoord);
+        texCoordMax = glm::max(texCoordMax, vertex.texCoord);
+        constantColor = constantColor && vertex.color == vertices[0].color;
+        for (int c = 0; c < 3; c++) unitColor = unitColor && vertex.color[c] >= 0.0f && vertex.color[c] <= 1.0f;
+    }
+
+    glm::vec3 extent = bounds.max - bounds.min;
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    if (maxExtent / UNORM16_MAX * 0.5f <= options.maxPositionError) {
+        encoding.position = PositionEncoding::UNORM16;
+        encoding.dequantization.positionScale = glm::vec4(extent, 1.0f);
+        encoding.dequantization.positionOffset = glm::vec4(bounds.min, 0.0f);
+    }
+
+    glm::vec2 texCoordRange = texCoordMax - texCoordMin;
+    float maxTexCoordRange = std::max(texCoordRange.x, texCoordRange.y);
+    float maxTexCoordMagnitude = std::max(std::max(std::abs(texCoordMin.x), std::abs(texCoordMin.y)),
+                                          std::max(std::abs(texCoordMax.x), std::abs(texCoordMax.y)));
+    if (maxTexCoordRange / UNORM16_MAX * 0.5f <= options.maxTexCoordError) {
+        encoding.texCoord = TexCoordEncoding::UNORM16;
+        encoding.dequantization.texCoordScaleOffset = glm::vec4(texCoordRange.x, texCoordRange.y, texCoordMin.x, texCoordMin.y);
+    } else if (maxTexCoordMagnitude < HALF_MAX && halfError(maxTexCoordMagnitude) <= options.maxTexCoordError) {
+        encoding.texCoord = TexCoordEncoding::HALF2;
+    }
+
+    if (constantColor && unitColor) {
+        encoding.color = ColorEncoding::CONSTANT;
+    } else if (unitColor) {
+        encoding.color = ColorEncoding::UNORM8;
+    }
+
+    encoding.positionOffset = 0;
+    encoding.colorOffset = positionSize(encoding.position);
+    encoding.texCoordOffset = encoding.colorOffset + colorSize(encoding.color);
+    encoding.stride = encoding.texCoordOffset + texCoordSize(encoding.texCoord);
+    return encoding;
+}
+
+size_t VertexEncoding::getConstantOffset(size_t vertexCount) const {
+    size_t streamSize = static_cast<size_t>(stride) * vertexCount;
+    return (streamSize + CONSTANT_ALIGNMENT - 1) & ~static_cast<size_t>(CONSTANT_ALIGNMENT - 1);
+}
+
+size_t VertexEncoding::getEncodedSize(size_t vertexCount) const {
+    if (color != ColorEncoding::CONSTANT) return static_cast<size_t>(stride) * vertexCount;
+    return getConstantOffset(vertexCount) + 4 * sizeof(uint8_t);
+}
+
+void VertexEncoding::encode(const Vertex* vertices, size_t vertexCount, void* destination) const {
+    encodeVertices(vertices, vertexCount, destination);
+    if (color == ColorEncoding::CONSTANT) {
+        encodeConstant(vertices, vertexCount, static_cast<uint8_t*>(destination) + getConstantOffset(vertexCount));
+    }
+}
+
+void VertexEncoding::encodeVertices(const Vertex* vertices, size_t vertexCount, void* destination) const {
+    uint8_t* output = static_cast<uint8_t*>(destination);
+    const VertexDequantization& dq = dequantization;
+    for (size_t i = 0; i < vertexCount; i++) {
+        const Vertex& vertex = vertices[i];
+        uint8_t* out = output + i * stride;
+
+        if (position == PositionEncoding::UNORM16) {
+            Unorm16x4 packed = {{
+                quantizeUnorm16(vertex.pos.x, dq.positionOffset.x, dq.positionScale.x),
+                quantizeUnorm16(vertex.pos.y, dq.positionOffset.y, dq.positionScale.y),
+                quantizeUnorm16(vertex.pos.z, dq.positionOffset.z, dq.positionScale.z),
+                0
+            }};
+            std::memcpy(out + positionOffset, &packed, sizeof(packed));
+        } else {
+            float packed[3] = {vertex.pos.x, vertex.pos.y, vertex.pos.z};
+            std::memcpy(out + positionOffset, packed, sizeof(packed));
+        }
+
+        if (color == ColorEncoding::UNORM8) {
+            Unorm8x4 packed = {{quantizeUnorm8(vertex.color.x), quantizeUnorm8(vertex.color.y), quantizeUnorm8(vertex.color.z), 255}};
+            std::memcpy(out + colorOffset, &packed, sizeof(packed));
+        } else if (color == ColorEncoding::FLOAT3) {
+            float packed[3] = {vertex.color.x, vertex.color.y, vertex.color.z};
+            std::memcpy(out + colorOffset, packed, sizeof(packed));
+        }
+
+        if (texCoord == TexCoordEncoding::UNORM16) {
+            Unorm16x2 packed = {{
+                quantizeUnorm16(vertex.texCoord.x, dq.texCoordScaleOffset.z, dq.texCoordScaleOffset.x),
+                quantizeUnorm16(vertex.texCoord.y, dq.texCoordScaleOffset.w, dq.texCoordScaleOffset.y)
+            }};
+            std::memcpy(out + texCoordOffset, &packed, sizeof(packed));
+        } else if (texCoord == TexCoordEncoding::HALF2) {
+            Half2 packed = {{floatToHalf(vertex.texCoord.x), floatToHalf(vertex.texCoord.y)}};
+            std::memcpy(out + texCoordOffset, &packed, sizeof(packed));
+        } else {
+            float packed[2] = {vertex.texCoord.x, vertex.texCoord.y};
+            std::memcpy(out + texCoordOffset, packed, sizeof(packed));
+        }
+    }
+}
+
+void VertexEncoding::encodeConstant(const Vertex* vertices, size_t vertexCount, void* destination) const {
+    glm::vec3 constant = vertexCount > 0 ? vertices[0].color : glm::vec3(1.0f);
+    uint8_t packed[4] = {quantizeUnorm8(constant.x), quantizeUnorm8(constant.y), quantizeUnorm8(constant.z), 255};
+    std::memcpy(destination, packed, sizeof(packed));
+}
+
+std::array<VkVertexInputBindingDescription, 2> VertexEncoding::getBindingDescriptions() const {
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = stride;
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    if (color == ColorEncoding::CONSTANT) {
+        // one element read by every vertex of the single instance
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = sizeof(Unorm8x4);
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    }
+    return bindingDescriptions;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> VertexEncoding::getAttributeDescriptions() const {
+    // the locations of VertexLayout<Vertex>, a constant color comes from the second binding
+    bool constant = color == ColorEncoding::CONSTANT;
+    return {{
+        {0, 0, positionFormat(position), positionOffset},
+        {1, constant ? 1u : 0u, colorFormat(color), constant ? 0u : colorOffset},
+        {2, 0, texCoordFormat(texCoord), texCoordOffset},
+    }};
+}
+
+} // namespace vcr
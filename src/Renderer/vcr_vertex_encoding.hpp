@@ -0,0 +1,93 @@
+#ifndef VCR_VERTEX_ENCODING_HPP
+#define VCR_VERTEX_ENCODING_HPP
+
+#include "vcr_vertex.hpp"
+#include "vcr_mesh_cache.hpp"
+#include "vcr_vertex_layout.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcr {
+
+enum class PositionEncoding : uint32_t {
+    FLOAT3,
+    // unorm16 x4 relative to the mesh bounds, w is padding
+    UNORM16,
+};
+
+enum class TexCoordEncoding : uint32_t {
+    FLOAT2,
+    HALF2,
+    // unorm16 x2 relative to the texcoord bounds
+    UNORM16,
+};
+
+enum class ColorEncoding : uint32_t {
+    FLOAT3,
+    UNORM8,
+    // the same for every vertex : stored once after the vertices and fetched at instance rate
+    CONSTANT,
+};
+
+// import time precision budget, an attribute is only narrowed when its quantisation step fits
+struct VertexEncodingOptions {
+    float maxPositionError = 0.0005f;
+    float maxTexCoordError = 1.0f / 8192.0f;
+};
+
+// Push constants of the vertex stage, attribute = offset + scale * fetched value.
+// Identity for float attributes. Must match shaders/shader_quantized.vert
+struct VertexDequantization {
+    glm::vec4 positionScale{1.0f};
+    glm::vec4 positionOffset{0.0f};
+    // xy : scale, zw : offset
+    glm::vec4 texCoordScaleOffset{1.0f, 1.0f, 0.0f, 0.0f};
+};
+
+// Per mesh layout of the GPU vertex stream, chosen at import from the actual data.
+// the default one is the Vertex array as is
+struct VertexEncoding {
+    PositionEncoding position = PositionEncoding::FLOAT3;
+    TexCoordEncoding texCoord = TexCoordEncoding::FLOAT2;
+    ColorEncoding color = ColorEncoding::FLOAT3;
+    uint32_t stride = sizeof(Vertex);
+    uint32_t positionOffset = offsetof(Vertex, pos);
+    uint32_t colorOffset = offsetof(Vertex, color);
+    uint32_t texCoordOffset = offsetof(Vertex, texCoord);
+    VertexDequantization dequantization{};
+
+    static VertexEncoding choose(const Vertex* vertices,
+                                 size_t vertexCount,
+                                 const MeshBounds& bounds,
+                                 const VertexEncodingOptions& options = {});
+
+    // size of the encoded stream, constant attributes included
+    size_t getEncodedSize(size_t vertexCount) const;
+    // offset of the constant color block inside the encoded stream
+    size_t getConstantOffset(size_t vertexCount) const;
+    // destination holds getEncodedSize(vertexCount) bytes
+    void encode(const Vertex* vertices, size_t vertexCount, void* destination) const;
+    // the two parts of encode, for streams written in pieces : stride * vertexCount bytes,
+    // and the 4 bytes at getConstantOffset when the color is CONSTANT
+    void encodeVertices(const Vertex* vertices, size_t vertexCount, void* destination) const;
+    void encodeConstant(const Vertex* vertices, size_t vertexCount, void* destination) const;
+
+    // full precision, the stream is laid out as VertexLayout<Vertex>
+    bool isUnencoded() const {
+        return position == PositionEncoding::FLOAT3 && color == ColorEncoding::FLOAT3 && texCoord == TexCoordEncoding::FLOAT2;
+    }
+    uint32_t getBindingCount() const {return color == ColorEncoding::CONSTANT ? 2 : 1;}
+    // only the first getBindingCount() bindings are used
+    std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions() const;
+    std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() const;
+};
+
+} // namespace vcr
+
+#endif // VCR_VERTEX_ENCODING_HPP
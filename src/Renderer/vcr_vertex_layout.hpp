@@ -0,0 +1,121 @@
+#ifndef VCR_VERTEX_LAYOUT_HPP
+#define VCR_VERTEX_LAYOUT_HPP
+
+#include "vcr_vertex.hpp"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace vcr {
+
+// Compile time vertex input reflection. A vertex type declares its fields once :
+//
+//     template <> struct VertexLayout<MyVertex> {
+//         static constexpr std::array<VertexAttribute, 2> attributes = {
+//             VCR_VERTEX_ATTRIBUTE(MyVertex, pos, 0),
+//             VCR_VERTEX_ATTRIBUTE(MyVertex, uv, 1),
+//         };
+//     };
+//
+// and the Vulkan binding / attribute descriptions are built from it as constants,
+// see makeBindingDescription, makeAttributeDescriptions and PipelineConfig::setVertexLayout.
+
+struct VertexAttribute {
+    uint32_t location;
+    VkFormat format;
+    uint32_t offset;
+};
+
+// format of a field from its C++ type, integer types that should be read normalized
+// go through VCR_VERTEX_ATTRIBUTE_FORMAT instead
+template <typename T> struct VertexFormatOf;
+template <> struct VertexFormatOf<float> {static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT;};
+template <> struct VertexFormatOf<glm::vec2> {static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT;};
+template <> struct VertexFormatOf<glm::vec3> {static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;};
+template <> struct VertexFormatOf<glm::vec4> {static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;};
+template <> struct VertexFormatOf<int32_t> {static constexpr VkFormat value = VK_FORMAT_R32_SINT;};
+template <> struct VertexFormatOf<glm::ivec2> {static constexpr VkFormat value = VK_FORMAT_R32G32_SINT;};
+template <> struct VertexFormatOf<glm::ivec3> {static constexpr VkFormat value = VK_FORMAT_R32G32B32_SINT;};
+template <> struct VertexFormatOf<glm::ivec4> {static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SINT;};
+template <> struct VertexFormatOf<uint32_t> {static constexpr VkFormat value = VK_FORMAT_R32_UINT;};
+template <> struct VertexFormatOf<glm::uvec2> {static constexpr VkFormat value = VK_FORMAT_R32G32_UINT;};
+template <> struct VertexFormatOf<glm::uvec3> {static constexpr VkFormat value = VK_FORMAT_R32G32B32_UINT;};
+template <> struct VertexFormatOf<glm::uvec4> {static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_UINT;};
+
+// storage of the normalized and half float attributes, the encoded vertex streams are written with them
+struct Unorm8x4 {uint8_t value[4];};
+struct Unorm16x2 {uint16_t value[2];};
+struct Unorm16x4 {uint16_t value[4];};
+struct Half2 {uint16_t value[2];};
+template <> struct VertexFormatOf<Unorm8x4> {static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM;};
+template <> struct VertexFormatOf<Unorm16x2> {static constexpr VkFormat value = VK_FORMAT_R16G16_UNORM;};
+template <> struct VertexFormatOf<Unorm16x4> {static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_UNORM;};
+template <> struct VertexFormatOf<Half2> {static constexpr VkFormat value = VK_FORMAT_R16G16_SFLOAT;};
+static_assert(sizeof(Unorm8x4) == 4 && sizeof(Unorm16x2) == 4 && sizeof(Unorm16x4) == 8 && sizeof(Half2) == 4,
+              "Encoded attributes must be tightly packed");
+
+// specialised once per vertex type, next to the type or below
+template <typename VertexType> struct VertexLayout;
+
+#define VCR_VERTEX_ATTRIBUTE(VertexType, member, location) \
+    ::vcr::VertexAttribute{(location), \
+                           ::vcr::VertexFormatOf<decltype(VertexType::member)>::value, \
+                           static_cast<uint32_t>(offsetof(VertexType, member))}
+
+#define VCR_VERTEX_ATTRIBUTE_FORMAT(VertexType, member, location, format) \
+    ::vcr::VertexAttribute{(location), (format), static_cast<uint32_t>(offsetof(VertexType, member))}
+
+template <typename VertexType>
+constexpr uint32_t vertexAttributeCountOf() {
+    return static_cast<uint32_t>(VertexLayout<VertexType>::attributes.size());
+}
+
+template <typename VertexType>
+constexpr VkVertexInputBindingDescription makeBindingDescription(uint32_t binding = 0,
+                                                                 VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX) {
+    return VkVertexInputBindingDescription{binding, static_cast<uint32_t>(sizeof(VertexType)), inputRate};
+}
+
+template <typename VertexType>
+constexpr std::array<VkVertexInputAttributeDescription, vertexAttributeCountOf<VertexType>()>
+makeAttributeDescriptions(uint32_t binding = 0) {
+    std::array<VkVertexInputAttributeDescription, vertexAttributeCountOf<VertexType>()> descriptions{};
+    for (size_t i = 0; i < descriptions.size(); i++) {
+        const VertexAttribute& attribute = VertexLayout<VertexType>::attributes[i];
+        descriptions[i] = VkVertexInputAttributeDescription{attribute.location, binding, attribute.format, attribute.offset};
+    }
+    return descriptions;
+}
+
+// === Layouts ===
+
+template <> struct VertexLayout<Vertex> {
+    static constexpr std::array<VertexAttribute, 3> attributes = {
+        VCR_VERTEX_ATTRIBUTE(Vertex, pos, 0),
+        VCR_VERTEX_ATTRIBUTE(Vertex, color, 1),
+        VCR_VERTEX_ATTRIBUTE(Vertex, texCoord, 2),
+    };
+};
+
+// what shaders/shader.vert and shaders/shader_quantized.vert read
+static_assert(makeBindingDescription<Vertex>().stride == sizeof(Vertex), "Vertex binding stride");
+static_assert(makeAttributeDescriptions<Vertex>()[0].location == 0 &&
+              makeAttributeDescriptions<Vertex>()[0].format == VK_FORMAT_R32G32B32_SFLOAT &&
+              makeAttributeDescriptions<Vertex>()[0].offset == offsetof(Vertex, pos),
+              "Vertex position must be a float3 at location 0");
+static_assert(makeAttributeDescriptions<Vertex>()[1].location == 1 &&
+              makeAttributeDescriptions<Vertex>()[1].format == VK_FORMAT_R32G32B32_SFLOAT &&
+              makeAttributeDescriptions<Vertex>()[1].offset == offsetof(Vertex, color),
+              "Vertex color must be a float3 at location 1");
+static_assert(makeAttributeDescriptions<Vertex>()[2].location == 2 &&
+              makeAttributeDescriptions<Vertex>()[2].format == VK_FORMAT_R32G32_SFLOAT &&
+              makeAttributeDescriptions<Vertex>()[2].offset == offsetof(Vertex, texCoord),
+              "Vertex texCoord must be a float2 at location 2");
+
+} // namespace vcr
+
+#endif // VCR_VERTEX_LAYOUT_HPP
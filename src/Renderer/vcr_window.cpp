@@ -2,15 +2,17 @@
 
 namespace vcr {
 
-Window::Window(uint32_t width, uint32_t height, const std::string& name)
-    : width(width), height(height), windowName(name) {}
+Window::Window(uint32_t width, uint32_t height, const std::string& name, bool headless)
+    : width(width), height(height), windowName(name), headless(headless) {}
 
 Window::~Window() {
+    if (headless) return;
     glfwDestroyWindow(window);
     glfwTerminate();
 }
 
 void Window::init() {
+    if (headless) return;
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
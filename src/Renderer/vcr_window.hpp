@@ -15,16 +15,22 @@ private:
     std::string windowName;
 
     bool framebufferResized = false;
+    // no GLFW at all, nothing to show the frames on and no input
+    bool headless = false;
 
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
 
 public:
-    Window(uint32_t width, uint32_t height, const std::string& name);
+    Window(uint32_t width, uint32_t height, const std::string& name, bool headless = false);
     ~Window();
     void init();
     GLFWwindow* getWindow() {return window;}
-    bool windowShouldClose() {return glfwWindowShouldClose(window);}
-    void pollEvents() {glfwPollEvents();}
+    bool isHeadless() const {return headless;}
+    // of the window as created, the framebuffer of a headless one
+    uint32_t getWidth() const {return width;}
+    uint32_t getHeight() const {return height;}
+    bool windowShouldClose() {return !headless && glfwWindowShouldClose(window);}
+    void pollEvents() {if (!headless) glfwPollEvents();}
     bool isFramebufferResized() const {return framebufferResized;}
     void setFramebufferResized(bool resized) {framebufferResized = resized;}
 private:
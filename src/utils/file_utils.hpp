@@ -2,30 +2,267 @@
 #define FILE_UTILS_HPP
 
 
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
 #include <vector>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 namespace vcr {
 
 
-static std::vector<char> readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// hash of the path, size and modification time, 0 if the file can't be read.
+// what the caches compare against to notice their source changed
+inline uint64_t computeFileKey(const std::string& filename) {
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(filename, ec);
+    if (ec) return 0;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) return 0;
+    auto writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec) return 0;
+    int64_t ticks = static_cast<int64_t>(writeTime.time_since_epoch().count());
+
+    std::string pathString = path.string();
+    uint64_t key = fnv1a(pathString.data(), pathString.size());
+    key = fnv1a(&size, sizeof(size), key);
+    key = fnv1a(&ticks, sizeof(ticks), key);
+    return key == 0 ? 1 : key;
+}
+
+// Positional reads straight into the caller's memory, no stream buffer in between.
+// read is const and keeps no file position, so several threads can share one reader
+class FileReader {
+private:
+    uint64_t fileSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
 
-    if (!file.is_open()) {
+public:
+    FileReader() = default;
+    ~FileReader() {close();}
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+    // false on an error or when the file ends before size bytes
+    bool read(void* dst, uint64_t offset, size_t size) const;
+
+    bool isOpen() const;
+    uint64_t size() const {return fileSize;}
+};
+
+// one positional read into the vector, no stream in between
+inline std::vector<char> readFile(const std::string& filename) {
+    FileReader file;
+    if (!file.open(filename)) {
         throw std::runtime_error("failed to open file!");
     }
-
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
+    std::vector<char> buffer(static_cast<size_t>(file.size()));
+    if (!buffer.empty() && !file.read(buffer.data(), 0, buffer.size())) {
+        throw std::runtime_error("failed to read file!");
+    }
     return buffer;
 }
 
+// Read-only mapping of a whole file, pages are only pulled from disk when they are touched
+class MappedFile {
+private:
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    ~MappedFile() {close();}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const {return mappedData != nullptr;}
+    const char* data() const {return mappedData;}
+    size_t size() const {return mappedSize;}
+};
+
+#ifdef _WIN32
+
+inline bool MappedFile::open(const std::string& filename) {
+    close();
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        close();
+        return false;
+    }
+    mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (mappedData == nullptr) {
+        close();
+        return false;
+    }
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+inline bool FileReader::open(const std::string& filename) {
+    close();
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size)) {
+        close();
+        return false;
+    }
+    fileSize = static_cast<uint64_t>(size.QuadPart);
+    return true;
+}
+
+inline void FileReader::close() {
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    fileHandle = INVALID_HANDLE_VALUE;
+    fileSize = 0;
+}
+
+inline bool FileReader::read(void* dst, uint64_t offset, size_t size) const {
+    char* bytes = static_cast<char*>(dst);
+    while (size > 0) {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD request = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD count = 0;
+        if (!ReadFile(fileHandle, bytes, request, &count, &overlapped) || count == 0) return false;
+        bytes += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+inline bool FileReader::isOpen() const {return fileHandle != INVALID_HANDLE_VALUE;}
+
+inline void MappedFile::close() {
+    if (mappedData != nullptr) UnmapViewOfFile(mappedData);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    mappedData = nullptr;
+    mappedSize = 0;
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+inline bool MappedFile::open(const std::string& filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    madvise(mapping, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+    mappedData = static_cast<const char*>(mapping);
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    return true;
+}
+
+inline bool FileReader::open(const std::string& filename) {
+    close();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close();
+        return false;
+    }
+    fileSize = static_cast<uint64_t>(fileStat.st_size);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+inline void FileReader::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    fileSize = 0;
+}
+
+inline bool FileReader::read(void* dst, uint64_t offset, size_t size) const {
+    char* bytes = static_cast<char*>(dst);
+    while (size > 0) {
+        ssize_t count = pread(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        bytes += count;
+        offset += static_cast<uint64_t>(count);
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+inline bool FileReader::isOpen() const {return fd >= 0;}
+
+inline void MappedFile::close() {
+    if (mappedData != nullptr) munmap(const_cast<char*>(mappedData), mappedSize);
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+#endif
+
 }
 
-#endif // FILE_UTILS_HPP
\ No newline at end of file
+#endif // FILE_UTILS_HPP
@@ -0,0 +1,49 @@
+#ifndef THREAD_UTILS_HPP
+#define THREAD_UTILS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace vcr {
+
+inline uint32_t defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, count) into threadCount contiguous ranges and runs fn(begin, end, worker) on each,
+// the calling thread takes the first range. Exceptions thrown by a worker are rethrown here.
+template <typename Fn>
+void parallelFor(size_t count, uint32_t threadCount, Fn&& fn) {
+    threadCount = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(threadCount, count)));
+    if (threadCount == 1) {
+        fn(size_t(0), count, 0u);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(threadCount);
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    auto run = [&](uint32_t worker) {
+        size_t begin = count * worker / threadCount;
+        size_t end = count * (worker + 1) / threadCount;
+        try {
+            fn(begin, end, worker);
+        } catch (...) {
+            errors[worker] = std::current_exception();
+        }
+    };
+    for (uint32_t i = 1; i < threadCount; i++) workers.emplace_back(run, i);
+    run(0);
+    for (auto &worker : workers) worker.join();
+
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+} // namespace vcr
+
+#endif // THREAD_UTILS_HPP
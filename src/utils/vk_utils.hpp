@@ -1,6 +1,8 @@
 #ifndef VK_UTILS_HPP
 #define VK_UTILS_HPP
 
+#include "vcr_memory_allocator.hpp"
+
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 
@@ -9,28 +11,14 @@
 
 namespace vcr {
 
-inline uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
-                               uint32_t typeFilter,
-                               VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-    throw std::runtime_error("Failed to find suitable memory type!");
-}
-
 inline void createBuffer(VkDevice device,
-                         VkPhysicalDevice physicalDevice,
+                         MemoryAllocator& allocator,
                          VkDeviceSize size,
                          VkBufferUsageFlags usage,
                          VkMemoryPropertyFlags properties,
                          VkBuffer& buffer,
-                         VkDeviceMemory& bufferMemory) {
+                         Allocation& bufferAllocation,
+                         bool dedicated = false) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -44,71 +32,31 @@ inline void createBuffer(VkDevice device,
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate buffer memory!");
-    }
-
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    bufferAllocation = allocator.allocate(memRequirements, properties, AllocationKind::LINEAR, dedicated);
+    vkBindBufferMemory(device, buffer, bufferAllocation.memory, bufferAllocation.offset);
 }
 
-inline VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool) {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
+inline void destroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer& buffer, Allocation& bufferAllocation) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(bufferAllocation);
+    buffer = VK_NULL_HANDLE;
 }
 
-inline void endSingleTimeCommands(VkDevice device,
-                                  VkCommandPool commandPool,
-                                  VkQueue graphicsQueue,
-                                  VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-inline void copyBuffer(VkDevice device,
-                       VkCommandPool commandPool,
-                       VkQueue graphicsQueue,
-                       VkBuffer srcBuffer,
-                       VkBuffer dstBuffer,
-                       VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
+inline void recordCopyBuffer(VkCommandBuffer commandBuffer,
+                             VkBuffer srcBuffer,
+                             VkBuffer dstBuffer,
+                             VkDeviceSize size,
+                             VkDeviceSize srcOffset = 0,
+                             VkDeviceSize dstOffset = 0) {
     VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
 }
 
 inline void createImage(VkDevice device,
-                        VkPhysicalDevice physicalDevice,
+                        MemoryAllocator& allocator,
                         uint32_t width,
                         uint32_t height,
                         uint32_t mipLevels,
@@ -117,7 +65,7 @@ inline void createImage(VkDevice device,
                         VkImageUsageFlags usage,
                         VkMemoryPropertyFlags properties,
                         VkImage& image,
-                        VkDeviceMemory& imageMemory,
+                        Allocation& imageAllocation,
                         VkSampleCountFlagBits numSamples = VK_SAMPLE_COUNT_1_BIT) {
 
     VkImageCreateInfo imageInfo{};
@@ -142,17 +90,17 @@ inline void createImage(VkDevice device,
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate image memory!");
-    }
+    // attachments are recreated with the swap chain, their own memory keeps the blocks from fragmenting
+    bool attachment = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+    AllocationKind kind = tiling == VK_IMAGE_TILING_LINEAR ? AllocationKind::LINEAR : AllocationKind::OPTIMAL;
+    imageAllocation = allocator.allocate(memRequirements, properties, kind, attachment);
+    vkBindImageMemory(device, image, imageAllocation.memory, imageAllocation.offset);
+}
 
-    vkBindImageMemory(device, image, imageMemory, 0);
+inline void destroyImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, Allocation& imageAllocation) {
+    vkDestroyImage(device, image, nullptr);
+    allocator.free(imageAllocation);
+    image = VK_NULL_HANDLE;
 }
 
 inline VkImageView createImageView(VkDevice device,
@@ -182,16 +130,12 @@ inline bool hasStencilComponent(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-inline void transitionImageLayout(VkDevice device,
-                                  VkCommandPool commandPool,
-                                  VkQueue graphicsQueue,
-                                  VkImage image,
-                                  VkFormat format,
-                                  VkImageLayout oldLayout,
-                                  VkImageLayout newLayout,
-                                  uint32_t mipLevels) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
+inline void recordTransitionImageLayout(VkCommandBuffer commandBuffer,
+                                        VkImage image,
+                                        VkFormat format,
+                                        VkImageLayout oldLayout,
+                                        VkImageLayout newLayout,
+                                        uint32_t mipLevels) {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -244,148 +188,29 @@ inline void transitionImageLayout(VkDevice device,
 
     vkCmdPipelineBarrier(
         commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
 }
 
-inline void copyBufferToImage(VkDevice device,
-                              VkCommandPool commandPool,
-                              VkQueue graphicsQueue,
-                              VkBuffer buffer,
-                              VkImage image,
-                              uint32_t width,
-                              uint32_t height) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
+// copies height rows starting at rowOffset, the buffer holds them tightly packed
+inline void recordCopyBufferToImage(VkCommandBuffer commandBuffer,
+                                    VkBuffer buffer,
+                                    VkImage image,
+                                    uint32_t width,
+                                    uint32_t height,
+                                    VkDeviceSize bufferOffset = 0,
+                                    uint32_t mipLevel = 0,
+                                    int32_t rowOffset = 0) {
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
+    region.imageOffset = {0, rowOffset, 0};
     region.imageExtent = {width, height, 1};
     vkCmdCopyBufferToImage(
         commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
-}
-
-inline void generateMipmaps(VkDevice device,
-                     VkPhysicalDevice physicalDevice,
-                     VkCommandPool commandPool,
-                     VkQueue graphicsQueue,
-                     VkImage image,
-                     VkFormat imageFormat,
-                     int32_t texWidth,
-                     int32_t texHeight,
-                     uint32_t mipLevels) {
-    // Check if image format supports linear blitting
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-
-    if (!(formatProperties.optimalTilingFeatures &
-          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting!");
-    }
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    int32_t mipWidth = texWidth;
-    int32_t mipHeight = texHeight;
-
-    for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             0,
-                             0,
-                             nullptr,
-                             0,
-                             nullptr,
-                             1,
-                             &barrier);
-
-        VkImageBlit blit{};
-        blit.srcOffsets[0] = {0, 0, 0};
-        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.dstOffsets[0] = {0, 0, 0};
-        blit.dstOffsets[1] = {
-            mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
-
-        vkCmdBlitImage(commandBuffer,
-                       image,
-                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       image,
-                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                       1,
-                       &blit,
-                       VK_FILTER_LINEAR);
-
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                             0,
-                             0,
-                             nullptr,
-                             0,
-                             nullptr,
-                             1,
-                             &barrier);
-
-        if (mipWidth > 1) mipWidth /= 2;
-        if (mipHeight > 1) mipHeight /= 2;
-    }
-
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                         0,
-                         0,
-                         nullptr,
-                         0,
-                         nullptr,
-                         1,
-                         &barrier);
-
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
 }
 
 } // namespace vcr